@@ -74,13 +74,22 @@ void Generator::WriteCompilerSpec(ostream &os)
         symbolTable.Symbol(importName);
         os << importName << delim;
     }
-    if (!imports.empty())
+    if (!imports.empty() || compilerAppSpecVersion >= 3u)
         os << delim;
 
     // Assign symbols, to variable and function names first, then to parameter
-    // names, writing each name only once, in order of assigned symbol.
+    // names, writing each name only once, in order of assigned symbol. If
+    // applicable, follow the names defined by the system module, which are
+    // bound globally, with a separator to separate them from the rest.
+    bool globalNamesWritten = compilerAppSpecVersion < 3u;
     for (const auto &moduleEntry: definitionsByModuleKey)
     {
+        if (!globalNamesWritten && !moduleEntry.second.moduleName.empty())
+        {
+            os << delim;
+            globalNamesWritten = true;
+        }
+
         for (const auto &definitionEntry: *moduleEntry.second.definitions)
         {
             const auto &name = definitionEntry.first;
@@ -92,6 +101,8 @@ void Generator::WriteCompilerSpec(ostream &os)
             os << name << delim;
         }
     }
+    if (!globalNamesWritten)
+        os << delim;
     for (const auto &moduleEntry: definitionsByModuleKey)
     {
         for (const auto &definitionEntry: *moduleEntry.second.definitions)
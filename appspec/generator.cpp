@@ -127,14 +127,10 @@ void Generator::Finalize()
             (moduleKey, ModuleDefinitionsInfo(moduleName, moduleEntry.second));
     }
 
-    // Set the app spec format versions to support app modules if required.
-    if (definitionsByModuleKey.size() > 1u)
-    {
-        if (compilerAppSpecVersion < 2u)
-            compilerAppSpecVersion = 2u;
-        if (engineAppSpecVersion < 1u)
-            engineAppSpecVersion = 1u;
-    }
+    // Set the engine app spec format version to support app modules if
+    // required. The compiler format always supports them.
+    if (definitionsByModuleKey.size() > 1u && engineAppSpecVersion < 1u)
+        engineAppSpecVersion = 1u;
 
     // Perform a final pass over all the modules and their definitions.
     for (const auto &moduleEntry: definitionsByModuleKey)
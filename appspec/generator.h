@@ -197,7 +197,7 @@ class Generator
 
         // Source code processing data.
         std::string fileBaseName, variableBaseName;
-        uint8_t compilerAppSpecVersion = 1u;
+        uint8_t compilerAppSpecVersion = 3u;
         uint8_t engineAppSpecVersion = 0;
         bool newFile = true, isLibrary = false;
         SourceLocation currentSourceLocation;
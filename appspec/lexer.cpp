@@ -11,9 +11,10 @@ using namespace std;
 bool Lexer::keywordsInitialized = false;
 
 Lexer::Lexer(istream &is, const string &fileName) :
-    is(is),
     caret(fileName, 1, 1)
 {
+    LoadSource(is);
+
     // Add keywords specific to the application specification language.
     if (!keywordsInitialized)
     {
@@ -130,15 +131,7 @@ Token *Lexer::ProcessSignedNumber()
 
 int Lexer::Get()
 {
-    // Get next character from peek prefetch or file as appropriate.
-    int c;
-    if (!prefetch.empty())
-    {
-        c = prefetch.front();
-        prefetch.pop_front();
-    }
-    else
-        c = Read();
+    int c = Read();
 
     // Maintain line/column.
     if (c == '\n')
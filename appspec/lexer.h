@@ -9,7 +9,6 @@
 
 #ifdef __cplusplus
 #include <iostream>
-#include <deque>
 #include <map>
 #include <string>
 #include <cstdint>
@@ -43,6 +42,7 @@ class Lexer
         Token *ProcessSpecial();
 
         // Character methods.
+        void LoadSource(std::istream &);
         int Get();
         int Peek(unsigned offset = 0);
         int Read();
@@ -54,9 +54,8 @@ class Lexer
         static std::map<std::string, int> keywords;
 
         // Data.
-        std::istream &is;
-        std::deque<int> prefetch;
-        std::deque<int> readahead;
+        std::string source;
+        const char *next, *end;
         SourceLocation sourceLocation, caret;
 };
 
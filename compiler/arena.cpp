@@ -0,0 +1,61 @@
+//
+// Asp arena allocation implementation.
+//
+
+#include "arena.hpp"
+#include <new>
+
+using namespace std;
+
+static const size_t Alignment = alignof(max_align_t);
+
+Arena::Arena(size_t blockSize) :
+    blockSize(blockSize), blockUsed(blockSize)
+{
+}
+
+Arena::~Arena()
+{
+    Release();
+}
+
+void *Arena::Allocate(size_t size)
+{
+    size = (size + Alignment - 1) & ~(Alignment - 1);
+
+    // Give oversized requests a block of their own, placed before the
+    // current block so that the latter remains available.
+    if (size > blockSize)
+    {
+        auto block = static_cast<char *>(::operator new(size));
+        blocks.insert(blocks.empty() ? blocks.end() : blocks.end() - 1, block);
+        allocationCount++;
+        return block;
+    }
+
+    // Start a new block when the current one is full.
+    if (blockUsed + size > blockSize)
+    {
+        blocks.push_back(static_cast<char *>(::operator new(blockSize)));
+        blockUsed = 0;
+    }
+
+    auto result = blocks.back() + blockUsed;
+    blockUsed += size;
+    allocationCount++;
+    return result;
+}
+
+void Arena::Free(void *)
+{
+    if (allocationCount != 0 && --allocationCount == 0)
+        Release();
+}
+
+void Arena::Release()
+{
+    for (auto block: blocks)
+        ::operator delete(block);
+    blocks.clear();
+    blockUsed = blockSize;
+}
@@ -0,0 +1,88 @@
+//
+// Asp arena allocation definitions.
+//
+
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <vector>
+#include <cstddef>
+
+class Arena
+{
+    public:
+
+        // Constructor, destructor.
+        explicit Arena(std::size_t blockSize = 0x10000);
+        ~Arena();
+
+        // Allocation methods. Individual frees only keep count; the memory
+        // itself is released in bulk once every allocation has been freed.
+        void *Allocate(std::size_t);
+        void Free(void *);
+
+    protected:
+
+        // Copy prevention.
+        Arena(const Arena &) = delete;
+        Arena &operator =(const Arena &) = delete;
+
+    private:
+
+        // Internal methods.
+        void Release();
+
+        // Data.
+        std::size_t blockSize, blockUsed;
+        std::vector<char *> blocks;
+        std::size_t allocationCount = 0;
+};
+
+template <class T>
+class ArenaAllocator
+{
+    public:
+
+        using value_type = T;
+
+        explicit ArenaAllocator(Arena &arena) :
+            arena(&arena)
+        {
+        }
+
+        template <class U>
+        ArenaAllocator(const ArenaAllocator<U> &other) :
+            arena(other.arena)
+        {
+        }
+
+        T *allocate(std::size_t n)
+        {
+            return static_cast<T *>(arena->Allocate(n * sizeof(T)));
+        }
+
+        void deallocate(T *p, std::size_t)
+        {
+            arena->Free(p);
+        }
+
+        template <class U>
+        bool operator ==(const ArenaAllocator<U> &other) const
+        {
+            return arena == other.arena;
+        }
+
+        template <class U>
+        bool operator !=(const ArenaAllocator<U> &other) const
+        {
+            return arena != other.arena;
+        }
+
+    private:
+
+        template <class U> friend class ArenaAllocator;
+
+        Arena *arena;
+};
+
+#endif
@@ -11,6 +11,7 @@
 #include "instruction.hpp"
 #include "symbols.h"
 #include <iostream>
+#include <unordered_map>
 #include <sstream>
 #include <string>
 #include <cstring>
@@ -43,7 +44,7 @@ void Compiler::LoadApplicationSpec(istream &specStream)
     // Read and check application spec version.
     uint8_t version;
     specStream >> version;
-    if (version > 2u)
+    if (version > 3u)
     {
         ostringstream oss;
         oss
@@ -63,9 +64,12 @@ void Compiler::LoadApplicationSpec(istream &specStream)
     }
     executable.SetCheckValue(checkValue);
 
-    // Define symbols for all names used in the application.
+    // Define symbols for all names used in the application. Later versions
+    // list app module names first, and then the names defined by the system
+    // module, each list followed by a separator.
     char delim = version >= 2u ? ' ' : '\n';
     bool storeAppModuleNames = version >= 2u;
+    bool storeDefinitionNames = false;
     while (true)
     {
         string name;
@@ -74,13 +78,20 @@ void Compiler::LoadApplicationSpec(istream &specStream)
             break;
         if (name.empty())
         {
+            storeDefinitionNames = storeAppModuleNames && version >= 3u;
             storeAppModuleNames = false;
             continue;
         }
         if (storeAppModuleNames)
             appModuleNames.insert(name);
+        if (storeDefinitionNames)
+            executable.AddApplicationDefinitionName(name);
         symbolTable.Symbol(name);
     }
+
+    // Application symbols are fixed by the spec, so they must never be
+    // renumbered.
+    symbolTable.ReserveDefinedSymbols();
 }
 
 void Compiler::AddModule(const string &moduleName)
@@ -192,6 +203,124 @@ void Compiler::Finalize()
     executable.Finalize();
 }
 
+void Compiler::BeginModuleObject()
+{
+    symbolTable.StartRecording();
+    recordingModuleObject = true;
+    currentModuleImports.clear();
+    currentModuleReadNames.clear();
+    currentModuleBoundMemberNames.clear();
+}
+
+bool Compiler::SaveModuleObject(ModuleObject &moduleObject)
+{
+    auto recording = symbolTable.StopRecording();
+    recordingModuleObject = false;
+
+    moduleObject.checkValue = executable.CheckValue();
+    moduleObject.optimizationLevel = static_cast<uint8_t>
+        (executable.OptimizationLevel());
+    const auto &boundMemberNames = executable.BoundMemberNames();
+    moduleObject.readNames.assign
+        (currentModuleReadNames.begin(), currentModuleReadNames.end());
+    moduleObject.boundReadNames.clear();
+    for (const auto &name: currentModuleReadNames)
+    {
+        if (boundMemberNames.count(name) != 0)
+            moduleObject.boundReadNames.push_back(name);
+    }
+    moduleObject.symbols = move(recording.symbols);
+    moduleObject.firstTemporarySymbol = recording.firstTemporarySymbol;
+    moduleObject.temporarySymbolCount = recording.temporarySymbolCount;
+    moduleObject.imports = move(currentModuleImports);
+    currentModuleImports.clear();
+    moduleObject.boundMemberNames.assign
+        (currentModuleBoundMemberNames.begin(),
+         currentModuleBoundMemberNames.end());
+
+    return
+        executable.SaveModule(moduleObject, currentModuleLocation) &&
+        moduleObject.Complete();
+}
+
+bool Compiler::ModuleObjectFits(const ModuleObject &moduleObject) const
+{
+    if (moduleObject.checkValue != executable.CheckValue() ||
+        moduleObject.optimizationLevel != executable.OptimizationLevel())
+        return false;
+
+    // Each name the module reads must be bound as a member now exactly if it
+    // was when the module was compiled. Both lists are sorted.
+    const auto &boundMemberNames = executable.BoundMemberNames();
+    auto boundIter = moduleObject.boundReadNames.begin();
+    for (const auto &name: moduleObject.readNames)
+    {
+        bool wasBound =
+            boundIter != moduleObject.boundReadNames.end() &&
+            *boundIter == name;
+        if (wasBound)
+            boundIter++;
+        if (wasBound != (boundMemberNames.count(name) != 0))
+            return false;
+    }
+    return
+        boundIter == moduleObject.boundReadNames.end() &&
+        moduleObject.Complete();
+}
+
+bool Compiler::LoadModuleObject(const ModuleObject &moduleObject)
+{
+    if (!ModuleObjectFits(moduleObject))
+        return false;
+
+    // Fetch the module's symbols in their original order so that any new
+    // ones are assigned exactly as compiling the module would assign them,
+    // noting how each one translates.
+    unordered_map<int32_t, int32_t> symbolMap;
+    for (const auto &symbol: moduleObject.symbols)
+        symbolMap[symbol.second] = symbolTable.Symbol(symbol.first);
+    for (uint32_t i = 0; i < moduleObject.temporarySymbolCount; i++)
+        symbolMap[moduleObject.firstTemporarySymbol - static_cast<int32_t>(i)]
+            = symbolTable.TemporarySymbol();
+
+    // Add imported modules as the import statements would.
+    for (const auto &import: moduleObject.imports)
+    {
+        AddModule(import.moduleName);
+
+        auto importedModuleIter = importedModules.emplace
+            (import.moduleName, list<SourceElement>()).first;
+        importedModuleIter->second.emplace_back(import.sourceLocation);
+    }
+
+    InsertModuleEntry();
+    executable.RestoreModule(moduleObject, symbolMap);
+    return true;
+}
+
+void Compiler::ScanBoundMemberNames(set<string> &boundMemberNames)
+{
+    this->boundMemberNames = &boundMemberNames;
+}
+
+void Compiler::InsertModuleEntry()
+{
+    currentModuleLocation = executable.Insert
+        (new NullInstruction, NoSourceLocation);
+    executable.MarkModuleLocation(currentModuleName, currentModuleLocation);
+
+    executable.PushLocation(topLocation);
+    {
+        ostringstream oss;
+        oss << "Add address of module " << currentModuleName;
+        executable.Insert
+            (new AddModuleInstruction
+                (currentModuleSymbol, currentModuleLocation, oss.str()),
+             NoSourceLocation);
+    }
+    executable.PopLocation();
+}
+
 #define DEFINE_ACTION(...) DEFINE_ACTION_N(__VA_ARGS__, \
     DEFINE_ACTION_4, ~, \
     DEFINE_ACTION_3, ~, \
@@ -257,24 +386,31 @@ void Compiler::Finalize()
 
 DEFINE_ACTION(MakeModule, NonTerminal *, Block *, module)
 {
-    try
+    // Gather the names of the members the module binds, for its object, if
+    // any. When scanning, that is all.
+    if (boundMemberNames != nullptr || recordingModuleObject)
     {
-        auto moduleLocation = executable.Insert
-            (new NullInstruction, NoSourceLocation);
-        executable.MarkModuleLocation(currentModuleName, moduleLocation);
-
-        executable.PushLocation(topLocation);
+        ScopeBindings bindings;
+        module->CollectBindings(bindings);
+        if (boundMemberNames == nullptr)
+            currentModuleBoundMemberNames = move(bindings.memberNames);
+        else
         {
-            ostringstream oss;
-            oss << "Add address of module " << currentModuleName;
-            executable.Insert
-                (new AddModuleInstruction
-                    (currentModuleSymbol, moduleLocation, oss.str()),
-                 NoSourceLocation);
+            boundMemberNames->insert
+                (bindings.memberNames.begin(), bindings.memberNames.end());
+            delete module;
+            return nullptr;
         }
-        executable.PopLocation();
+    }
+
+    try
+    {
+        InsertModuleEntry();
 
         currentSourceLocation = NoSourceLocation;
+        if (executable.OptimizationLevel() >= 2)
+            module->PropagateModuleConstants
+                (executable, currentModuleReadNames);
         module->Emit(executable);
 
         const SourceElement *finalSourceElement = module->FinalStatement();
@@ -434,6 +570,11 @@ DEFINE_ACTION
         auto importedModuleIter = importedModules.emplace
             (importName->Name(), list<SourceElement>()).first;
         importedModuleIter->second.push_back(*moduleNameList);
+
+        if (recordingModuleObject)
+            currentModuleImports.push_back
+                (ModuleObject::Import
+                    {importName->Name(), moduleNameList->sourceLocation});
     }
 
     return new ImportStatement(moduleNameList);
@@ -449,6 +590,11 @@ DEFINE_ACTION
         (moduleName->Name(), list<SourceElement>()).first;
     importedModuleIter->second.push_back(*moduleName);
 
+    if (recordingModuleObject)
+        currentModuleImports.push_back
+            (ModuleObject::Import
+                {moduleName->Name(), moduleName->sourceLocation});
+
     auto moduleNameList = new ImportNameList;
     moduleNameList->Add(moduleName);
     return new ImportStatement(moduleNameList, memberNameList);
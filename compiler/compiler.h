@@ -10,6 +10,7 @@
 #ifdef __cplusplus
 #include "executable.hpp"
 #include "symbol.hpp"
+#include "module-object.hpp"
 #include <iostream>
 #include <deque>
 #include <list>
@@ -17,6 +18,7 @@
 #include <set>
 #include <string>
 #include <utility>
+#include <vector>
 #endif
 
 #ifdef __cplusplus
@@ -82,6 +84,21 @@ class Compiler
         unsigned ErrorCount() const;
         void Finalize();
 
+        // Module object methods. Beginning a module object records what
+        // compiling the next module draws on, so that once it has been parsed
+        // without error, it may be saved. An object fits this compilation if
+        // it was compiled under the same conditions. Loading a module object
+        // in place of parsing the module fails if the object does not fit.
+        void BeginModuleObject();
+        bool SaveModuleObject(ModuleObject &);
+        bool ModuleObjectFits(const ModuleObject &) const;
+        bool LoadModuleObject(const ModuleObject &);
+
+        // Scanning method. Once scanning, modules are parsed only to gather
+        // the names of the members they bind into the given set, without
+        // generating any code.
+        void ScanBoundMemberNames(std::set<std::string> &);
+
 #endif
 
     /* Module (top-level). */
@@ -337,6 +354,9 @@ class Compiler
         Compiler(const Compiler &) = delete;
         Compiler &operator =(const Compiler &) = delete;
 
+        // Module entry method.
+        void InsertModuleEntry();
+
         // Error reporting methods.
         void ReportError(const std::string &);
         void ReportError(const std::string &, const SourceElement &);
@@ -366,6 +386,16 @@ class Compiler
         std::deque<std::string> moduleNamesToImport;
         std::string currentModuleName;
         std::int32_t currentModuleSymbol;
+        Executable::Location currentModuleLocation;
+
+        // Module object data.
+        bool recordingModuleObject = false;
+        std::vector<ModuleObject::Import> currentModuleImports;
+        std::set<std::string> currentModuleReadNames;
+        std::set<std::string> currentModuleBoundMemberNames;
+
+        // Scanning data.
+        std::set<std::string> *boundMemberNames = nullptr;
 };
 
 } // extern "C"
@@ -0,0 +1,198 @@
+//
+// Asp executable compression implementation.
+//
+
+#include "executable.hpp"
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// The compressed format is described along with the engine's expansion
+// code. Matches are found by way of chains of earlier positions with the
+// same hash of their first few bytes, with each match deferred if the next
+// position starts a longer one.
+static const uint32_t HeaderSize = 12;
+static const uint32_t MinMatchLength = 4;
+static const uint32_t MaxMatchDistance = 0xFFFF;
+static const unsigned MaxChainLength = 256;
+static const unsigned HashBits = 14;
+static const uint32_t ExtendedLength = 15;
+
+static void CompressBlock
+    (string &, const string &image, uint32_t startIndex, uint32_t endIndex,
+     uint32_t matchStartIndex);
+static void PutSequence
+    (string &, const string &image, uint32_t literalIndex,
+     uint32_t literalCount, uint32_t matchDistance, uint32_t matchLength);
+static void PutLength(string &, uint32_t);
+static void PutWord(string &, uint32_t);
+
+uint32_t Executable::WriteCompressed(ostream &os, uint32_t blockSize) const
+{
+    ostringstream imageStream;
+    Write(imageStream);
+    auto image = imageStream.str();
+    auto imageSize = static_cast<uint32_t>(image.size());
+
+    // Compress each block on its own so that any page made up of whole
+    // blocks can be expanded without the others. The executable's own header
+    // is left uncompressed so that it can be checked as soon as it has been
+    // expanded, ahead of being overwritten by the code that follows.
+    uint32_t blockCount = (imageSize + blockSize - 1) / blockSize;
+    vector<string> blocks(blockCount);
+    for (uint32_t i = 0; i < blockCount; i++)
+    {
+        uint32_t startIndex = i * blockSize;
+        uint32_t endIndex = min(startIndex + blockSize, imageSize);
+        CompressBlock
+            (blocks[i], image, startIndex, endIndex,
+             max(startIndex, HeaderSize));
+    }
+
+    // Write the header, the block offsets, and the blocks.
+    string header("AspZ", 4);
+    unsigned blockSizeBits = 0;
+    while ((1U << blockSizeBits) < blockSize)
+        blockSizeBits++;
+    header += static_cast<char>(blockSizeBits);
+    header.append(3, '\0');
+    PutWord(header, imageSize);
+    uint32_t offset = HeaderSize + 4 * (blockCount + 1);
+    for (const auto &block: blocks)
+    {
+        PutWord(header, offset);
+        offset += static_cast<uint32_t>(block.size());
+    }
+    PutWord(header, offset);
+    os.write(header.data(), static_cast<streamsize>(header.size()));
+    for (const auto &block: blocks)
+        os.write(block.data(), static_cast<streamsize>(block.size()));
+
+    return imageSize;
+}
+
+static void CompressBlock
+    (string &block, const string &image, uint32_t startIndex,
+     uint32_t endIndex, uint32_t matchStartIndex)
+{
+    auto hash = [&image](uint32_t index)
+    {
+        uint32_t value = 0;
+        for (uint32_t i = 0; i < MinMatchLength; i++)
+            value = (value << 8) | static_cast<uint8_t>(image[index + i]);
+        return (value * 2654435761U) >> (32 - HashBits);
+    };
+    auto matchLength = [&image, endIndex](uint32_t index, uint32_t from)
+    {
+        uint32_t length = 0;
+        while (index + length < endIndex &&
+               image[from + length] == image[index + length])
+            length++;
+        return length;
+    };
+
+    // Record each position that may start a match, and find the longest
+    // match for a position among those recorded before it.
+    vector<int32_t> heads(1U << HashBits, -1);
+    vector<int32_t> previous(endIndex - startIndex, -1);
+    uint32_t insertIndex = matchStartIndex;
+    auto insertUpTo = [&](uint32_t index)
+    {
+        for (; insertIndex < index &&
+               insertIndex + MinMatchLength <= endIndex; insertIndex++)
+        {
+            auto &head = heads[hash(insertIndex)];
+            previous[insertIndex - startIndex] = head;
+            head = static_cast<int32_t>(insertIndex);
+        }
+    };
+    auto findMatch = [&](uint32_t index, uint32_t *distance)
+    {
+        uint32_t bestLength = 0;
+        if (index < matchStartIndex || index + MinMatchLength > endIndex)
+            return bestLength;
+        insertUpTo(index);
+        unsigned chainLength = 0;
+        for (auto from = heads[hash(index)];
+             from >= 0 && chainLength < MaxChainLength &&
+             index - static_cast<uint32_t>(from) <= MaxMatchDistance;
+             from = previous[static_cast<uint32_t>(from) - startIndex],
+             chainLength++)
+        {
+            auto length = matchLength(index, static_cast<uint32_t>(from));
+            if (length > bestLength)
+            {
+                bestLength = length;
+                *distance = index - static_cast<uint32_t>(from);
+                if (index + length == endIndex)
+                    break;
+            }
+        }
+        return bestLength >= MinMatchLength ? bestLength : 0;
+    };
+
+    uint32_t literalIndex = startIndex, index = startIndex;
+    while (index < endIndex)
+    {
+        uint32_t distance = 0, length = findMatch(index, &distance);
+        if (length == 0)
+        {
+            index++;
+            continue;
+        }
+
+        // Prefer a longer match starting at the next position.
+        uint32_t nextDistance = 0;
+        if (findMatch(index + 1, &nextDistance) > length + 1)
+        {
+            index++;
+            continue;
+        }
+
+        PutSequence
+            (block, image, literalIndex, index - literalIndex,
+             distance, length);
+        index += length;
+        literalIndex = index;
+    }
+
+    // End the block with any remaining literals.
+    if (literalIndex < endIndex)
+        PutSequence
+            (block, image, literalIndex, endIndex - literalIndex, 0, 0);
+}
+
+static void PutSequence
+    (string &block, const string &image, uint32_t literalIndex,
+     uint32_t literalCount, uint32_t matchDistance, uint32_t matchLength)
+{
+    uint32_t matchCount = matchLength != 0 ? matchLength - MinMatchLength : 0;
+    block += static_cast<char>
+        (min(literalCount, ExtendedLength) << 4 |
+         min(matchCount, ExtendedLength));
+    if (literalCount >= ExtendedLength)
+        PutLength(block, literalCount - ExtendedLength);
+    block.append(image, literalIndex, literalCount);
+    if (matchLength == 0)
+        return;
+
+    block += static_cast<char>(matchDistance >> 8);
+    block += static_cast<char>(matchDistance & 0xFF);
+    if (matchCount >= ExtendedLength)
+        PutLength(block, matchCount - ExtendedLength);
+}
+
+static void PutLength(string &block, uint32_t length)
+{
+    for (; length >= 0xFF; length -= 0xFF)
+        block += static_cast<char>(0xFF);
+    block += static_cast<char>(length);
+}
+
+static void PutWord(string &s, uint32_t value)
+{
+    for (unsigned i = 0; i < 4; i++)
+        s += static_cast<char>((value >> ((3 - i) << 3)) & 0xFF);
+}
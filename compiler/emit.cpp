@@ -41,6 +41,30 @@ void AssignmentStatement::Emit(Executable &executable) const
 
 void AssignmentStatement::Emit1(Executable &executable, bool top) const
 {
+    /* When optimizing, addition assignment to a simple variable is done
+       with a combined instruction, which allows the engine to append to a
+       string in place when the variable holds the only reference to it.
+       Engines that predate the instruction can still run unoptimized code. */
+    if (executable.OptimizationLevel() >= 1 &&
+        assignmentTokenType == TOKEN_PLUS_ASSIGN &&
+        dynamic_cast<const VariableExpression *>(targetExpression) != nullptr)
+    {
+        targetExpression->Emit(executable, Expression::EmitType::Value);
+        if (valueAssignmentStatement != nullptr)
+            valueAssignmentStatement->Emit1(executable, false);
+        else
+            valueExpression->Emit(executable);
+        targetExpression->Emit(executable, Expression::EmitType::Address);
+        executable.Insert
+            (new AddSetInstruction
+                (top,
+                 top ?
+                 "Add and assign with pop" :
+                 "Add and assign, leave value on stack"),
+             sourceLocation);
+        return;
+    }
+
     if (assignmentTokenType != TOKEN_ASSIGN)
         targetExpression->Emit(executable, Expression::EmitType::Value);
 
@@ -522,8 +546,46 @@ void IfStatement::Emit(Executable &executable) const
     executable.PopLocation();
 }
 
+void LoopStatement::EmitHoistedLoads(Executable &executable) const
+{
+    for (const auto &hoistedSymbol: hoistedSymbols)
+    {
+        const auto &name = hoistedSymbol.first;
+        {
+            ostringstream oss;
+            oss << "Push value of variable " << name << " ahead of loop";
+            executable.Insert
+                (new LoadInstruction
+                    (executable.Symbol(name), false, oss.str()),
+                 sourceLocation);
+        }
+        {
+            ostringstream oss;
+            oss << "Push address of temporary variable for " << name;
+            executable.Insert
+                (new LoadInstruction(hoistedSymbol.second, true, oss.str()),
+                 sourceLocation);
+        }
+        executable.Insert(new SetInstruction(true), sourceLocation);
+    }
+}
+
+void LoopStatement::EmitHoistedDeletes(Executable &executable) const
+{
+    for (const auto &hoistedSymbol: hoistedSymbols)
+    {
+        ostringstream oss;
+        oss << "Delete temporary variable for " << hoistedSymbol.first;
+        executable.Insert
+            (new DeleteInstruction(hoistedSymbol.second, oss.str()),
+             sourceLocation);
+    }
+}
+
 void WhileStatement::Emit(Executable &executable) const
 {
+    EmitHoistedLoads(executable);
+
     int loopedVariableSymbol = 0;
     if (falseBlock != nullptr)
     {
@@ -590,10 +652,14 @@ void WhileStatement::Emit(Executable &executable) const
         falseBlock->Emit(executable);
         executable.PopLocation();
     }
+
+    EmitHoistedDeletes(executable);
 }
 
 void ForStatement::Emit(Executable &executable) const
 {
+    EmitHoistedLoads(executable);
+
     int loopedVariableSymbol = 0;
     if (falseBlock != nullptr)
     {
@@ -675,6 +741,7 @@ void ForStatement::Emit(Executable &executable) const
     }
 
     executable.Insert(new PopInstruction, sourceLocation);
+    EmitHoistedDeletes(executable);
 }
 
 void Parameter::Emit(Executable &executable) const
@@ -1041,6 +1108,42 @@ void CallExpression::Emit
     executable.Insert(new CallInstruction, sourceLocation);
 }
 
+void InlinedCallExpression::Emit
+    (Executable &executable, EmitType emitType) const
+{
+    if (emitType == EmitType::Address)
+        ThrowError("Cannot take address of function call");
+    else if (emitType == EmitType::Delete)
+        ThrowError("Cannot delete function call");
+
+    for (const auto &argument: arguments)
+    {
+        argument.valueExpression->Emit(executable);
+
+        ostringstream oss;
+        oss
+            << "Push address of temporary variable for parameter "
+            << argument.parameterName << " of " << functionName;
+        executable.Insert
+            (new LoadInstruction(argument.symbol, true, oss.str()),
+             sourceLocation);
+        executable.Insert(new SetInstruction(true), sourceLocation);
+    }
+
+    bodyExpression->Emit(executable);
+
+    for (const auto &argument: arguments)
+    {
+        ostringstream oss;
+        oss
+            << "Delete temporary variable for parameter "
+            << argument.parameterName << " of " << functionName;
+        executable.Insert
+            (new DeleteInstruction(argument.symbol, oss.str()),
+             sourceLocation);
+    }
+}
+
 void ElementExpression::Emit
     (Executable &executable, EmitType emitType) const
 {
@@ -4,10 +4,17 @@
 
 #include "executable.hpp"
 #include "instruction.hpp"
+#include "module-object.hpp"
+#include "opcode.h"
 #include "symbols.h"
 #include <iomanip>
 #include <map>
+#include <set>
+#include <sstream>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 using namespace std;
 
@@ -32,6 +39,11 @@ void Executable::SetCheckValue(uint32_t checkValue)
     this->checkValue = checkValue;
 }
 
+uint32_t Executable::CheckValue() const
+{
+    return checkValue;
+}
+
 int32_t Executable::Symbol(const string &name) const
 {
     return symbolTable.Symbol(name);
@@ -80,26 +92,267 @@ unsigned Executable::ModuleOffset(const string &name) const
     return moduleLocations.find(symbol)->second.second;
 }
 
+bool Executable::SaveModule
+    (ModuleObject &moduleObject, const Location &moduleLocation) const
+{
+    // Index the module's jump targets so that they can be expressed
+    // independently of the rest of the code, ensuring that none lie outside
+    // the module.
+    static const uint32_t NoIndex = UINT32_MAX;
+    unordered_map<const Instruction *, uint32_t> targetIndices;
+    for (auto iter = next(moduleLocation); iter != instructions.end(); iter++)
+    {
+        const auto &instruction = iter->instruction;
+        if (instruction->HasTargetLocation())
+            targetIndices.emplace
+                (instruction->TargetLocation()->instruction, NoIndex);
+    }
+    uint32_t index = 0;
+    for (auto iter = next(moduleLocation); iter != instructions.end();
+         iter++, index++)
+    {
+        auto targetIter = targetIndices.find(iter->instruction);
+        if (targetIter != targetIndices.end())
+            targetIter->second = index;
+    }
+    for (const auto &targetIndex: targetIndices)
+    {
+        if (targetIndex.second == NoIndex)
+            return false;
+    }
+
+    auto &strings = moduleObject.strings;
+    strings.clear();
+    unordered_map<string, uint32_t> stringIndices;
+    auto addString = [&](const string &s)
+    {
+        auto iter = stringIndices.find(s);
+        if (iter != stringIndices.end())
+            return iter->second;
+        auto index = static_cast<uint32_t>(strings.size());
+        stringIndices.emplace(s, index);
+        strings.push_back(s);
+        return index;
+    };
+
+    auto &records = moduleObject.instructions;
+    records.clear();
+    records.reserve(index);
+    ostringstream oss;
+    for (auto iter = next(moduleLocation); iter != instructions.end(); iter++)
+    {
+        const auto &instruction = iter->instruction;
+        records.emplace_back();
+        auto &record = records.back();
+        record.isNull = instruction->Size() == 0;
+        record.opCode = instruction->OpCode();
+        record.comment = addString(instruction->Comment());
+        record.sourceLocation = iter->sourceLocation;
+        if (instruction->HasTargetLocation())
+        {
+            record.hasTarget = true;
+            record.targetIndex = targetIndices.find
+                (instruction->TargetLocation()->instruction)->second;
+        }
+
+        oss.str(string());
+        instruction->PrintCodeOnly(oss);
+        auto code = oss.str();
+
+        // Symbol operands are kept apart from the encoded operands so that
+        // they can be translated when the module is restored. Every
+        // instruction prints its symbol last.
+        auto symbol = instruction->SymbolOperand();
+        if (symbol == nullptr)
+        {
+            oss.str(string());
+            instruction->WriteOperandsOnly(oss);
+            record.operands = addString(oss.str());
+        }
+        else
+        {
+            string suffix = ' ' + to_string(*symbol);
+            if (record.hasTarget ||
+                code.size() < suffix.size() ||
+                code.compare
+                    (code.size() - suffix.size(), suffix.size(), suffix) != 0)
+                return false;
+            record.hasSymbol = true;
+            record.symbol = *symbol;
+            code.erase(code.size() - suffix.size());
+        }
+        record.code = addString(code);
+    }
+
+    return true;
+}
+
+void Executable::RestoreModule
+    (const ModuleObject &moduleObject,
+     const unordered_map<int32_t, int32_t> &symbolMap)
+{
+    const auto &records = moduleObject.instructions;
+    const auto &strings = moduleObject.strings;
+    vector<Location> locations(records.size());
+
+    // Restore instructions that the optimizer inspects as their own types,
+    // and all others generically.
+    auto restore = [&](const ModuleObject::InstructionRecord &record)
+    {
+        auto opCode = record.opCode;
+        const auto &operands = strings[record.operands];
+        const auto &code = strings[record.code];
+        const auto &comment = strings[record.comment];
+        int32_t symbol = 0;
+        if (record.hasSymbol)
+        {
+            auto symbolIter = symbolMap.find(record.symbol);
+            if (symbolIter == symbolMap.end())
+                throw string("Invalid module object: Unmapped symbol");
+            symbol = symbolIter->second;
+        }
+
+        if (opCode == OpCode_POP || opCode == OpCode_POP1)
+            return static_cast<Instruction *>
+                (new PopInstruction
+                    (operands.empty() ?
+                     1 : static_cast<uint8_t>(operands[0]),
+                     comment));
+        else if (opCode == OpCode_LD || opCode == OpCode_LDA)
+            return static_cast<Instruction *>
+                (new LoadInstruction(opCode == OpCode_LDA, comment));
+        else if (record.hasSymbol &&
+                 (opCode == OpCode_LD1 || opCode == OpCode_LD2 ||
+                  opCode == OpCode_LD4 || opCode == OpCode_LDA1 ||
+                  opCode == OpCode_LDA2 || opCode == OpCode_LDA4))
+            return static_cast<Instruction *>
+                (new LoadInstruction
+                    (symbol,
+                     opCode == OpCode_LDA1 || opCode == OpCode_LDA2 ||
+                     opCode == OpCode_LDA4,
+                     comment));
+        else if (record.hasSymbol)
+            return static_cast<Instruction *>
+                (new ObjectInstruction(opCode, symbol, code, comment));
+        else if (record.hasTarget)
+            return static_cast<Instruction *>
+                (new ObjectInstruction
+                    (opCode, locations[record.targetIndex],
+                     operands, code, comment));
+        else
+            return static_cast<Instruction *>
+                (new ObjectInstruction(opCode, operands, code, comment));
+    };
+
+    // Insert instructions in order, holding the place of each one that
+    // refers forward until its target exists.
+    vector<size_t> deferred;
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        const auto &record = records[i];
+        bool defer = record.hasTarget && record.targetIndex >= i;
+        locations[i] = Insert
+            (record.isNull || defer ?
+             new NullInstruction : restore(record),
+             record.sourceLocation);
+        if (defer)
+            deferred.push_back(i);
+    }
+    for (auto i: deferred)
+        Replace(locations[i], restore(records[i]));
+}
+
+void Executable::SetOptimizationLevel(unsigned optimizationLevel)
+{
+    this->optimizationLevel = optimizationLevel;
+}
+
+unsigned Executable::OptimizationLevel() const
+{
+    return optimizationLevel;
+}
+
+void Executable::AddApplicationDefinitionName(const string &name)
+{
+    applicationDefinitionNames.insert(name);
+}
+
+const set<string> &Executable::ApplicationDefinitionNames() const
+{
+    return applicationDefinitionNames;
+}
+
+void Executable::SetBoundMemberNames(const set<string> &boundMemberNames)
+{
+    this->boundMemberNames = boundMemberNames;
+}
+
+const set<string> &Executable::BoundMemberNames() const
+{
+    return boundMemberNames;
+}
+
 void Executable::Finalize()
 {
-    // Assign offsets to each instruction.
-    uint32_t offset = 0;
-    for (auto instructionIter = instructions.begin();
-         instructionIter != instructions.end(); instructionIter++)
+    // Optimize the code if requested, keeping track of its size beforehand.
+    initialInstructionCount = InstructionCount();
+    initialCodeSize = CodeSize();
+    if (optimizationLevel >= 2)
+        EliminateDeadCode();
+    if (!profile.empty())
+        LayOutCode();
+    if (optimizationLevel > 0)
     {
-        const auto &instruction = instructionIter->instruction;
+        Optimize();
+        RenumberSymbols();
+    }
+    finalInstructionCount = InstructionCount();
+
+    // When optimizing, start with the shortest encoding of each instruction
+    // whose target operand can be encoded as a relative displacement.
+    vector<pair<Instruction *, const Instruction *> > shortTargets;
+    if (optimizationLevel > 0)
+    {
+        for (auto &instructionInfo: instructions)
+        {
+            const auto &instruction = instructionInfo.instruction;
+            instruction->ShortenTarget();
+            if (instruction->HasShortTarget())
+                shortTargets.emplace_back
+                    (instruction,
+                     instruction->TargetLocation()->instruction);
+        }
+    }
 
-        instruction->Offset(offset);
+    // Assign offsets to each instruction, widening any target operand that
+    // cannot reach its target and repeating until all targets are in range.
+    // Operands are only ever widened, so this terminates.
+    uint32_t offset;
+    while (true)
+    {
+        offset = 0;
+        for (auto &instructionInfo: instructions)
+        {
+            const auto &instruction = instructionInfo.instruction;
+            instruction->Offset(offset);
+            offset += instruction->Size();
+        }
 
-        // Update module location if applicable.
-        for (auto moduleIter = moduleLocations.begin();
-             moduleIter != moduleLocations.end(); moduleIter++)
+        bool widened = false;
+        for (const auto &shortTarget: shortTargets)
         {
-            if (moduleIter->second.first == instructionIter)
-                moduleIter->second.second = offset;
+            if (shortTarget.first->FitTarget(shortTarget.second->Offset()))
+                widened = true;
         }
+        if (!widened)
+            break;
+    }
 
-        offset += instruction->Size();
+    // Update module locations.
+    for (auto &moduleLocation: moduleLocations)
+    {
+        auto &location = moduleLocation.second;
+        location.second = location.first->instruction->Offset();
     }
 
     // Check and store the final code size.
@@ -123,6 +376,40 @@ uint32_t Executable::FinalCodeSize() const
     return finalCodeSize;
 }
 
+unsigned Executable::InitialInstructionCount() const
+{
+    return initialInstructionCount;
+}
+
+uint32_t Executable::InitialCodeSize() const
+{
+    return initialCodeSize;
+}
+
+unsigned Executable::FinalInstructionCount() const
+{
+    return finalInstructionCount;
+}
+
+unsigned Executable::InstructionCount() const
+{
+    unsigned count = 0;
+    for (const auto &instructionInfo: instructions)
+    {
+        if (instructionInfo.instruction->Size() != 0)
+            count++;
+    }
+    return count;
+}
+
+uint32_t Executable::CodeSize() const
+{
+    uint32_t size = 0;
+    for (const auto &instructionInfo: instructions)
+        size += instructionInfo.instruction->Size();
+    return size;
+}
+
 void Executable::Write(ostream &os) const
 {
     // Write header signature.
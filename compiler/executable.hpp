@@ -6,17 +6,23 @@
 #define EXECUTABLE_HPP
 
 #include "symbol.hpp"
+#include "arena.hpp"
 #include "grammar.hpp"
 #include <iostream>
 #include <map>
 #include <stack>
 #include <list>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <string>
+#include <tuple>
 #include <cstdint>
 #include <utility>
 
 class SymbolTable;
 class Instruction;
+struct ModuleObject;
 
 class Executable
 {
@@ -37,15 +43,18 @@ class Executable
         explicit Executable(SymbolTable &);
         ~Executable();
 
-        // Check value method.
+        // Check value methods.
         void SetCheckValue(std::uint32_t);
+        std::uint32_t CheckValue() const;
 
         // Symbol methods.
         std::int32_t Symbol(const std::string &name) const;
         std::int32_t TemporarySymbol() const;
 
-        // Location type definition.
-        using Location = std::list<InstructionInfo>::iterator;
+        // Instruction list and location type definitions.
+        using InstructionList =
+            std::list<InstructionInfo, ArenaAllocator<InstructionInfo> >;
+        using Location = InstructionList::iterator;
 
         // Instruction insertion methods.
         Location Insert(Instruction *, const SourceLocation &);
@@ -57,12 +66,53 @@ class Executable
         void MarkModuleLocation(const std::string &name, const Location &);
         unsigned ModuleOffset(const std::string &name) const;
 
+        // Module object methods. Saving captures the instructions that follow
+        // the given module location and fails if any of them cannot be
+        // represented in an object. Restoring inserts the object's
+        // instructions at the current location, translating symbols through
+        // the given map.
+        bool SaveModule(ModuleObject &, const Location &moduleLocation) const;
+        void RestoreModule
+            (const ModuleObject &,
+             const std::unordered_map<std::int32_t, std::int32_t> &symbolMap);
+
+        // Optimization methods. The application definition names are the
+        // functions and variables that the application defines globally,
+        // which are bound whenever scripts run. The bound member names are the names that
+        // any module of the program may bind by assigning to or deleting a
+        // member, which the module's own variables may not be assumed to
+        // keep.
+        void SetOptimizationLevel(unsigned);
+        unsigned OptimizationLevel() const;
+        void AddApplicationDefinitionName(const std::string &);
+        const std::set<std::string> &ApplicationDefinitionNames() const;
+        void SetBoundMemberNames(const std::set<std::string> &);
+        const std::set<std::string> &BoundMemberNames() const;
+
+        // Layout methods. A profile gives the number of instructions executed
+        // at each source location, by file name, line, and column. Reading
+        // one fails if it is malformed. Given a profile, the code of the most
+        // frequently executed functions is placed together, ahead of that of
+        // functions never executed.
+        using Profile = std::map
+            <std::tuple<std::string, unsigned, unsigned>, std::uint64_t>;
+        bool ReadProfile(std::istream &);
+
         // Finalize methods.
         void Finalize();
         uint32_t FinalCodeSize() const;
 
-        // Output methods.
+        // Statistics methods.
+        unsigned InitialInstructionCount() const;
+        std::uint32_t InitialCodeSize() const;
+        unsigned FinalInstructionCount() const;
+
+        // Output methods. Writing compressed divides the executable into
+        // blocks of the given size, a power of two, each compressed on its
+        // own, and returns the size of the executable before compression.
         void Write(std::ostream &) const;
+        std::uint32_t WriteCompressed
+            (std::ostream &, std::uint32_t blockSize) const;
         void WriteListing(std::ostream &) const;
         void WriteSourceInfo(std::ostream &) const;
 
@@ -74,12 +124,33 @@ class Executable
 
     private:
 
+        // Layout methods.
+        void LayOutCode();
+
+        // Optimization methods.
+        void EliminateDeadCode();
+        void Optimize();
+        bool OptimizePeephole();
+        Location NextInstruction(Location);
+        void Replace(const Location &, Instruction *);
+        std::unordered_set<const InstructionInfo *> Labels();
+        void RenumberSymbols();
+        unsigned InstructionCount() const;
+        std::uint32_t CodeSize() const;
+
         // Data.
         std::uint32_t checkValue = 0;
         SymbolTable &symbolTable;
-        std::list<InstructionInfo> instructions;
+        Arena instructionArena;
+        InstructionList instructions
+            {ArenaAllocator<InstructionInfo>(instructionArena)};
         Location currentLocation = instructions.end();
         std::uint32_t finalCodeSize = 0;
+        unsigned optimizationLevel = 0;
+        std::set<std::string> applicationDefinitionNames, boundMemberNames;
+        Profile profile;
+        unsigned initialInstructionCount = 0, finalInstructionCount = 0;
+        std::uint32_t initialCodeSize = 0;
         std::stack<Location> locationStack;
         std::map<unsigned, std::pair<Location, unsigned> > moduleLocations;
 };
@@ -184,6 +184,13 @@ void Argument::Parent(const Statement *statement) const
     valueExpression->Parent(statement);
 }
 
+Expression *Argument::ReleaseValueExpression()
+{
+    auto result = valueExpression;
+    valueExpression = nullptr;
+    return result;
+}
+
 ArgumentList::~ArgumentList()
 {
     for (auto &argument: arguments)
@@ -223,6 +230,41 @@ void CallExpression::Parent(const Statement *statement)
     argumentList->Parent(statement);
 }
 
+InlinedCallExpression::InlinedCallExpression
+    (const SourceElement &sourceElement, const string &functionName) :
+    Expression(sourceElement),
+    functionName(functionName)
+{
+}
+
+InlinedCallExpression::~InlinedCallExpression()
+{
+    for (auto &argument: arguments)
+        delete argument.valueExpression;
+    delete bodyExpression;
+}
+
+void InlinedCallExpression::AddArgument
+    (const string &parameterName, int32_t symbol,
+     Expression *valueExpression)
+{
+    arguments.push_back(TemporaryArgument
+        {parameterName, symbol, valueExpression});
+}
+
+void InlinedCallExpression::SetBody(Expression *bodyExpression)
+{
+    delete this->bodyExpression;
+    this->bodyExpression = bodyExpression;
+}
+
+void InlinedCallExpression::Parent(const Statement *statement)
+{
+    for (auto &argument: arguments)
+        argument.valueExpression->Parent(statement);
+    bodyExpression->Parent(statement);
+}
+
 ElementExpression::ElementExpression
     (Expression *sequenceExpression, Expression *indexExpression) :
     Expression((SourceElement &)*indexExpression),
@@ -497,6 +539,33 @@ ConstantExpression::ConstantExpression(const Token &token) :
     }
 }
 
+ConstantExpression::ConstantExpression
+    (const SourceElement &sourceElement,
+     const ConstantExpression &constantExpression) :
+    Expression(sourceElement),
+    type(constantExpression.type),
+    s(constantExpression.s)
+{
+    switch (type)
+    {
+        default:
+            break;
+
+        case Type::Boolean:
+            b = constantExpression.b;
+            break;
+
+        case Type::Integer:
+        case Type::NegatedMinInteger:
+            i = constantExpression.i;
+            break;
+
+        case Type::Float:
+            f = constantExpression.f;
+            break;
+    }
+}
+
 Expression *FoldUnaryExpression
     (int operatorTokenType, Expression *expression)
 {
@@ -9,10 +9,57 @@
 #include "token.h"
 #include "executable.hpp"
 #include <list>
+#include <map>
+#include <set>
 #include <string>
 #include <cstdint>
 
 class Statement;
+class Expression;
+class DefStatement;
+class ConstantExpression;
+
+// Constant values of module-level variables, by name.
+using ConstantMap = std::map<std::string, const ConstantExpression *>;
+
+// Module-level function whose calls may be replaced by its body, along with
+// the names its body refers to other than its parameters.
+struct InlineFunction
+{
+    const DefStatement *defStatement;
+    std::set<std::string> freeNames;
+};
+
+// Module-level names whose values are known during propagation: constant
+// variables and inlinable functions. Temporary variables needed for inlining
+// are drawn from the executable.
+//
+// Also known are the names that are certain to be bound, and never rebound,
+// whenever code in the current scope runs, along with those that will be so
+// within the bodies of functions defined at this point. Lookups of such
+// names within a loop are hoisted into temporary variables assigned ahead of
+// the outermost loop of the scope, as recorded in that loop's map.
+//
+// The names of variables read are gathered as well.
+struct KnownValues
+{
+    ConstantMap constants;
+    std::map<std::string, const InlineFunction *> functions;
+    std::set<std::string> invariantNames, functionInvariantNames;
+    std::map<std::string, std::int32_t> *hoistedSymbols = nullptr;
+    std::set<std::string> *readNames = nullptr;
+    const Executable *executable = nullptr;
+};
+
+// Context for copying the body of an inlined function: the expressions that
+// replace its parameters, by name, and, gathered while copying, the other
+// names referred to and the number of expressions copied.
+struct CloneContext
+{
+    std::map<std::string, const Expression *> parameters;
+    std::set<std::string> freeNames;
+    unsigned size = 0;
+};
 
 class Expression : public NonTerminal
 {
@@ -35,6 +82,11 @@ class Expression : public NonTerminal
             Delete,
         };
 
+        virtual void BoundNames(std::list<std::string> &) const;
+        virtual void BoundMemberNames(std::list<std::string> &) const;
+        virtual Expression *Propagate(const KnownValues &);
+        virtual Expression *Clone(CloneContext &) const;
+
         virtual void Emit(Executable &, EmitType = EmitType::Value) const = 0;
 
     private:
@@ -54,6 +106,9 @@ class ConditionalExpression : public Expression
 
         void Parent(const Statement *) override;
 
+        Expression *Propagate(const KnownValues &) override;
+        Expression *Clone(CloneContext &) const override;
+
         void Emit(Executable &, EmitType) const override;
 
     private:
@@ -79,6 +134,9 @@ class ShortCircuitLogicalExpression : public Expression
             return operatorTokenType;
         }
 
+        Expression *Propagate(const KnownValues &) override;
+        Expression *Clone(CloneContext &) const override;
+
         void Emit(Executable &, EmitType) const override;
 
     private:
@@ -97,6 +155,9 @@ class BinaryExpression : public Expression
 
         void Parent(const Statement *) override;
 
+        Expression *Propagate(const KnownValues &) override;
+        Expression *Clone(CloneContext &) const override;
+
         void Emit(Executable &, EmitType) const override;
 
     private:
@@ -114,6 +175,9 @@ class UnaryExpression : public Expression
 
         void Parent(const Statement *) override;
 
+        Expression *Propagate(const KnownValues &) override;
+        Expression *Clone(CloneContext &) const override;
+
         void Emit(Executable &, EmitType) const override;
 
     private:
@@ -135,6 +199,8 @@ class TargetExpression : public Expression
 
         void Parent(const Statement *) override;
 
+        void BoundNames(std::list<std::string> &) const override;
+
         void Emit(Executable &, EmitType) const override;
 
     private:
@@ -169,6 +235,18 @@ class Argument : public NonTerminal
         {
             return !name.empty();
         }
+        const std::string &Name() const
+        {
+            return name;
+        }
+        const Expression *ValueExpression() const
+        {
+            return valueExpression;
+        }
+        Expression *ReleaseValueExpression();
+
+        void Propagate(const KnownValues &);
+        Argument *Clone(CloneContext &) const;
 
         void Emit(Executable &) const;
 
@@ -200,6 +278,9 @@ class ArgumentList : public NonTerminal
             return arguments.end();
         }
 
+        void Propagate(const KnownValues &);
+        ArgumentList *Clone(CloneContext &) const;
+
         void Emit(Executable &) const;
 
     private:
@@ -216,6 +297,9 @@ class CallExpression : public Expression
 
         void Parent(const Statement *) override;
 
+        Expression *Propagate(const KnownValues &) override;
+        Expression *Clone(CloneContext &) const override;
+
         void Emit(Executable &, EmitType) const override;
 
     private:
@@ -224,6 +308,42 @@ class CallExpression : public Expression
         ArgumentList *argumentList;
 };
 
+// Call replaced by the body of the called function. Arguments other than
+// constants are evaluated into temporary variables, which the body refers to
+// in place of the function's parameters, and which are deleted afterwards.
+class InlinedCallExpression : public Expression
+{
+    public:
+
+        InlinedCallExpression
+            (const SourceElement &, const std::string &functionName);
+        ~InlinedCallExpression() override;
+
+        void AddArgument
+            (const std::string &parameterName, std::int32_t symbol,
+             Expression *);
+        void SetBody(Expression *);
+
+        void Parent(const Statement *) override;
+
+        Expression *Propagate(const KnownValues &) override;
+
+        void Emit(Executable &, EmitType) const override;
+
+    private:
+
+        struct TemporaryArgument
+        {
+            std::string parameterName;
+            std::int32_t symbol;
+            Expression *valueExpression;
+        };
+
+        std::string functionName;
+        std::list<TemporaryArgument> arguments;
+        Expression *bodyExpression = nullptr;
+};
+
 class ElementExpression : public Expression
 {
     public:
@@ -233,6 +353,9 @@ class ElementExpression : public Expression
 
         void Parent(const Statement *) override;
 
+        Expression *Propagate(const KnownValues &) override;
+        Expression *Clone(CloneContext &) const override;
+
         void Emit(Executable &, EmitType) const override;
 
     private:
@@ -249,6 +372,10 @@ class MemberExpression : public Expression
 
         void Parent(const Statement *) override;
 
+        void BoundMemberNames(std::list<std::string> &) const override;
+        Expression *Propagate(const KnownValues &) override;
+        Expression *Clone(CloneContext &) const override;
+
         void Emit(Executable &, EmitType) const override;
 
     private:
@@ -267,6 +394,10 @@ class VariableExpression : public Expression
         bool HasSymbol() const;
         std::string Name() const;
 
+        void BoundNames(std::list<std::string> &) const override;
+        Expression *Propagate(const KnownValues &) override;
+        Expression *Clone(CloneContext &) const override;
+
         void Emit(Executable &, EmitType) const override;
 
     private:
@@ -283,6 +414,8 @@ class SymbolExpression : public Expression
         SymbolExpression
             (const Token &operatorToken, const Token &nameToken);
 
+        Expression *Clone(CloneContext &) const override;
+
         void Emit(Executable &, EmitType) const override;
 
     private:
@@ -299,6 +432,9 @@ class KeyValuePair : public NonTerminal
 
         void Parent(const Statement *) const;
 
+        void Propagate(const KnownValues &);
+        KeyValuePair *Clone(CloneContext &) const;
+
         void Emit(Executable &) const;
 
     private:
@@ -318,6 +454,9 @@ class DictionaryExpression : public Expression
 
         void Parent(const Statement *) override;
 
+        Expression *Propagate(const KnownValues &) override;
+        Expression *Clone(CloneContext &) const override;
+
         void Emit(Executable &, EmitType) const override;
 
     private:
@@ -336,6 +475,9 @@ class SetExpression : public Expression
 
         void Parent(const Statement *) override;
 
+        Expression *Propagate(const KnownValues &) override;
+        Expression *Clone(CloneContext &) const override;
+
         void Emit(Executable &, EmitType) const override;
 
     private:
@@ -357,6 +499,9 @@ class ListExpression : public Expression
 
         void Parent(const Statement *) override;
 
+        Expression *Propagate(const KnownValues &) override;
+        Expression *Clone(CloneContext &) const override;
+
         void Emit(Executable &, EmitType) const override;
 
     private:
@@ -386,6 +531,11 @@ class TupleExpression : public Expression
             return expressions.end();
         }
 
+        void BoundNames(std::list<std::string> &) const override;
+        void BoundMemberNames(std::list<std::string> &) const override;
+        Expression *Propagate(const KnownValues &) override;
+        Expression *Clone(CloneContext &) const override;
+
         void Emit(Executable &, EmitType) const override;
 
     private:
@@ -403,6 +553,9 @@ class RangeExpression : public Expression
 
         void Parent(const Statement *) override;
 
+        Expression *Propagate(const KnownValues &) override;
+        Expression *Clone(CloneContext &) const override;
+
         void Emit(Executable &, EmitType) const override;
 
     private:
@@ -422,6 +575,7 @@ class ConstantExpression : public Expression
     public:
 
         explicit ConstantExpression(const Token &);
+        ConstantExpression(const SourceElement &, const ConstantExpression &);
 
         enum class Type
         {
@@ -447,6 +601,8 @@ class ConstantExpression : public Expression
             (int operatorTokenType, const Expression *,
              Expression *, Expression *);
 
+        Expression *Clone(CloneContext &) const override;
+
         void Emit(Executable &, EmitType) const override;
 
         bool IsTrue() const;
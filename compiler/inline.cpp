@@ -0,0 +1,412 @@
+//
+// Asp function inlining routines from all classes.
+//
+
+#include "statement.hpp"
+#include "expression.hpp"
+#include "asp.h"
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+// Maximum number of expressions in the body of an inlinable function.
+static const unsigned MaxInlineSize = 16;
+
+bool DefStatement::Inlinable(set<string> &freeNames) const
+{
+    // Only functions that return the value of a single expression and take
+    // plain parameters, with constant defaults if any, are inlined.
+    auto returnExpression = ReturnExpression();
+    if (returnExpression == nullptr)
+        return false;
+    VariableExpression placeholder(*this, 0);
+    CloneContext context;
+    for (auto iter = parameterList->ParametersBegin();
+         iter != parameterList->ParametersEnd(); iter++)
+    {
+        auto parameter = *iter;
+        if (parameter->GetType() != Parameter::Type::Positional ||
+            (parameter->HasDefault() &&
+             dynamic_cast<const ConstantExpression *>
+                (parameter->DefaultExpression()) == nullptr))
+            return false;
+        context.parameters[parameter->Name()] = &placeholder;
+    }
+
+    // Ensure the body can be copied and is within the size budget.
+    unique_ptr<Expression> copy(returnExpression->Clone(context));
+    if (copy == nullptr || context.size > MaxInlineSize)
+        return false;
+
+    freeNames = move(context.freeNames);
+    return true;
+}
+
+Expression *DefStatement::Inline
+    (const SourceElement &sourceElement, ArgumentList &argumentList,
+     const KnownValues &values) const
+{
+    // Match arguments with parameters. Leave calls that use argument groups
+    // or that would fail to the engine.
+    vector<const Parameter *> parameters
+        (parameterList->ParametersBegin(), parameterList->ParametersEnd());
+    vector<pair<Argument *, string> > arguments;
+    set<string> boundNames;
+    size_t position = 0;
+    for (auto iter = argumentList.ArgumentsBegin();
+         iter != argumentList.ArgumentsEnd(); iter++)
+    {
+        auto argument = *iter;
+        if (argument->GetType() != Argument::Type::NonGroup)
+            return nullptr;
+
+        string parameterName;
+        if (argument->HasName())
+            parameterName = argument->Name();
+        else if (position != boundNames.size() ||
+                 position >= parameters.size())
+            return nullptr;
+        else
+            parameterName = parameters[position++]->Name();
+        if (!boundNames.insert(parameterName).second)
+            return nullptr;
+        arguments.push_back(make_pair(argument, parameterName));
+    }
+
+    CloneContext context;
+    for (const auto &parameter: parameters)
+    {
+        const auto &name = parameter->Name();
+        if (boundNames.erase(name) != 0)
+            continue;
+        if (!parameter->HasDefault())
+            return nullptr;
+        context.parameters[name] = parameter->DefaultExpression();
+    }
+    if (!boundNames.empty())
+        return nullptr;
+
+    // Substitute constant arguments directly, and the others by way of
+    // temporary variables.
+    vector<int32_t> symbols;
+    vector<unique_ptr<Expression> > temporaryExpressions;
+    for (const auto &argument: arguments)
+    {
+        auto valueExpression = argument.first->ValueExpression();
+        if (dynamic_cast<const ConstantExpression *>(valueExpression)
+            != nullptr)
+        {
+            context.parameters[argument.second] = valueExpression;
+            symbols.push_back(0);
+            continue;
+        }
+
+        auto symbol = values.executable->TemporarySymbol();
+        temporaryExpressions.emplace_back
+            (new VariableExpression(*valueExpression, symbol));
+        context.parameters[argument.second] =
+            temporaryExpressions.back().get();
+        symbols.push_back(symbol);
+    }
+
+    auto bodyExpression = ReturnExpression()->Clone(context);
+    if (bodyExpression == nullptr)
+        return nullptr;
+    auto result = new InlinedCallExpression(sourceElement, name);
+    for (size_t i = 0; i < arguments.size(); i++)
+    {
+        if (symbols[i] != 0)
+            result->AddArgument
+                (arguments[i].second, symbols[i],
+                 arguments[i].first->ReleaseValueExpression());
+    }
+    result->SetBody(bodyExpression);
+    return result;
+}
+
+const Expression *DefStatement::ReturnExpression() const
+{
+    if (block->statements.size() != 1)
+        return nullptr;
+    auto returnStatement = dynamic_cast<const ReturnStatement *>
+        (block->statements.front());
+    return returnStatement == nullptr ?
+        nullptr : returnStatement->GetExpression();
+}
+
+Expression *Expression::Clone(CloneContext &) const
+{
+    // Most expressions are not expected in inlined bodies.
+    return nullptr;
+}
+
+Expression *ConditionalExpression::Clone(CloneContext &context) const
+{
+    unique_ptr<Expression>
+        conditionCopy(conditionExpression->Clone(context)),
+        trueCopy(trueExpression->Clone(context)),
+        falseCopy(falseExpression->Clone(context));
+    if (conditionCopy == nullptr || trueCopy == nullptr ||
+        falseCopy == nullptr)
+        return nullptr;
+
+    context.size++;
+    return new ConditionalExpression
+        (Token(sourceLocation, operatorTokenType),
+         conditionCopy.release(), trueCopy.release(), falseCopy.release());
+}
+
+Expression *ShortCircuitLogicalExpression::Clone
+    (CloneContext &context) const
+{
+    vector<unique_ptr<Expression> > copies;
+    for (const auto &expression: expressions)
+    {
+        copies.emplace_back(expression->Clone(context));
+        if (copies.back() == nullptr)
+            return nullptr;
+    }
+
+    context.size++;
+    auto result = new ShortCircuitLogicalExpression
+        (Token(sourceLocation, operatorTokenType),
+         copies[0].release(), copies[1].release());
+    for (size_t i = 2; i < copies.size(); i++)
+        result->Add(copies[i].release());
+    return result;
+}
+
+Expression *BinaryExpression::Clone(CloneContext &context) const
+{
+    unique_ptr<Expression>
+        leftCopy(leftExpression->Clone(context)),
+        rightCopy(rightExpression->Clone(context));
+    if (leftCopy == nullptr || rightCopy == nullptr)
+        return nullptr;
+
+    context.size++;
+    return new BinaryExpression
+        (Token(sourceLocation, operatorTokenType),
+         leftCopy.release(), rightCopy.release());
+}
+
+Expression *UnaryExpression::Clone(CloneContext &context) const
+{
+    unique_ptr<Expression> copy(expression->Clone(context));
+    if (copy == nullptr)
+        return nullptr;
+
+    context.size++;
+    return new UnaryExpression
+        (Token(sourceLocation, operatorTokenType), copy.release());
+}
+
+Argument *Argument::Clone(CloneContext &context) const
+{
+    unique_ptr<Expression> copy(valueExpression->Clone(context));
+    if (copy == nullptr)
+        return nullptr;
+
+    if (HasName())
+        return new Argument
+            (Token(sourceLocation, TOKEN_NAME, name), copy.release());
+    auto result = new Argument(copy.release(), type);
+    (SourceElement &)*result = *this;
+    return result;
+}
+
+ArgumentList *ArgumentList::Clone(CloneContext &context) const
+{
+    unique_ptr<ArgumentList> result(new ArgumentList);
+    for (const auto &argument: arguments)
+    {
+        auto copy = argument->Clone(context);
+        if (copy == nullptr)
+            return nullptr;
+        result->Add(copy);
+    }
+    (SourceElement &)*result = *this;
+    return result.release();
+}
+
+Expression *CallExpression::Clone(CloneContext &context) const
+{
+    unique_ptr<Expression> functionCopy(functionExpression->Clone(context));
+    unique_ptr<ArgumentList> argumentListCopy(argumentList->Clone(context));
+    if (functionCopy == nullptr || argumentListCopy == nullptr)
+        return nullptr;
+
+    context.size++;
+    auto result = new CallExpression
+        (functionCopy.release(), argumentListCopy.release());
+    (SourceElement &)*result = *this;
+    return result;
+}
+
+Expression *ElementExpression::Clone(CloneContext &context) const
+{
+    unique_ptr<Expression>
+        sequenceCopy(sequenceExpression->Clone(context)),
+        indexCopy(indexExpression->Clone(context));
+    if (sequenceCopy == nullptr || indexCopy == nullptr)
+        return nullptr;
+
+    context.size++;
+    auto result = new ElementExpression
+        (sequenceCopy.release(), indexCopy.release());
+    (SourceElement &)*result = *this;
+    return result;
+}
+
+Expression *MemberExpression::Clone(CloneContext &context) const
+{
+    unique_ptr<Expression> copy(expression->Clone(context));
+    if (copy == nullptr)
+        return nullptr;
+
+    context.size++;
+    return new MemberExpression
+        (copy.release(), Token(sourceLocation, TOKEN_NAME, name));
+}
+
+Expression *VariableExpression::Clone(CloneContext &context) const
+{
+    // Substitute for references to parameters.
+    if (!hasSymbol)
+    {
+        auto iter = context.parameters.find(name);
+        if (iter != context.parameters.end())
+        {
+            auto result = iter->second->Clone(context);
+            (SourceElement &)*result = *this;
+            return result;
+        }
+    }
+
+    context.size++;
+    if (hasSymbol)
+        return new VariableExpression(*this, symbol);
+    context.freeNames.insert(name);
+    return new VariableExpression(Token(sourceLocation, TOKEN_NAME, name));
+}
+
+Expression *SymbolExpression::Clone(CloneContext &context) const
+{
+    context.size++;
+    return new SymbolExpression
+        (Token(sourceLocation), Token(sourceLocation, TOKEN_NAME, name));
+}
+
+KeyValuePair *KeyValuePair::Clone(CloneContext &context) const
+{
+    unique_ptr<Expression>
+        keyCopy(keyExpression->Clone(context)),
+        valueCopy(valueExpression->Clone(context));
+    if (keyCopy == nullptr || valueCopy == nullptr)
+        return nullptr;
+
+    return new KeyValuePair(keyCopy.release(), valueCopy.release());
+}
+
+Expression *DictionaryExpression::Clone(CloneContext &context) const
+{
+    unique_ptr<DictionaryExpression> result
+        (new DictionaryExpression(Token(sourceLocation)));
+    for (const auto &entry: entries)
+    {
+        auto copy = entry->Clone(context);
+        if (copy == nullptr)
+            return nullptr;
+        result->Add(copy);
+    }
+
+    context.size++;
+    (SourceElement &)*result = *this;
+    return result.release();
+}
+
+Expression *SetExpression::Clone(CloneContext &context) const
+{
+    unique_ptr<SetExpression> result
+        (new SetExpression(Token(sourceLocation)));
+    for (const auto &expression: expressions)
+    {
+        auto copy = expression->Clone(context);
+        if (copy == nullptr)
+            return nullptr;
+        result->Add(copy);
+    }
+
+    context.size++;
+    (SourceElement &)*result = *this;
+    return result.release();
+}
+
+Expression *ListExpression::Clone(CloneContext &context) const
+{
+    unique_ptr<ListExpression> result
+        (new ListExpression(Token(sourceLocation)));
+    for (const auto &expression: expressions)
+    {
+        auto copy = expression->Clone(context);
+        if (copy == nullptr)
+            return nullptr;
+        result->Add(copy);
+    }
+
+    context.size++;
+    (SourceElement &)*result = *this;
+    return result.release();
+}
+
+Expression *TupleExpression::Clone(CloneContext &context) const
+{
+    unique_ptr<TupleExpression> result
+        (new TupleExpression(Token(sourceLocation)));
+    for (const auto &expression: expressions)
+    {
+        auto copy = expression->Clone(context);
+        if (copy == nullptr)
+            return nullptr;
+        result->Add(copy);
+    }
+
+    context.size++;
+    (SourceElement &)*result = *this;
+    return result.release();
+}
+
+Expression *RangeExpression::Clone(CloneContext &context) const
+{
+    unique_ptr<Expression> startCopy, endCopy, stepCopy;
+    if (startExpression != nullptr)
+    {
+        startCopy.reset(startExpression->Clone(context));
+        if (startCopy == nullptr)
+            return nullptr;
+    }
+    if (endExpression != nullptr)
+    {
+        endCopy.reset(endExpression->Clone(context));
+        if (endCopy == nullptr)
+            return nullptr;
+    }
+    if (stepExpression != nullptr)
+    {
+        stepCopy.reset(stepExpression->Clone(context));
+        if (stepCopy == nullptr)
+            return nullptr;
+    }
+
+    context.size++;
+    return new RangeExpression
+        (Token(sourceLocation),
+         startCopy.release(), endCopy.release(), stepCopy.release());
+}
+
+Expression *ConstantExpression::Clone(CloneContext &context) const
+{
+    context.size++;
+    return new ConstantExpression(*this, *this);
+}
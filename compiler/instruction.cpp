@@ -3,6 +3,7 @@
 //
 
 #include "instruction.hpp"
+#include "arena.hpp"
 #include "opcode.h"
 #include <map>
 #include <algorithm>
@@ -10,11 +11,42 @@
 
 using namespace std;
 
+// Op codes of the 1- and 2-byte forms of instructions whose target is
+// otherwise given by a 4-byte code address. The short forms encode the
+// target as a signed displacement from the end of the instruction.
+static const map<uint8_t, pair<uint8_t, uint8_t> > ShortTargetOpCodes =
+{
+    {OpCode_PUSHCA, {OpCode_PUSHCA1, OpCode_PUSHCA2}},
+    {OpCode_JMPF, {OpCode_JMPF1, OpCode_JMPF2}},
+    {OpCode_JMPT, {OpCode_JMPT1, OpCode_JMPT2}},
+    {OpCode_JMP, {OpCode_JMP1, OpCode_JMP2}},
+    {OpCode_LOR, {OpCode_LOR1, OpCode_LOR2}},
+    {OpCode_LAND, {OpCode_LAND1, OpCode_LAND2}},
+};
+
 static inline char Byte(uint64_t value, unsigned index)
 {
     return (value >> (index << 3)) & 0xFF;
 }
 
+// Modules may be compiled on several threads at once, each of which allocates
+// and frees only its own instructions, so each thread has its own arena.
+static Arena &InstructionArena()
+{
+    static thread_local Arena arena;
+    return arena;
+}
+
+void *Instruction::operator new(size_t size)
+{
+    return InstructionArena().Allocate(size);
+}
+
+void Instruction::operator delete(void *p)
+{
+    InstructionArena().Free(p);
+}
+
 Instruction::Instruction(uint8_t opCode, const string &comment) :
     opCode(opCode),
     comment(comment),
@@ -59,19 +91,81 @@ void Instruction::Fix(uint32_t targetOffset)
     fixed = true;
 }
 
+bool Instruction::HasShortTarget() const
+{
+    return
+        targetLocationDefined &&
+        ShortTargetOpCodes.find(opCode) != ShortTargetOpCodes.end();
+}
+
+void Instruction::ShortenTarget()
+{
+    if (HasShortTarget())
+        targetSize = 1;
+}
+
+bool Instruction::FitTarget(uint32_t targetOffset)
+{
+    // Widen the target operand if the displacement to the given target
+    // offset is out of its range, indicating whether it was widened.
+    if (targetSize >= sizeof targetOffset)
+        return false;
+    int64_t displacement =
+        static_cast<int64_t>(targetOffset) - (offset + Size());
+    int64_t limit = INT64_C(1) << (8 * targetSize - 1);
+    if (displacement >= -limit && displacement < limit)
+        return false;
+    targetSize = targetSize == 1 ? 2 : sizeof targetOffset;
+    return true;
+}
+
+int32_t *Instruction::SymbolOperand()
+{
+    return nullptr;
+}
+
+void Instruction::RenumberSymbol(int32_t symbol)
+{
+    auto operand = SymbolOperand();
+    if (operand == nullptr)
+        throw string("Invalid instruction: Renumbering absent symbol");
+    *operand = symbol;
+
+    // The low two bits of all symbol operand op codes encode the operand
+    // size as 1, 2, or 4 bytes.
+    auto size = max(1U, OperandSize(symbol));
+    opCode = static_cast<uint8_t>
+        ((opCode & ~0x03) | (size == 1 ? 0x01 : size == 2 ? 0x02 : 0x03));
+}
+
 unsigned Instruction::Size() const
 {
     return
         sizeof opCode + OperandsSize() +
-        (targetLocationDefined ? sizeof targetOffset : 0);
+        (targetLocationDefined ? targetSize : 0);
 }
 
 void Instruction::Write(ostream &os) const
 {
-    os.put(*reinterpret_cast<const char *>(&opCode));
+    uint8_t code = opCode;
+    if (targetSize < sizeof targetOffset)
+    {
+        const auto &shortOpCodes = ShortTargetOpCodes.find(opCode)->second;
+        code = targetSize == 1 ? shortOpCodes.first : shortOpCodes.second;
+    }
+    os.put(*reinterpret_cast<const char *>(&code));
     WriteOperands(os);
     if (targetLocationDefined)
-        WriteField(os, targetOffset, 4);
+    {
+        if (targetSize < sizeof targetOffset)
+            WriteField
+                (os,
+                 static_cast<uint64_t>
+                    (static_cast<int64_t>(targetOffset) - (offset + Size())),
+                 targetSize);
+        else
+            WriteField(os, targetOffset, 4);
+    }
 }
 
 void Instruction::Print(ostream &os) const
@@ -139,6 +233,26 @@ uint8_t Instruction::OpCode() const
     return opCode;
 }
 
+bool Instruction::HasTargetLocation() const
+{
+    return targetLocationDefined;
+}
+
+const string &Instruction::Comment() const
+{
+    return comment;
+}
+
+void Instruction::WriteOperandsOnly(ostream &os) const
+{
+    WriteOperands(os);
+}
+
+void Instruction::PrintCodeOnly(ostream &os) const
+{
+    PrintCode(os);
+}
+
 NullInstruction::NullInstruction() :
     Instruction(0)
 {
@@ -164,6 +278,65 @@ void NullInstruction::PrintCode(ostream &) const
     // Do nothing.
 }
 
+ObjectInstruction::ObjectInstruction
+    (uint8_t opCode, const string &operands,
+     const string &code, const string &comment) :
+    Instruction(opCode, comment),
+    hasSymbol(false),
+    operands(operands), code(code)
+{
+}
+
+ObjectInstruction::ObjectInstruction
+    (uint8_t opCode, const Executable::Location &targetLocation,
+     const string &operands,
+     const string &code, const string &comment) :
+    Instruction(opCode, targetLocation, comment),
+    hasSymbol(false),
+    operands(operands), code(code)
+{
+}
+
+ObjectInstruction::ObjectInstruction
+    (uint8_t opCode, int32_t symbol,
+     const string &code, const string &comment) :
+    Instruction(opCode, comment),
+    hasSymbol(true),
+    code(code)
+{
+    RenumberSymbol(symbol);
+}
+
+int32_t *ObjectInstruction::SymbolOperand()
+{
+    return hasSymbol ? &symbol : nullptr;
+}
+
+unsigned ObjectInstruction::OperandsSize() const
+{
+    return
+        hasSymbol ? max(1U, OperandSize(symbol)) :
+        static_cast<unsigned>(operands.size());
+}
+
+void ObjectInstruction::WriteOperands(ostream &os) const
+{
+    if (hasSymbol)
+    {
+        uint32_t uSymbol = *reinterpret_cast<const uint32_t *>(&symbol);
+        WriteField(os, uSymbol, OperandsSize());
+    }
+    else
+        os.write(operands.data(), operands.size());
+}
+
+void ObjectInstruction::PrintCode(ostream &os) const
+{
+    os << code;
+    if (hasSymbol)
+        os << ' ' << symbol;
+}
+
 SimpleInstruction::SimpleInstruction
     (uint8_t opCode, const string &comment) :
     Instruction(opCode, comment)
@@ -221,6 +394,8 @@ void SimpleInstruction::PrintCode(ostream &os) const
         {OpCode_IS, "IS"},
         {OpCode_SET, "SET"},
         {OpCode_SETP, "SETP"},
+        {OpCode_ADDSET, "ADDSET"},
+        {OpCode_ADDSETP, "ADDSETP"},
         {OpCode_ERASE, "ERASE"},
         {OpCode_SITER, "SITER"},
         {OpCode_TITER, "TITER"},
@@ -234,6 +409,7 @@ void SimpleInstruction::PrintCode(ostream &os) const
         {OpCode_LAND, "LAND"},
         {OpCode_CALL, "CALL"},
         {OpCode_RET, "RET"},
+        {OpCode_TCALL, "TCALL"},
         {OpCode_XMOD, "XMOD"},
         {OpCode_MKFUN, "MKFUN"},
         {OpCode_MKKVP, "MKKVP"},
@@ -333,6 +509,11 @@ PushSymbolInstruction::PushSymbolInstruction
 {
 }
 
+int32_t *PushSymbolInstruction::SymbolOperand()
+{
+    return &symbol;
+}
+
 unsigned PushSymbolInstruction::OperandsSize() const
 {
     return max(1U, OperandSize(symbol));
@@ -434,6 +615,11 @@ PushModuleInstruction::PushModuleInstruction
 {
 }
 
+int32_t *PushModuleInstruction::SymbolOperand()
+{
+    return &symbol;
+}
+
 unsigned PushModuleInstruction::OperandsSize() const
 {
     return max(1U, OperandSize(symbol));
@@ -457,6 +643,11 @@ PopInstruction::PopInstruction
 {
 }
 
+unsigned PopInstruction::Count() const
+{
+    return static_cast<uint8_t>(count);
+}
+
 unsigned PopInstruction::OperandsSize() const
 {
     return count == 1 ? 0 : 1;
@@ -513,6 +704,18 @@ LoadInstruction::LoadInstruction
 {
 }
 
+int32_t LoadInstruction::Symbol() const
+{
+    return symbol;
+}
+
+int32_t *LoadInstruction::SymbolOperand()
+{
+    return
+        OpCode() == OpCode_LD || OpCode() == OpCode_LDA ?
+        nullptr : &symbol;
+}
+
 unsigned LoadInstruction::OperandsSize() const
 {
     return
@@ -543,6 +746,11 @@ SetInstruction::SetInstruction(bool pop, const string &comment) :
 {
 }
 
+AddSetInstruction::AddSetInstruction(bool pop, const string &comment) :
+    SimpleInstruction(pop ? OpCode_ADDSETP : OpCode_ADDSET, comment)
+{
+}
+
 DeleteInstruction::DeleteInstruction
     (int32_t symbol, const string &comment) :
     Instruction
@@ -553,6 +761,11 @@ DeleteInstruction::DeleteInstruction
 {
 }
 
+int32_t *DeleteInstruction::SymbolOperand()
+{
+    return &symbol;
+}
+
 unsigned DeleteInstruction::OperandsSize() const
 {
     return max(1U, OperandSize(symbol));
@@ -587,6 +800,11 @@ GlobalInstruction::GlobalInstruction
 {
 }
 
+int32_t *GlobalInstruction::SymbolOperand()
+{
+    return &symbol;
+}
+
 unsigned GlobalInstruction::OperandsSize() const
 {
     return max(1U, OperandSize(symbol));
@@ -647,8 +865,8 @@ JumpInstruction::JumpInstruction
 {
 }
 
-CallInstruction::CallInstruction(const string &comment) :
-    SimpleInstruction(OpCode_CALL, comment)
+CallInstruction::CallInstruction(bool tail, const string &comment) :
+    SimpleInstruction(tail ? OpCode_TCALL : OpCode_CALL, comment)
 {
 }
 
@@ -669,6 +887,11 @@ AddModuleInstruction::AddModuleInstruction
 {
 }
 
+int32_t *AddModuleInstruction::SymbolOperand()
+{
+    return &symbol;
+}
+
 unsigned AddModuleInstruction::OperandsSize() const
 {
     return max(1U, OperandSize(symbol));
@@ -700,6 +923,11 @@ LoadModuleInstruction::LoadModuleInstruction
 {
 }
 
+int32_t *LoadModuleInstruction::SymbolOperand()
+{
+    return &symbol;
+}
+
 unsigned LoadModuleInstruction::OperandsSize() const
 {
     return max(1U, OperandSize(symbol));
@@ -738,6 +966,15 @@ MakeArgumentInstruction::MakeArgumentInstruction
 {
 }
 
+int32_t *MakeArgumentInstruction::SymbolOperand()
+{
+    return
+        OpCode() != OpCode_MKNARG1 &&
+        OpCode() != OpCode_MKNARG2 &&
+        OpCode() != OpCode_MKNARG4 ?
+        nullptr : &symbol;
+}
+
 unsigned MakeArgumentInstruction::OperandsSize() const
 {
     return
@@ -788,6 +1025,11 @@ MakeParameterInstruction::MakeParameterInstruction
 {
 }
 
+int32_t *MakeParameterInstruction::SymbolOperand()
+{
+    return &symbol;
+}
+
 unsigned MakeParameterInstruction::OperandsSize() const
 {
     return max(1U, OperandSize(symbol));
@@ -877,6 +1119,13 @@ MemberInstruction::MemberInstruction
 {
 }
 
+int32_t *MemberInstruction::SymbolOperand()
+{
+    return
+        OpCode() == OpCode_MEM || OpCode() == OpCode_MEMA ?
+        nullptr : &symbol;
+}
+
 unsigned MemberInstruction::OperandsSize() const
 {
     return
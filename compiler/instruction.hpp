@@ -8,6 +8,7 @@
 #include "executable.hpp"
 #include <iostream>
 #include <string>
+#include <cstddef>
 #include <cstdint>
 
 class Instruction
@@ -26,6 +27,11 @@ class Instruction
         // Destructor.
         virtual ~Instruction() = default;
 
+        // Allocation operators. Instructions are numerous and small, so they
+        // are allocated from an arena.
+        static void *operator new(std::size_t);
+        static void operator delete(void *);
+
         // Address methods.
         void Offset(std::uint32_t);
         std::uint32_t Offset() const;
@@ -33,6 +39,15 @@ class Instruction
         bool Fixed() const;
         void Fix(std::uint32_t targetOffset);
 
+        // Target operand size methods.
+        bool HasShortTarget() const;
+        void ShortenTarget();
+        bool FitTarget(std::uint32_t targetOffset);
+
+        // Symbol operand methods.
+        virtual std::int32_t *SymbolOperand();
+        void RenumberSymbol(std::int32_t);
+
         // Code generation methods.
         virtual unsigned Size() const;
         virtual void Write(std::ostream &) const;
@@ -40,6 +55,13 @@ class Instruction
         // Listing methods.
         virtual void Print(std::ostream &) const;
 
+        // Inspection methods.
+        std::uint8_t OpCode() const;
+        bool HasTargetLocation() const;
+        const std::string &Comment() const;
+        void WriteOperandsOnly(std::ostream &) const;
+        void PrintCodeOnly(std::ostream &) const;
+
     protected:
 
         // Internal methods.
@@ -50,13 +72,13 @@ class Instruction
         static unsigned OperandSize(std::int32_t value);
         static void WriteField
             (std::ostream &, std::uint64_t value, unsigned size);
-        std::uint8_t OpCode() const;
 
     private:
 
         // Data.
         std::uint8_t opCode;
         std::uint32_t offset = 0, targetOffset = 0;
+        unsigned targetSize = 4;
         std::string comment;
         bool targetLocationDefined, fixed;
         Executable::Location targetLocation;
@@ -77,6 +99,39 @@ class NullInstruction : public Instruction
         void PrintCode(std::ostream &) const override;
 };
 
+class ObjectInstruction : public Instruction
+{
+    public:
+
+        // Constructors for instructions restored from a module object. The
+        // operands are given either in encoded form or as a symbol, which is
+        // printed after the given code.
+        ObjectInstruction
+            (std::uint8_t opCode, const std::string &operands,
+             const std::string &code, const std::string &comment);
+        ObjectInstruction
+            (std::uint8_t opCode, const Executable::Location &,
+             const std::string &operands,
+             const std::string &code, const std::string &comment);
+        ObjectInstruction
+            (std::uint8_t opCode, std::int32_t symbol,
+             const std::string &code, const std::string &comment);
+
+        std::int32_t *SymbolOperand() override;
+
+    protected:
+
+        unsigned OperandsSize() const override;
+        void WriteOperands(std::ostream &) const override;
+        void PrintCode(std::ostream &) const override;
+
+    private:
+
+        bool hasSymbol;
+        std::int32_t symbol = 0;
+        std::string operands, code;
+};
+
 class SimpleInstruction : public Instruction
 {
     public:
@@ -159,6 +214,8 @@ class PushSymbolInstruction : public Instruction
         explicit PushSymbolInstruction
             (std::int32_t symbol, const std::string &comment = "");
 
+        std::int32_t *SymbolOperand() override;
+
     protected:
 
         unsigned OperandsSize() const override;
@@ -251,6 +308,8 @@ class PushModuleInstruction : public Instruction
         PushModuleInstruction
             (std::int32_t symbol, const std::string &comment = "");
 
+        std::int32_t *SymbolOperand() override;
+
     protected:
 
         unsigned OperandsSize() const override;
@@ -269,6 +328,8 @@ class PopInstruction : public Instruction
         explicit PopInstruction
             (std::uint8_t count = 1, const std::string &comment = "");
 
+        unsigned Count() const;
+
     protected:
 
         unsigned OperandsSize() const override;
@@ -315,6 +376,10 @@ class LoadInstruction : public Instruction
             (std::int32_t symbol, bool address,
              const std::string &comment = "");
 
+        std::int32_t Symbol() const;
+
+        std::int32_t *SymbolOperand() override;
+
     protected:
 
         unsigned OperandsSize() const override;
@@ -334,6 +399,14 @@ class SetInstruction : public SimpleInstruction
             (bool pop, const std::string &comment = "");
 };
 
+class AddSetInstruction : public SimpleInstruction
+{
+    public:
+
+        explicit AddSetInstruction
+            (bool pop, const std::string &comment = "");
+};
+
 class DeleteInstruction : public Instruction
 {
     public:
@@ -341,6 +414,8 @@ class DeleteInstruction : public Instruction
         explicit DeleteInstruction
             (std::int32_t symbol, const std::string &comment = "");
 
+        std::int32_t *SymbolOperand() override;
+
     protected:
 
         unsigned OperandsSize() const override;
@@ -368,6 +443,8 @@ class GlobalInstruction : public Instruction
             (std::int32_t symbol, bool local,
              const std::string &comment = "");
 
+        std::int32_t *SymbolOperand() override;
+
     protected:
 
         unsigned OperandsSize() const override;
@@ -437,7 +514,7 @@ class CallInstruction : public SimpleInstruction
     public:
 
         explicit CallInstruction
-            (const std::string &comment = "");
+            (bool tail = false, const std::string &comment = "");
 };
 
 class ReturnInstruction : public SimpleInstruction
@@ -456,6 +533,8 @@ class AddModuleInstruction : public Instruction
             (std::int32_t symbol, const Executable::Location &,
              const std::string &comment = "");
 
+        std::int32_t *SymbolOperand() override;
+
     protected:
 
         unsigned OperandsSize() const override;
@@ -482,6 +561,8 @@ class LoadModuleInstruction : public Instruction
         explicit LoadModuleInstruction
             (std::int32_t symbol, const std::string &comment = "");
 
+        std::int32_t *SymbolOperand() override;
+
     protected:
 
         unsigned OperandsSize() const override;
@@ -510,6 +591,8 @@ class MakeArgumentInstruction : public Instruction
         explicit MakeArgumentInstruction
             (std::int32_t symbol, const std::string &comment = "");
 
+        std::int32_t *SymbolOperand() override;
+
     protected:
 
         unsigned OperandsSize() const override;
@@ -537,6 +620,8 @@ class MakeParameterInstruction : public Instruction
             (std::int32_t symbol, Type type,
              const std::string &comment = "");
 
+        std::int32_t *SymbolOperand() override;
+
     protected:
 
         unsigned OperandsSize() const override;
@@ -607,6 +692,8 @@ class MemberInstruction : public Instruction
             (std::int32_t symbol, bool address,
              const std::string &comment = "");
 
+        std::int32_t *SymbolOperand() override;
+
     protected:
 
         unsigned OperandsSize() const override;
@@ -0,0 +1,186 @@
+//
+// Asp executable code layout implementation.
+//
+
+#include "executable.hpp"
+#include "instruction.hpp"
+#include "opcode.h"
+#include <algorithm>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+bool Executable::ReadProfile(istream &is)
+{
+    // Each line gives an instruction count followed by the line, column, and
+    // file name of the source location, separated by tabs.
+    Profile newProfile;
+    string profileLine;
+    while (getline(is, profileLine))
+    {
+        if (profileLine.empty())
+            continue;
+
+        istringstream lineStream(profileLine);
+        uint64_t count;
+        unsigned line, column;
+        string fileName;
+        if (!(lineStream >> count >> line >> column) ||
+            lineStream.get() != '\t' ||
+            !getline(lineStream, fileName) || fileName.empty())
+            return false;
+        newProfile[make_tuple(fileName, line, column)] += count;
+    }
+    if (is.bad())
+        return false;
+
+    profile.swap(newProfile);
+    return true;
+}
+
+void Executable::LayOutCode()
+{
+    // Index the instructions in their current order.
+    vector<Location> locations;
+    unordered_map<const InstructionInfo *, size_t> indices;
+    for (auto iter = instructions.begin(); iter != instructions.end(); iter++)
+    {
+        indices.emplace(&*iter, locations.size());
+        locations.push_back(iter);
+    }
+    auto indexOf = [&](const Location &location)
+    {
+        return indices.find(&*location)->second;
+    };
+    auto previousInstruction = [&](size_t index)
+    {
+        while (index > 0 && locations[--index]->instruction->Size() == 0)
+            ;
+        return index;
+    };
+
+    // Find the code of each function, which a jump takes the function's
+    // definition around and which starts at the address pushed to make the
+    // function. Such code must end by returning, and anything that follows
+    // the return stays behind.
+    struct Region
+    {
+        size_t first, entry, end;
+        bool movable;
+        uint64_t weight;
+    };
+    vector<Region> regions;
+    for (size_t i = 0; i < locations.size(); i++)
+    {
+        const auto &instruction = locations[i]->instruction;
+        if (instruction->Size() == 0 ||
+            instruction->OpCode() != OpCode_PUSHCA)
+            continue;
+        auto entryIndex = indexOf(instruction->TargetLocation());
+        auto jumpIndex = previousInstruction(entryIndex);
+        const auto &jumpInstruction = locations[jumpIndex]->instruction;
+        if (jumpInstruction->Size() == 0 ||
+            jumpInstruction->OpCode() != OpCode_JMP)
+            continue;
+        auto endIndex = indexOf(jumpInstruction->TargetLocation());
+        if (endIndex <= entryIndex || endIndex > i)
+            continue;
+        auto returnIndex = previousInstruction(endIndex);
+        const auto &returnInstruction = locations[returnIndex]->instruction;
+        if (returnIndex < entryIndex || returnInstruction->Size() == 0 ||
+            returnInstruction->OpCode() != OpCode_RET)
+            continue;
+        regions.push_back
+            ({jumpIndex + 1, entryIndex, returnIndex + 1, true, 0});
+    }
+
+    // Consider only the outermost functions; nested ones move along with
+    // them.
+    sort
+        (regions.begin(), regions.end(),
+         [](const Region &left, const Region &right)
+         {
+             return left.first < right.first;
+         });
+    vector<Region> outerRegions;
+    for (const auto &region: regions)
+    {
+        if (outerRegions.empty() || region.first >= outerRegions.back().end)
+            outerRegions.push_back(region);
+    }
+    regions.swap(outerRegions);
+
+    // Leave in place any function whose code is entered other than by way of
+    // its address or left other than by returning.
+    auto regionOf = [&](size_t index) -> Region *
+    {
+        auto iter = upper_bound
+            (regions.begin(), regions.end(), index,
+             [](size_t index, const Region &region)
+             {
+                 return index < region.first;
+             });
+        if (iter == regions.begin() || index >= (--iter)->end)
+            return nullptr;
+        return &*iter;
+    };
+    for (size_t i = 0; i < locations.size(); i++)
+    {
+        const auto &instruction = locations[i]->instruction;
+        if (instruction->Size() == 0 || !instruction->HasTargetLocation())
+            continue;
+        auto targetIndex = indexOf(instruction->TargetLocation());
+        auto sourceRegion = regionOf(i);
+        auto targetRegion = regionOf(targetIndex);
+        if (sourceRegion == targetRegion ||
+            (instruction->OpCode() == OpCode_PUSHCA &&
+             targetRegion != nullptr && targetRegion->entry == targetIndex))
+            continue;
+        if (sourceRegion != nullptr)
+            sourceRegion->movable = false;
+        if (targetRegion != nullptr)
+            targetRegion->movable = false;
+    }
+
+    // Weigh each function by the instructions executed at the distinct
+    // source locations of its code.
+    vector<Region *> movableRegions;
+    for (auto &region: regions)
+    {
+        if (!region.movable)
+            continue;
+        set<Profile::key_type> keys;
+        for (auto i = region.first; i < region.end; i++)
+        {
+            const auto &sourceLocation = locations[i]->sourceLocation;
+            if (!sourceLocation.Defined())
+                continue;
+            auto key = make_tuple
+                (sourceLocation.fileName,
+                 sourceLocation.line, sourceLocation.column);
+            if (!keys.insert(key).second)
+                continue;
+            auto iter = profile.find(key);
+            if (iter != profile.end())
+                region.weight += iter->second;
+        }
+        movableRegions.push_back(&region);
+    }
+
+    // Move the functions past the end of the module code, which is thereby
+    // left contiguous, placing the most frequently executed first and those
+    // never executed last, otherwise keeping their original order.
+    stable_sort
+        (movableRegions.begin(), movableRegions.end(),
+         [](const Region *left, const Region *right)
+         {
+             return left->weight > right->weight;
+         });
+    for (const auto &region: movableRegions)
+        instructions.splice
+            (instructions.end(), instructions,
+             locations[region->first], next(locations[region->end - 1]));
+}
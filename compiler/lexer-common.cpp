@@ -116,7 +116,7 @@ Token *Lexer::ProcessNumber()
         Invalid,
     } state = State::Null;
     string lex;
-    while (!is.eof())
+    while (next != end)
     {
         auto c = Peek();
 
@@ -534,15 +534,12 @@ Token *Lexer::ProcessString()
 
 Token *Lexer::ProcessName()
 {
-    string lex;
-    while (!is.eof())
-    {
-        auto c = Peek();
-        if (!isalpha(c) && !isdigit(c) && c != '_')
-            break;
-        lex += static_cast<char>(c);
+    // Scan the name in place and copy it out in one piece.
+    auto start = next;
+    int c;
+    while (c = Peek(), isalpha(c) || isdigit(c) || c == '_')
         Get();
-    }
+    string lex(start, next);
 
     // Extract keywords.
     auto iter = keywords.find(lex);
@@ -552,41 +549,29 @@ Token *Lexer::ProcessName()
         new Token(sourceLocation, TOKEN_NAME, lex);
 }
 
-int Lexer::Peek(unsigned n)
+void Lexer::LoadSource(istream &is)
 {
-    if (n < prefetch.size())
-        return prefetch[n];
+    // Read the entire source into memory, so that scanning proceeds over a
+    // contiguous buffer rather than one stream call per character.
+    char buffer[0x10000];
+    while (is.read(buffer, sizeof buffer), is.gcount() > 0)
+        source.append(buffer, static_cast<size_t>(is.gcount()));
 
-    int c = EOF;
-    for (n -= static_cast<unsigned>(prefetch.size()), n++;
-         !is.eof() && n > 0; n--)
-    {
-        c = Read();
-        prefetch.push_back(c);
-    }
+    // Ensure the last character ends a line.
+    source += '\n';
 
-    return c;
+    next = source.data();
+    end = next + source.size();
 }
 
-int Lexer::Read()
+int Lexer::Peek(unsigned n)
 {
-    int c;
-    if (!readahead.empty())
-    {
-        c = readahead.front();
-        readahead.pop_front();
-        if (c == EOF)
-            return c;
-    }
-    else
-        c = is.get();
-
-    // Ensure the last character ends a line.
-    if (c == EOF)
-    {
-        readahead.push_back(c);
-        c = '\n';
-    }
+    return
+        n < static_cast<size_t>(end - next) ?
+        static_cast<unsigned char>(next[n]) : EOF;
+}
 
-    return c;
+int Lexer::Read()
+{
+    return next != end ? static_cast<unsigned char>(*next++) : EOF;
 }
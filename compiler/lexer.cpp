@@ -15,9 +15,9 @@ static bool IsSpecial(int);
 bool Lexer::keywordsInitialized = true;
 
 Lexer::Lexer(istream &is, const string &fileName) :
-    is(is),
     caret(fileName, 1, 1)
 {
+    LoadSource(is);
 }
 
 Token *Lexer::Next()
@@ -246,15 +246,7 @@ Token *Lexer::ProcessIndent()
 
 int Lexer::Get()
 {
-    // Get the next character from the peek prefetch or the file as appropriate.
-    int c;
-    if (!prefetch.empty())
-    {
-        c = prefetch.front();
-        prefetch.pop_front();
-    }
-    else
-        c = Read();
+    int c = Read();
 
     // Maintain indent level.
     if (checkIndent && isspace(c) && c != '\n')
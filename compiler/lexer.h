@@ -44,6 +44,7 @@ class Lexer
         Token *ProcessIndent();
 
         // Character methods.
+        void LoadSource(std::istream &);
         int Get();
         int Peek(unsigned offset = 0);
         int Read();
@@ -56,9 +57,8 @@ class Lexer
         static std::map<std::string, int> keywords;
 
         // Data.
-        std::istream &is;
-        std::deque<int> prefetch;
-        std::deque<int> readahead;
+        std::string source;
+        const char *next, *end;
         SourceLocation sourceLocation, caret;
         bool checkIndent = true, expectIndent = false, continueLine = false;
         std::deque<std::size_t> indents;
@@ -2,15 +2,17 @@
 // Asp compiler main.
 //
 
-#include "lexer.h"
 #include "compiler.h"
 #include "executable.hpp"
 #include "symbol.hpp"
 #include "asp.h"
 #include "search-path.hpp"
+#include "module-object.hpp"
+#include "module-pool.hpp"
 #include <fstream>
 #include <iostream>
 #include <iomanip>
+#include <sstream>
 #include <cstdio>
 #include <string>
 #include <cstring>
@@ -32,14 +34,10 @@
 #endif
 
 static const double DefaultCodeSizeWarningRatio = 0.8;
-
-// Lemon parser.
-extern "C" {
-void *ParseAlloc(void *(*malloc)(size_t), Compiler *);
-void Parse(void *parser, int yymajor, Token *yyminor);
-void ParseFree(void *parser, void (*free)(void *));
-void ParseTrace(FILE *, const char *prefix);
-}
+static const long MaxOptimizationLevel = 2;
+static const long MaxThreadCount = 256;
+static const long MinCompressionBlockSize = 64;
+static const long MaxCompressionBlockSize = 65536;
 
 using namespace std;
 
@@ -103,8 +101,32 @@ static void Usage()
         << "            the code size warning level ("
         << COMMAND_OPTION_PREFIXES[0] << "w option).\n"
         << COMMAND_OPTION_PREFIXES[0]
+        << "f FILE     Lay out the code according to the execution profile"
+        << " in FILE, as\n"
+        << "            recorded by asps. The code of the functions executed"
+        << " most is placed\n"
+        << "            together, after the module code, and that of"
+        << " functions not executed\n"
+        << "            is placed last, reducing code page loads.\n"
+        << COMMAND_OPTION_PREFIXES[0]
         << "h          Print usage information and exit.\n"
         << COMMAND_OPTION_PREFIXES[0]
+        << "j COUNT    Number of threads used to compile modules. With more"
+        << " than one, the\n"
+        << "            modules imported by each module are compiled in"
+        << " parallel, ahead of\n"
+        << "            being merged in the usual order. The output is the"
+        << " same either way.\n"
+        << "            The default is 1.\n"
+        << COMMAND_OPTION_PREFIXES[0]
+        << "m DIR      Cache compiled module objects (*.aspo) in the directory"
+        << " DIR, which\n"
+        << "            must already exist. A module whose source,"
+        << " application spec, and\n"
+        << "            optimization level are unchanged since its object was"
+        << " written is\n"
+        << "            not recompiled.\n"
+        << COMMAND_OPTION_PREFIXES[0]
         << "o FILE     Write outputs to FILE.* instead of basing file names"
         << " on the SCRIPT\n"
         << "            file name. If FILE ends with .aspe, its base name is"
@@ -114,6 +136,37 @@ static void Usage()
         << "            given by FILE. In this case, the directory must"
         << " already exist.\n"
         << COMMAND_OPTION_PREFIXES[0]
+        << "O LEVEL    Optimization level. Level 0, the default, disables"
+        << " optimization.\n"
+        << "            Level 1 applies peephole optimizations to the"
+        << " generated\n"
+        << "            instructions, including removal of unreachable code"
+        << " and branches on\n"
+        << "            constant conditions and conversion of calls whose"
+        << " result is\n"
+        << "            returned at once into tail calls, uses short"
+        << " relative\n"
+        << "            encodings for jumps and code addresses where they"
+        << " reach, and\n"
+        << "            combines addition and assignment to simple variables"
+        << " so that\n"
+        << "            strings can be appended to in place. Level 2 also\n"
+        << "            propagates the values of module variables that are"
+        << " assigned a\n"
+        << "            constant only once, and that no module assigns as a"
+        << " member, into\n"
+        << "            the code that runs after the assignment, likewise"
+        << " replaces calls\n"
+        << "            to small functions that return a single expression"
+        << " with their\n"
+        << "            bodies, looks up names that are never rebound once"
+        << " ahead of the\n"
+        << "            loops that use them, and removes functions, constant"
+        << " assignments,\n"
+        << "            and modules that are never referenced by name, unless"
+        << " module\n"
+        << "            values are used other than to access their members.\n"
+        << COMMAND_OPTION_PREFIXES[0]
         << "q          Quiet. Don't output usual compiler information.\n"
         << COMMAND_OPTION_PREFIXES[0]
         << "v          Print version information and exit.\n"
@@ -124,7 +177,17 @@ static void Usage()
         << "c option or its default). A warning will be\n"
         << "            issued if the code size exceeds the given amount. The"
         << " default level\n"
-        << "            is " << (DefaultCodeSizeWarningRatio * 100) << "%.\n";
+        << "            is " << (DefaultCodeSizeWarningRatio * 100) << "%.\n"
+        << COMMAND_OPTION_PREFIXES[0]
+        << "z SIZE     Compress the executable in blocks of SIZE bytes, a"
+        << " power of two from\n"
+        << "            " << MinCompressionBlockSize << " to "
+        << MaxCompressionBlockSize << ". Each block is expanded on its"
+        << " own, so when paging\n"
+        << "            the executable, the page size must be a multiple of"
+        << " the block size.\n"
+        << "            Smaller blocks allow smaller pages but compress less."
+        << "\n";
 }
 
 static int main1(int argc, char **argv);
@@ -148,9 +211,12 @@ static int main1(int argc, char **argv)
 {
     // Process command line options.
     bool quiet = false, reportVersion = false;
-    string outputBaseName;
+    string outputBaseName, moduleObjectDirectoryName, profileFileName;
     uint32_t maxCodeSize = Executable::MaxCodeSize;
     double codeSizeWarningRatio = DefaultCodeSizeWarningRatio;
+    unsigned optimizationLevel = 0;
+    unsigned threadCount = 1;
+    uint32_t compressionBlockSize = 0;
     for (; argc >= 2; argc--, argv++)
     {
         string arg1 = argv[1];
@@ -208,6 +274,77 @@ static int main1(int argc, char **argv)
             outputBaseName = (++argv)[1];
             argc--;
         }
+        else if (option == "f")
+        {
+            if (argc <= 2)
+            {
+                Usage();
+                return 1;
+            }
+
+            profileFileName = (++argv)[1];
+            argc--;
+        }
+        else if (option == "j")
+        {
+            if (argc <= 2)
+            {
+                Usage();
+                return 1;
+            }
+
+            string value = (++argv)[1];
+            argc--;
+            char *p;
+            long count = strtol(value.c_str(), &p, 10);
+            if (*p != 0 || count < 1 || count > MaxThreadCount)
+            {
+                cerr
+                    << "Invalid thread count: " << value
+                    << " (must be an integer between 1 and "
+                    << MaxThreadCount << ')' << endl;
+                return 1;
+            }
+            threadCount = static_cast<unsigned>(count);
+        }
+        else if (option == "m")
+        {
+            if (argc <= 2)
+            {
+                Usage();
+                return 1;
+            }
+
+            moduleObjectDirectoryName = (++argv)[1];
+            argc--;
+            if (moduleObjectDirectoryName.empty() ||
+                strchr
+                    (FILE_NAME_SEPARATORS,
+                     moduleObjectDirectoryName.back()) == nullptr)
+                moduleObjectDirectoryName += FILE_NAME_SEPARATORS[0];
+        }
+        else if (option == "O")
+        {
+            if (argc <= 2)
+            {
+                Usage();
+                return 1;
+            }
+
+            string value = (++argv)[1];
+            argc--;
+            char *p;
+            long level = strtol(value.c_str(), &p, 10);
+            if (*p != 0 || level < 0 || level > MaxOptimizationLevel)
+            {
+                cerr
+                    << "Invalid optimization level: " << value
+                    << " (must be an integer between 0 and "
+                    << MaxOptimizationLevel << ')' << endl;
+                return 1;
+            }
+            optimizationLevel = static_cast<unsigned>(level);
+        }
         else if (option == "q" || option == "s")
             quiet = true;
         else if (option == "v")
@@ -233,6 +370,31 @@ static int main1(int argc, char **argv)
             }
             codeSizeWarningRatio = percentage * 0.01;
         }
+        else if (option == "z")
+        {
+            if (argc <= 2)
+            {
+                Usage();
+                return 1;
+            }
+
+            string value = (++argv)[1];
+            argc--;
+            char *p;
+            long size = strtol(value.c_str(), &p, 0);
+            if (*p != 0 ||
+                size < MinCompressionBlockSize ||
+                size > MaxCompressionBlockSize || (size & (size - 1)) != 0)
+            {
+                cerr
+                    << "Invalid compression block size: " << value
+                    << " (must be a power of two from "
+                    << MinCompressionBlockSize << " to "
+                    << MaxCompressionBlockSize << ')' << endl;
+                return 1;
+            }
+            compressionBlockSize = static_cast<uint32_t>(size);
+        }
         else
         {
             cerr << "Invalid option: " << arg1 << endl;
@@ -424,12 +586,42 @@ static int main1(int argc, char **argv)
     // Prepare to process the top-level source file.
     SymbolTable symbolTable;
     Executable executable(symbolTable);
+    executable.SetOptimizationLevel(optimizationLevel);
+    if (!profileFileName.empty())
+    {
+        ifstream profileStream(profileFileName);
+        if (!profileStream)
+        {
+            cerr
+                << "Error opening " << profileFileName
+                << ": " << strerror(errno) << endl;
+            return 2;
+        }
+        if (!executable.ReadProfile(profileStream))
+        {
+            cerr << "Invalid format in profile " << profileFileName << endl;
+            return 2;
+        }
+    }
     Compiler compiler(cerr, symbolTable, executable);
-    compiler.LoadApplicationSpec(specStream);
+    string specData;
+    {
+        ostringstream specDataStream;
+        specDataStream << specStream.rdbuf();
+        specData = specDataStream.str();
+    }
+    {
+        istringstream specDataStream(specData);
+        compiler.LoadApplicationSpec(specDataStream);
+    }
     compiler.AddModuleFileName(mainModuleBaseFileName);
 
     // Prepare to search for imported module files.
-    vector<string> searchPath;
+    ModuleFinder finder;
+    finder.mainModuleFileName = mainModuleFileName;
+    finder.mainModuleBaseFileName = mainModuleBaseFileName;
+    finder.mainModuleDirectoryName = mainModuleDirectoryName;
+    auto &searchPath = finder.searchPath;
     const char *includePathString = getenv("ASP_INCLUDE");
     if (includePathString != nullptr)
     {
@@ -440,7 +632,25 @@ static int main1(int argc, char **argv)
     if (searchPath.empty())
         searchPath.emplace_back();
 
+    // At level 2, a module variable may be treated as constant only if no
+    // module can rebind it by way of a member, so gather the names of all
+    // members bound anywhere in the program ahead of compiling any module.
+    if (optimizationLevel >= 2 && compiler.ErrorCount() == 0)
+        executable.SetBoundMemberNames
+            (ScanBoundMemberNames
+                (threadCount, finder, specData, moduleObjectDirectoryName));
+
+    // When compiling in parallel, modules are compiled into objects ahead of
+    // time by a pool of threads and merged here in the usual order, so that
+    // the outcome is the same as compiling them one after another.
+    unique_ptr<ModulePool> pool;
+    if (threadCount > 1)
+        pool.reset(new ModulePool
+            (threadCount, finder, specData, optimizationLevel,
+             executable.BoundMemberNames(), moduleObjectDirectoryName));
+
     // Compile the main module and any other modules that are imported.
+    unsigned reusedModuleCount = 0, compiledModuleCount = 0;
     bool errorDetected = compiler.ErrorCount() > 0;
     while (!errorDetected)
     {
@@ -453,53 +663,24 @@ static int main1(int argc, char **argv)
         static string sourceSuffix = ".asp";
         string moduleFileName = moduleName + sourceSuffix;
 
-        // Open the module file.
+        // Open the module file, or obtain the outcome of its compilation if
+        // compiling in parallel.
         auto moduleStream = unique_ptr<istream>();
-        if (moduleFileName == mainModuleBaseFileName)
-        {
-            // Open the specified main module file.
-            auto stream = unique_ptr<istream>
-                (new ifstream(mainModuleFileName));
-            if (*stream)
-                moduleStream = move(stream);
-        }
+        string openError;
+        unique_ptr<ModulePool::Result> result;
+        if (pool == nullptr)
+            moduleStream = finder.Open
+                (compiler, moduleName, cerr, openError);
         else
         {
-            // Search for the module file using the search path.
-            for (auto &&directory: searchPath)
-            {
-                // For an empty entry, use the main module's directory (which,
-                // it may be noted, may also be empty).
-                if (directory.empty())
-                    directory = mainModuleDirectoryName;
-
-                // Construct a path name for the module file.
-                if (!directory.empty() &&
-                    strchr(FILE_NAME_SEPARATORS, directory.back()) == nullptr)
-                    directory += FILE_NAME_SEPARATORS[0];
-                auto modulePathName = directory + moduleFileName;
-
-                // Attempt opening the module file.
-                auto stream = unique_ptr<istream>
-                    (new ifstream(modulePathName));
-                if (*stream)
-                {
-                    // Issue a warning if the module's name matches an
-                    // application module.
-                    if (compiler.IsAppModule(moduleName))
-                    {
-                        cerr
-                            << "WARNING: Importing application module "
-                            << moduleName << " instead of "
-                            << modulePathName << " found on path" << endl;
-                        stream.reset();
-                        continue;
-                    }
-
-                    moduleStream = move(stream);
-                    break;
-                }
-            }
+            pool->Submit(moduleName);
+            result = pool->Take(moduleName);
+            cerr << result->messages;
+            if (!result->failure.empty())
+                throw result->failure;
+            if (result->opened)
+                moduleStream.reset(new istringstream(result->source));
+            openError = result->openError;
         }
         if (moduleStream == nullptr)
         {
@@ -518,7 +699,7 @@ static int main1(int argc, char **argv)
                     << sourceLocation.line << ':'
                     << sourceLocation.column
                     << ": Error opening " << moduleFileName
-                    << ": " << strerror(errno) << endl;
+                    << ": " << openError << endl;
             }
 
             // Ensure the error is reported at least once (i.e., for the
@@ -527,73 +708,74 @@ static int main1(int argc, char **argv)
             {
                 cerr
                     << "Error opening " << moduleFileName
-                    << ": " << strerror(errno) << endl;
+                    << ": " << openError << endl;
             }
 
             errorDetected = true;
             break;
         }
-        Lexer lexer(*moduleStream, moduleFileName);
-
-        #ifdef ASP_COMPILER_DEBUG
-        cout << "Parsing module " << moduleFileName << "..." << endl;
-        ParseTrace(stdout, "Trace: ");
-        #endif
 
-        void *parser = ParseAlloc(malloc, &compiler);
-
-        Token *token;
-        do
+        // Merge a module compiled in parallel. Any errors have already been
+        // reported. A module that could not be captured as an object is
+        // compiled here instead.
+        if (result != nullptr)
         {
-            token = lexer.Next();
-            string error;
-            switch (token->type)
-            {
-                default:
-                    break;
-                case -1:
-                    error = "Bad token encountered";
-                    break;
-                case TOKEN_UNEXPECTED_INDENT:
-                    error = "Unexpected indentation";
-                    break;
-                case TOKEN_MISSING_INDENT:
-                    error = "Missing indentation";
-                    break;
-                case TOKEN_MISMATCHED_UNINDENT:
-                    error = "Mismatched indentation";
-                    break;
-                case TOKEN_INCONSISTENT_WS:
-                    error = "Inconsistent whitespace in indentation";
-                    break;
-            }
-            if (!error.empty())
+            if (result->errorDetected)
             {
-                cerr
-                    << token->sourceLocation.fileName << ':'
-                    << token->sourceLocation.line << ':'
-                    << token->sourceLocation.column
-                    << ": " << error;
-                if (!token->s.empty())
-                    cerr << ": '" << token->s << '\'';
-                if (!token->error.empty())
-                    cerr << ": " << token->error;
-                cerr << endl;
-
-                delete token;
                 errorDetected = true;
                 break;
             }
+            if (result->saved &&
+                compiler.LoadModuleObject(result->moduleObject))
+            {
+                if (result->reused)
+                    reusedModuleCount++;
+                else if (!moduleObjectDirectoryName.empty())
+                    compiledModuleCount++;
+                continue;
+            }
+        }
 
-            compiler.SetSourceLocation(token->sourceLocation);
+        // When caching module objects, reuse the module's object if it was
+        // compiled from the same source under the same conditions.
+        // Otherwise, compile the module from the source already read.
+        string moduleObjectFileName;
+        uint64_t sourceHash = 0;
+        if (!moduleObjectDirectoryName.empty() && result == nullptr)
+        {
+            ostringstream sourceStream;
+            sourceStream << moduleStream->rdbuf();
+            string source = sourceStream.str();
+            sourceHash = ModuleObject::Hash(source);
+            static string moduleObjectSuffix = ".aspo";
+            moduleObjectFileName =
+                moduleObjectDirectoryName + moduleName + moduleObjectSuffix;
+
+            ModuleObject moduleObject;
+            if (ReadModuleObject
+                    (moduleObject, moduleObjectFileName, sourceHash) &&
+                compiler.LoadModuleObject(moduleObject))
+            {
+                reusedModuleCount++;
+                continue;
+            }
 
-            Parse(parser, token->type, token);
-            if (compiler.ErrorCount() > 0)
-                errorDetected = true;
+            moduleStream.reset(new istringstream(source));
+            compiler.BeginModuleObject();
+        }
 
-        } while (!errorDetected && token->type != 0);
+        errorDetected = ParseModule
+            (compiler, *moduleStream, moduleFileName, cerr);
 
-        ParseFree(parser, free);
+        // Save the module's object for reuse by later compilations.
+        if (!moduleObjectFileName.empty() && !errorDetected)
+        {
+            compiledModuleCount++;
+            ModuleObject moduleObject;
+            moduleObject.sourceHash = sourceHash;
+            if (compiler.SaveModuleObject(moduleObject))
+                WriteModuleObject(moduleObject, moduleObjectFileName, cerr);
+        }
     }
 
     compiler.Finalize();
@@ -621,7 +803,12 @@ static int main1(int argc, char **argv)
     }
 
     // Write the code.
-    executable.Write(executableStream);
+    uint32_t expandedByteCount = 0;
+    if (compressionBlockSize != 0)
+        expandedByteCount = executable.WriteCompressed
+            (executableStream, compressionBlockSize);
+    else
+        executable.Write(executableStream);
     auto executableByteCount = executableStream.tellp();
     executableStream.close();
     if (!executableStream)
@@ -665,6 +852,36 @@ static int main1(int argc, char **argv)
             << executableFileName << ": "
             << executableByteCount << " bytes" << endl;
 
+        // Report the effect of compression.
+        if (compressionBlockSize != 0)
+        {
+            cout
+                << "Compressed executable: "
+                << expandedByteCount << " -> " << executableByteCount
+                << " bytes, in blocks of " << compressionBlockSize << endl;
+        }
+
+        // Report the effect of optimization.
+        if (optimizationLevel > 0)
+        {
+            cout
+                << "Optimized code: "
+                << executable.InitialCodeSize() << " -> "
+                << finalCodeSize << " bytes, "
+                << executable.InitialInstructionCount() << " -> "
+                << executable.FinalInstructionCount() << " instructions"
+                << endl;
+        }
+
+        // Report the use of cached module objects.
+        if (!moduleObjectDirectoryName.empty())
+        {
+            cout
+                << "Module objects: "
+                << reusedModuleCount << " reused, "
+                << compiledModuleCount << " compiled" << endl;
+        }
+
         // Warn for executables nearing maximum size.
         double codeSizeRatio = (double)finalCodeSize / maxCodeSize;
         if (codeSizeRatio >= codeSizeWarningRatio)
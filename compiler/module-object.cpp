@@ -0,0 +1,420 @@
+//
+// Asp compiled module object implementation.
+//
+
+#include "module-object.hpp"
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <unordered_set>
+
+using namespace std;
+
+static const string ObjectVersion = "\x04";
+
+enum InstructionFlag : uint8_t
+{
+    InstructionFlag_Null = 0x01,
+    InstructionFlag_Target = 0x02,
+    InstructionFlag_Symbol = 0x04,
+    InstructionFlag_FileChanged = 0x80,
+};
+
+// Objects are encoded into and decoded from memory. Numbers are written
+// seven bits at a time, least significant first, with the high bit of each
+// byte indicating that more follow. Signed numbers are first mapped onto
+// unsigned ones so that small magnitudes remain short.
+struct Input
+{
+    const char *next, *end;
+};
+static void WriteItem(string &, uint64_t);
+static void WriteItem(string &, int32_t);
+static void WriteItem(string &, const string &);
+static void WriteItem(string &, const vector<string> &);
+static bool ReadItem(Input &, uint64_t &);
+static bool ReadItem(Input &, int32_t &);
+static bool ReadItem(Input &, string &);
+static bool ReadItem(Input &, vector<string> &);
+template <class T>
+static bool ReadItem(Input &, T &);
+
+uint64_t ModuleObject::Hash(const string &source)
+{
+    // 64-bit FNV-1a.
+    uint64_t hash = UINT64_C(0xCBF29CE484222325);
+    for (auto c: source)
+    {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= UINT64_C(0x100000001B3);
+    }
+    return hash;
+}
+
+void ModuleObject::Write(ostream &os) const
+{
+    // Write header signature and version information.
+    string data = "AspO";
+    data += static_cast<char>(ASP_COMPILER_VERSION_MAJOR);
+    data += static_cast<char>(ASP_COMPILER_VERSION_MINOR);
+    data += static_cast<char>(ASP_COMPILER_VERSION_PATCH);
+    data += static_cast<char>(ASP_COMPILER_VERSION_TWEAK);
+    data += ObjectVersion;
+
+    // Write the key.
+    WriteItem(data, static_cast<uint64_t>(checkValue));
+    WriteItem(data, static_cast<uint64_t>(optimizationLevel));
+    WriteItem(data, sourceHash);
+    WriteItem(data, readNames);
+    WriteItem(data, boundReadNames);
+
+    // Write symbols.
+    WriteItem(data, static_cast<uint64_t>(symbols.size()));
+    for (const auto &symbol: symbols)
+    {
+        WriteItem(data, symbol.first);
+        WriteItem(data, symbol.second);
+    }
+    WriteItem(data, firstTemporarySymbol);
+    WriteItem(data, static_cast<uint64_t>(temporarySymbolCount));
+
+    // Write the source file names referenced by source locations.
+    map<string, uint64_t> fileNameIndices;
+    auto addFileName = [&](const SourceLocation &sourceLocation)
+    {
+        fileNameIndices.emplace
+            (sourceLocation.fileName,
+             static_cast<uint64_t>(fileNameIndices.size()));
+    };
+    for (const auto &import: imports)
+        addFileName(import.sourceLocation);
+    for (const auto &instruction: instructions)
+        addFileName(instruction.sourceLocation);
+    vector<const string *> fileNames(fileNameIndices.size());
+    for (const auto &entry: fileNameIndices)
+        fileNames[entry.second] = &entry.first;
+    WriteItem(data, static_cast<uint64_t>(fileNames.size()));
+    for (const auto &fileName: fileNames)
+        WriteItem(data, *fileName);
+
+    // Source locations of successive instructions are mostly in the same
+    // file, so the file is given only when it changes.
+    const string *previousFileName = nullptr;
+    auto writeSourceLocation = [&]
+        (const SourceLocation &sourceLocation, bool fileChanged)
+    {
+        if (fileChanged)
+            WriteItem(data, fileNameIndices[sourceLocation.fileName]);
+        WriteItem(data, static_cast<uint64_t>(sourceLocation.line));
+        WriteItem(data, static_cast<uint64_t>(sourceLocation.column));
+    };
+
+    // Write imports.
+    WriteItem(data, static_cast<uint64_t>(imports.size()));
+    for (const auto &import: imports)
+    {
+        WriteItem(data, import.moduleName);
+        writeSourceLocation(import.sourceLocation, true);
+    }
+
+    // Write bound member names.
+    WriteItem(data, boundMemberNames);
+
+    // Write strings.
+    WriteItem(data, static_cast<uint64_t>(strings.size()));
+    for (const auto &s: strings)
+        WriteItem(data, s);
+
+    // Write instructions.
+    WriteItem(data, static_cast<uint64_t>(instructions.size()));
+    for (const auto &instruction: instructions)
+    {
+        const auto &fileName = instruction.sourceLocation.fileName;
+        bool fileChanged =
+            previousFileName == nullptr || fileName != *previousFileName;
+        previousFileName = &fileName;
+
+        data += static_cast<char>
+            ((instruction.isNull ? InstructionFlag_Null : 0) |
+             (instruction.hasTarget ? InstructionFlag_Target : 0) |
+             (instruction.hasSymbol ? InstructionFlag_Symbol : 0) |
+             (fileChanged ? InstructionFlag_FileChanged : 0));
+        data += static_cast<char>(instruction.opCode);
+        if (instruction.hasTarget)
+            WriteItem(data, static_cast<uint64_t>(instruction.targetIndex));
+        if (instruction.hasSymbol)
+            WriteItem(data, instruction.symbol);
+        WriteItem(data, static_cast<uint64_t>(instruction.operands));
+        WriteItem(data, static_cast<uint64_t>(instruction.code));
+        WriteItem(data, static_cast<uint64_t>(instruction.comment));
+        writeSourceLocation(instruction.sourceLocation, fileChanged);
+    }
+
+    // Write a check of everything above so that damaged objects are never
+    // reused.
+    auto check = Hash(data);
+    for (unsigned i = 0; i < sizeof check; i++)
+        data += static_cast<char>((check >> ((7 - i) << 3)) & 0xFF);
+
+    os.write(data.data(), static_cast<streamsize>(data.size()));
+}
+
+bool ModuleObject::Read(istream &is)
+{
+    ostringstream dataStream;
+    dataStream << is.rdbuf();
+    string data = dataStream.str();
+
+    // Verify the check that ends the object.
+    uint64_t check = 0;
+    if (data.size() < sizeof check)
+        return false;
+    for (unsigned i = 0; i < sizeof check; i++)
+        check = (check << 8) | static_cast<uint8_t>
+            (data[data.size() - sizeof check + i]);
+    data.resize(data.size() - sizeof check);
+    if (Hash(data) != check)
+        return false;
+    Input input = {data.data(), data.data() + data.size()};
+
+    // Check header signature and version information.
+    static const char expectedHeader[9] =
+    {
+        'A', 's', 'p', 'O',
+        ASP_COMPILER_VERSION_MAJOR,
+        ASP_COMPILER_VERSION_MINOR,
+        ASP_COMPILER_VERSION_PATCH,
+        ASP_COMPILER_VERSION_TWEAK,
+        ObjectVersion[0],
+    };
+    if (data.size() < sizeof expectedHeader ||
+        !equal(expectedHeader, expectedHeader + sizeof expectedHeader,
+               input.next))
+        return false;
+    input.next += sizeof expectedHeader;
+
+    // Read the key.
+    if (!ReadItem(input, checkValue) ||
+        !ReadItem(input, optimizationLevel) ||
+        !ReadItem(input, sourceHash) ||
+        !ReadItem(input, readNames) ||
+        !ReadItem(input, boundReadNames))
+        return false;
+
+    // Read symbols.
+    uint32_t count;
+    if (!ReadItem(input, count))
+        return false;
+    symbols.resize(count);
+    for (auto &symbol: symbols)
+    {
+        if (!ReadItem(input, symbol.first) || !ReadItem(input, symbol.second))
+            return false;
+    }
+    if (!ReadItem(input, firstTemporarySymbol) ||
+        !ReadItem(input, temporarySymbolCount))
+        return false;
+
+    // Read source file names.
+    if (!ReadItem(input, count))
+        return false;
+    vector<string> fileNames(count);
+    for (auto &fileName: fileNames)
+    {
+        if (!ReadItem(input, fileName))
+            return false;
+    }
+    auto readSourceLocation = [&]
+        (SourceLocation &sourceLocation, const SourceLocation *previous)
+    {
+        if (previous == nullptr)
+        {
+            uint32_t fileNameIndex;
+            if (!ReadItem(input, fileNameIndex) ||
+                fileNameIndex >= fileNames.size())
+                return false;
+            sourceLocation.fileName = fileNames[fileNameIndex];
+        }
+        else
+            sourceLocation.fileName = previous->fileName;
+        return
+            ReadItem(input, sourceLocation.line) &&
+            ReadItem(input, sourceLocation.column);
+    };
+
+    // Read imports.
+    if (!ReadItem(input, count))
+        return false;
+    imports.resize(count);
+    for (auto &import: imports)
+    {
+        if (!ReadItem(input, import.moduleName) ||
+            !readSourceLocation(import.sourceLocation, nullptr))
+            return false;
+    }
+
+    // Read bound member names.
+    if (!ReadItem(input, boundMemberNames))
+        return false;
+
+    // Read strings.
+    if (!ReadItem(input, count))
+        return false;
+    strings.resize(count);
+    for (auto &s: strings)
+    {
+        if (!ReadItem(input, s))
+            return false;
+    }
+
+    // Read instructions.
+    if (!ReadItem(input, count))
+        return false;
+    instructions.resize(count);
+    const SourceLocation *previousSourceLocation = nullptr;
+    for (auto &instruction: instructions)
+    {
+        if (input.end - input.next < 2)
+            return false;
+        auto flags = static_cast<uint8_t>(*input.next++);
+        instruction.opCode = static_cast<uint8_t>(*input.next++);
+        instruction.isNull = (flags & InstructionFlag_Null) != 0;
+        instruction.hasTarget = (flags & InstructionFlag_Target) != 0;
+        instruction.hasSymbol = (flags & InstructionFlag_Symbol) != 0;
+        bool fileChanged = (flags & InstructionFlag_FileChanged) != 0;
+        if (!fileChanged && previousSourceLocation == nullptr)
+            return false;
+        if (instruction.hasTarget &&
+            (!ReadItem(input, instruction.targetIndex) ||
+             instruction.targetIndex >= count))
+            return false;
+        if (instruction.hasSymbol && !ReadItem(input, instruction.symbol))
+            return false;
+        if (!ReadItem(input, instruction.operands) ||
+            instruction.operands >= strings.size() ||
+            !ReadItem(input, instruction.code) ||
+            instruction.code >= strings.size() ||
+            !ReadItem(input, instruction.comment) ||
+            instruction.comment >= strings.size() ||
+            !readSourceLocation
+                (instruction.sourceLocation,
+                 fileChanged ? nullptr : previousSourceLocation))
+            return false;
+        previousSourceLocation = &instruction.sourceLocation;
+    }
+
+    // Ensure nothing follows.
+    return input.next == input.end;
+}
+
+bool ModuleObject::Complete() const
+{
+    unordered_set<int32_t> symbolValues;
+    for (const auto &symbol: symbols)
+        symbolValues.insert(symbol.second);
+    auto lastTemporarySymbol =
+        static_cast<int64_t>(firstTemporarySymbol) - temporarySymbolCount;
+    for (const auto &instruction: instructions)
+    {
+        if (instruction.hasSymbol &&
+            symbolValues.count(instruction.symbol) == 0 &&
+            (instruction.symbol > firstTemporarySymbol ||
+             instruction.symbol <= lastTemporarySymbol))
+            return false;
+    }
+    return true;
+}
+
+static void WriteItem(string &data, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        data += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    data += static_cast<char>(value);
+}
+
+static void WriteItem(string &data, int32_t value)
+{
+    auto uValue = static_cast<uint32_t>(value);
+    WriteItem
+        (data,
+         static_cast<uint64_t>
+            (value < 0 ? ((~uValue) << 1) | 1 : uValue << 1));
+}
+
+static void WriteItem(string &data, const string &s)
+{
+    WriteItem(data, static_cast<uint64_t>(s.size()));
+    data += s;
+}
+
+static void WriteItem(string &data, const vector<string> &v)
+{
+    WriteItem(data, static_cast<uint64_t>(v.size()));
+    for (const auto &s: v)
+        WriteItem(data, s);
+}
+
+static bool ReadItem(Input &input, uint64_t &value)
+{
+    value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7)
+    {
+        if (input.next == input.end)
+            return false;
+        auto c = static_cast<uint8_t>(*input.next++);
+        value |= static_cast<uint64_t>(c & 0x7F) << shift;
+        if ((c & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+static bool ReadItem(Input &input, int32_t &value)
+{
+    uint32_t uValue;
+    if (!ReadItem(input, uValue))
+        return false;
+    value = static_cast<int32_t>
+        ((uValue & 1) != 0 ? ~(uValue >> 1) : uValue >> 1);
+    return true;
+}
+
+static bool ReadItem(Input &input, string &s)
+{
+    uint32_t size;
+    if (!ReadItem(input, size) ||
+        size > static_cast<size_t>(input.end - input.next))
+        return false;
+    s.assign(input.next, size);
+    input.next += size;
+    return true;
+}
+
+static bool ReadItem(Input &input, vector<string> &v)
+{
+    uint32_t count;
+    if (!ReadItem(input, count) ||
+        count > static_cast<size_t>(input.end - input.next))
+        return false;
+    v.resize(count);
+    for (auto &s: v)
+    {
+        if (!ReadItem(input, s))
+            return false;
+    }
+    return true;
+}
+
+template <class T>
+static bool ReadItem(Input &input, T &value)
+{
+    uint64_t item;
+    if (!ReadItem(input, item) ||
+        item > static_cast<uint64_t>(static_cast<T>(~T(0))))
+        return false;
+    value = static_cast<T>(item);
+    return true;
+}
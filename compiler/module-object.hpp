@@ -0,0 +1,80 @@
+//
+// Asp compiled module object definitions.
+//
+
+#ifndef MODULE_OBJECT_HPP
+#define MODULE_OBJECT_HPP
+
+#include "grammar.hpp"
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+struct ModuleObject
+{
+    // Source hash method.
+    static std::uint64_t Hash(const std::string &source);
+
+    // Input/output methods. Reading fails if the object is malformed or was
+    // written by a different version of the compiler.
+    void Write(std::ostream &) const;
+    bool Read(std::istream &);
+
+    // Consistency check. An object is complete if the symbol operand of each
+    // of its instructions is either one of its symbols or one of its
+    // temporary symbols.
+    bool Complete() const;
+
+    // Key. An object may be reused only if all of these match. Of the
+    // members that modules of the program bind, only those named by the
+    // read names affected the module's code: the names it reads that were
+    // treated according to whether they may be rebound. Of these, the bound
+    // read names were bound as members when the module was compiled.
+    std::uint32_t checkValue = 0;
+    std::uint8_t optimizationLevel = 0;
+    std::uint64_t sourceHash = 0;
+    std::vector<std::string> readNames, boundReadNames;
+
+    // Symbols fetched while compiling the module, in order of first use,
+    // along with the values they had at the time, and the range of
+    // temporary symbols issued.
+    std::vector<std::pair<std::string, std::int32_t> > symbols;
+    std::int32_t firstTemporarySymbol = -1;
+    std::uint32_t temporarySymbolCount = 0;
+
+    // Modules imported by the module, in order.
+    struct Import
+    {
+        std::string moduleName;
+        SourceLocation sourceLocation;
+    };
+    std::vector<Import> imports;
+
+    // Names of the members the module binds. Like its imports, these depend
+    // on the module's source alone.
+    std::vector<std::string> boundMemberNames;
+
+    // Strings referenced by instructions. Code listings, comments, and
+    // encoded operands repeat heavily, so each is stored once.
+    std::vector<std::string> strings;
+
+    // Instructions making up the module's code. Targets are given as indices
+    // of other instructions in the module. An instruction either has a
+    // symbol operand or has its operands encoded as is. The code listing
+    // omits any symbol operand, which is appended when the listing is
+    // printed. Operands, code, and comment are indices into the strings.
+    struct InstructionRecord
+    {
+        bool isNull = false, hasTarget = false, hasSymbol = false;
+        std::uint8_t opCode = 0;
+        std::uint32_t targetIndex = 0;
+        std::int32_t symbol = 0;
+        std::uint32_t operands = 0, code = 0, comment = 0;
+        SourceLocation sourceLocation;
+    };
+    std::vector<InstructionRecord> instructions;
+};
+
+#endif
@@ -0,0 +1,485 @@
+//
+// Asp module compilation implementation.
+//
+
+#include "module-pool.hpp"
+#include "lexer.h"
+#include "executable.hpp"
+#include "symbol.hpp"
+#include "asp.h"
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+
+#ifndef FILE_NAME_SEPARATORS
+#error FILE_NAME_SEPARATORS macro undefined
+#endif
+
+// Lemon parser.
+extern "C" {
+void *ParseAlloc(void *(*malloc)(size_t), Compiler *);
+void Parse(void *parser, int yymajor, Token *yyminor);
+void ParseFree(void *parser, void (*free)(void *));
+void ParseTrace(FILE *, const char *prefix);
+}
+
+using namespace std;
+
+static const string SourceSuffix = ".asp";
+static const string ModuleObjectSuffix = ".aspo";
+
+unique_ptr<istream> ModuleFinder::Open
+    (const Compiler &compiler, const string &moduleName,
+     ostream &warningStream, string &error) const
+{
+    string moduleFileName = moduleName + SourceSuffix;
+
+    auto moduleStream = unique_ptr<istream>();
+    if (moduleFileName == mainModuleBaseFileName)
+    {
+        // Open the specified main module file.
+        auto stream = unique_ptr<istream>
+            (new ifstream(mainModuleFileName));
+        if (*stream)
+            moduleStream = move(stream);
+    }
+    else
+    {
+        // Search for the module file using the search path.
+        for (auto directory: searchPath)
+        {
+            // For an empty entry, use the main module's directory (which, it
+            // may be noted, may also be empty).
+            if (directory.empty())
+                directory = mainModuleDirectoryName;
+
+            // Construct a path name for the module file.
+            if (!directory.empty() &&
+                strchr(FILE_NAME_SEPARATORS, directory.back()) == nullptr)
+                directory += FILE_NAME_SEPARATORS[0];
+            auto modulePathName = directory + moduleFileName;
+
+            // Attempt opening the module file.
+            auto stream = unique_ptr<istream>
+                (new ifstream(modulePathName));
+            if (*stream)
+            {
+                // Issue a warning if the module's name matches an
+                // application module.
+                if (compiler.IsAppModule(moduleName))
+                {
+                    warningStream
+                        << "WARNING: Importing application module "
+                        << moduleName << " instead of "
+                        << modulePathName << " found on path" << endl;
+                    stream.reset();
+                    continue;
+                }
+
+                moduleStream = move(stream);
+                break;
+            }
+        }
+    }
+
+    if (moduleStream == nullptr)
+        error = strerror(errno);
+    return moduleStream;
+}
+
+bool ParseModule
+    (Compiler &compiler, istream &moduleStream,
+     const string &moduleFileName, ostream &errorStream)
+{
+    Lexer lexer(moduleStream, moduleFileName);
+
+    #ifdef ASP_COMPILER_DEBUG
+    cout << "Parsing module " << moduleFileName << "..." << endl;
+    ParseTrace(stdout, "Trace: ");
+    #endif
+
+    void *parser = ParseAlloc(malloc, &compiler);
+
+    bool errorDetected = false;
+    Token *token;
+    do
+    {
+        token = lexer.Next();
+        string error;
+        switch (token->type)
+        {
+            default:
+                break;
+            case -1:
+                error = "Bad token encountered";
+                break;
+            case TOKEN_UNEXPECTED_INDENT:
+                error = "Unexpected indentation";
+                break;
+            case TOKEN_MISSING_INDENT:
+                error = "Missing indentation";
+                break;
+            case TOKEN_MISMATCHED_UNINDENT:
+                error = "Mismatched indentation";
+                break;
+            case TOKEN_INCONSISTENT_WS:
+                error = "Inconsistent whitespace in indentation";
+                break;
+        }
+        if (!error.empty())
+        {
+            errorStream
+                << token->sourceLocation.fileName << ':'
+                << token->sourceLocation.line << ':'
+                << token->sourceLocation.column
+                << ": " << error;
+            if (!token->s.empty())
+                errorStream << ": '" << token->s << '\'';
+            if (!token->error.empty())
+                errorStream << ": " << token->error;
+            errorStream << endl;
+
+            delete token;
+            errorDetected = true;
+            break;
+        }
+
+        compiler.SetSourceLocation(token->sourceLocation);
+
+        Parse(parser, token->type, token);
+        if (compiler.ErrorCount() > 0)
+            errorDetected = true;
+
+    } while (!errorDetected && token->type != 0);
+
+    ParseFree(parser, free);
+
+    return errorDetected;
+}
+
+bool ReadModuleObject
+    (ModuleObject &moduleObject, const string &moduleObjectFileName,
+     uint64_t sourceHash)
+{
+    ifstream moduleObjectStream(moduleObjectFileName, ios::binary);
+    return
+        moduleObjectStream &&
+        moduleObject.Read(moduleObjectStream) &&
+        moduleObject.sourceHash == sourceHash;
+}
+
+void WriteModuleObject
+    (const ModuleObject &moduleObject, const string &moduleObjectFileName,
+     ostream &warningStream)
+{
+    ofstream moduleObjectStream(moduleObjectFileName, ios::binary);
+    if (moduleObjectStream)
+        moduleObject.Write(moduleObjectStream);
+    moduleObjectStream.close();
+    if (!moduleObjectStream)
+    {
+        warningStream
+            << "WARNING: Error writing " << moduleObjectFileName
+            << ": " << strerror(errno) << endl;
+        remove(moduleObjectFileName.c_str());
+    }
+}
+
+set<string> ScanBoundMemberNames
+    (unsigned threadCount, const ModuleFinder &finder,
+     const string &specData, const string &moduleObjectDirectoryName)
+{
+    ModulePool pool
+        (threadCount, finder, specData, 0, set<string>(),
+         moduleObjectDirectoryName, true);
+
+    // Visit the main module and every module imported from there on,
+    // skipping those that cannot be opened.
+    const auto &mainModuleBaseFileName = finder.mainModuleBaseFileName;
+    auto mainModuleName = mainModuleBaseFileName.substr
+        (0, mainModuleBaseFileName.size() - SourceSuffix.size());
+    set<string> boundMemberNames, visitedModuleNames = {mainModuleName};
+    deque<string> moduleNames = {mainModuleName};
+    pool.Submit(mainModuleName);
+    while (!moduleNames.empty())
+    {
+        auto result = pool.Take(moduleNames.front());
+        moduleNames.pop_front();
+
+        const auto &moduleObject = result->moduleObject;
+        boundMemberNames.insert
+            (moduleObject.boundMemberNames.begin(),
+             moduleObject.boundMemberNames.end());
+        for (const auto &import: moduleObject.imports)
+        {
+            if (!visitedModuleNames.insert(import.moduleName).second)
+                continue;
+            pool.Submit(import.moduleName);
+            moduleNames.push_back(import.moduleName);
+        }
+    }
+
+    return boundMemberNames;
+}
+
+ModulePool::ModulePool
+    (unsigned threadCount, const ModuleFinder &finder,
+     const string &specData, unsigned optimizationLevel,
+     const set<string> &boundMemberNames,
+     const string &moduleObjectDirectoryName, bool scanning) :
+    finder(finder),
+    specData(specData),
+    optimizationLevel(optimizationLevel),
+    boundMemberNames(boundMemberNames),
+    moduleObjectDirectoryName(moduleObjectDirectoryName),
+    scanning(scanning)
+{
+    for (unsigned i = 0; i < threadCount; i++)
+        threads.emplace_back(&ModulePool::Work, this);
+}
+
+ModulePool::~ModulePool()
+{
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        pendingModuleNames.clear();
+    }
+    workAvailable.notify_all();
+    for (auto &thread: threads)
+        thread.join();
+}
+
+void ModulePool::Submit(const string &moduleName)
+{
+    {
+        lock_guard<std::mutex> lock(mutex);
+        if (!submittedModuleNames.insert(moduleName).second)
+            return;
+        pendingModuleNames.push_back(moduleName);
+    }
+    workAvailable.notify_one();
+}
+
+unique_ptr<ModulePool::Result> ModulePool::Take(const string &moduleName)
+{
+    unique_lock<std::mutex> lock(mutex);
+    decltype(results)::iterator iter;
+    resultAvailable.wait(lock, [&]
+    {
+        iter = results.find(moduleName);
+        return iter != results.end();
+    });
+    auto result = move(iter->second);
+    results.erase(iter);
+    return result;
+}
+
+void ModulePool::Work()
+{
+    while (true)
+    {
+        string moduleName;
+        {
+            unique_lock<std::mutex> lock(mutex);
+            workAvailable.wait(lock, [this]
+            {
+                return stopping || !pendingModuleNames.empty();
+            });
+            if (stopping)
+                return;
+            moduleName = pendingModuleNames.front();
+            pendingModuleNames.pop_front();
+        }
+
+        unique_ptr<Result> result;
+        try
+        {
+            result = scanning ? Scan(moduleName) : Compile(moduleName);
+        }
+        catch (const string &e)
+        {
+            result.reset(new Result);
+            result->opened = result->errorDetected = true;
+            result->failure = e;
+        }
+        catch (const exception &e)
+        {
+            result.reset(new Result);
+            result->opened = result->errorDetected = true;
+            result->failure = e.what();
+        }
+        catch (...)
+        {
+            result.reset(new Result);
+            result->opened = result->errorDetected = true;
+            result->failure = "Unknown error compiling module " + moduleName;
+        }
+
+        // Look ahead to the modules this one imports.
+        if (result->saved || scanning)
+        {
+            for (const auto &import: result->moduleObject.imports)
+                Submit(import.moduleName);
+        }
+
+        {
+            lock_guard<std::mutex> lock(mutex);
+            results.emplace(moduleName, move(result));
+        }
+        resultAvailable.notify_all();
+    }
+}
+
+unique_ptr<ModulePool::Result> ModulePool::Compile(const string &moduleName)
+{
+    unique_ptr<Result> result(new Result);
+    ostringstream messageStream;
+
+    // Prepare a compiler of our own, sharing nothing with the others.
+    SymbolTable symbolTable;
+    Executable executable(symbolTable);
+    executable.SetOptimizationLevel(optimizationLevel);
+    executable.SetBoundMemberNames(boundMemberNames);
+    Compiler compiler(messageStream, symbolTable, executable);
+    {
+        istringstream specStream(specData);
+        compiler.LoadApplicationSpec(specStream);
+    }
+
+    // Open the module file and read its source.
+    auto moduleStream = finder.Open
+        (compiler, moduleName, messageStream, result->openError);
+    result->opened = moduleStream != nullptr;
+    if (!result->opened)
+    {
+        result->messages = messageStream.str();
+        return result;
+    }
+    {
+        ostringstream sourceStream;
+        sourceStream << moduleStream->rdbuf();
+        result->source = sourceStream.str();
+    }
+    auto sourceHash = ModuleObject::Hash(result->source);
+
+    // Reuse a cached object if there is a suitable one.
+    string moduleObjectFileName;
+    if (!moduleObjectDirectoryName.empty())
+    {
+        moduleObjectFileName =
+            moduleObjectDirectoryName + moduleName + ModuleObjectSuffix;
+        auto &moduleObject = result->moduleObject;
+        if (ReadModuleObject(moduleObject, moduleObjectFileName, sourceHash) &&
+            compiler.ModuleObjectFits(moduleObject))
+        {
+            result->saved = result->reused = true;
+            result->messages = messageStream.str();
+            return result;
+        }
+        moduleObject = ModuleObject();
+    }
+
+    // Compile the module.
+    compiler.AddModule(moduleName);
+    compiler.NextModule();
+    compiler.BeginModuleObject();
+    {
+        istringstream sourceStream(result->source);
+        result->errorDetected = ParseModule
+            (compiler, sourceStream, moduleName + SourceSuffix,
+             messageStream);
+    }
+    result->messages = messageStream.str();
+    if (result->errorDetected)
+        return result;
+    result->moduleObject.sourceHash = sourceHash;
+    result->saved = compiler.SaveModuleObject(result->moduleObject);
+    if (!result->saved)
+        return result;
+
+    // Cache the object for later compilations.
+    if (!moduleObjectFileName.empty())
+    {
+        ostringstream warningStream;
+        WriteModuleObject
+            (result->moduleObject, moduleObjectFileName, warningStream);
+        result->messages += warningStream.str();
+    }
+
+    return result;
+}
+
+unique_ptr<ModulePool::Result> ModulePool::Scan(const string &moduleName)
+{
+    unique_ptr<Result> result(new Result);
+
+    // Prepare a compiler of our own, discarding its output, which compiling
+    // the module will reproduce.
+    ostringstream messageStream;
+    SymbolTable symbolTable;
+    Executable executable(symbolTable);
+    Compiler compiler(messageStream, symbolTable, executable);
+    {
+        istringstream specStream(specData);
+        compiler.LoadApplicationSpec(specStream);
+    }
+
+    // Open the module file and read its source.
+    auto moduleStream = finder.Open
+        (compiler, moduleName, messageStream, result->openError);
+    result->opened = moduleStream != nullptr;
+    if (!result->opened)
+        return result;
+    string source;
+    {
+        ostringstream sourceStream;
+        sourceStream << moduleStream->rdbuf();
+        source = sourceStream.str();
+    }
+
+    // Take the module's imports and bound member names from its object if
+    // it was compiled from the same source.
+    auto &moduleObject = result->moduleObject;
+    if (!moduleObjectDirectoryName.empty())
+    {
+        auto moduleObjectFileName =
+            moduleObjectDirectoryName + moduleName + ModuleObjectSuffix;
+        if (ReadModuleObject
+                (moduleObject, moduleObjectFileName,
+                 ModuleObject::Hash(source)))
+        {
+            result->reused = true;
+            return result;
+        }
+        moduleObject = ModuleObject();
+    }
+
+    // Otherwise, parse the module to gather them.
+    set<string> boundMemberNames;
+    compiler.ScanBoundMemberNames(boundMemberNames);
+    compiler.AddModule(moduleName);
+    compiler.NextModule();
+    {
+        istringstream sourceStream(source);
+        result->errorDetected = ParseModule
+            (compiler, sourceStream, moduleName + SourceSuffix,
+             messageStream);
+    }
+    moduleObject.boundMemberNames.assign
+        (boundMemberNames.begin(), boundMemberNames.end());
+    while (true)
+    {
+        auto importedModuleName = compiler.NextModule().first;
+        if (importedModuleName.empty())
+            break;
+        moduleObject.imports.push_back
+            (ModuleObject::Import{importedModuleName, SourceLocation()});
+    }
+
+    return result;
+}
@@ -0,0 +1,150 @@
+//
+// Asp module compilation definitions.
+//
+
+#ifndef MODULE_POOL_HPP
+#define MODULE_POOL_HPP
+
+#include "compiler.h"
+#include "module-object.hpp"
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+// Module file lookup.
+struct ModuleFinder
+{
+    // Opens the source file of the named module, searching the path for all
+    // but the main module. Warnings are written to the given stream. On
+    // failure, the result is null and the error describes the cause.
+    std::unique_ptr<std::istream> Open
+        (const Compiler &, const std::string &moduleName,
+         std::ostream &warningStream, std::string &error) const;
+
+    std::string mainModuleFileName;
+    std::string mainModuleBaseFileName;
+    std::string mainModuleDirectoryName;
+    std::vector<std::string> searchPath;
+};
+
+// Lexes and parses a module's source into the compiler, writing any errors
+// to the given stream. Returns whether an error was detected.
+bool ParseModule
+    (Compiler &, std::istream &, const std::string &moduleFileName,
+     std::ostream &errorStream);
+
+// Reads a module object from the given file. Fails if the object is
+// missing or malformed, or if it was compiled from source other than that
+// with the given hash.
+bool ReadModuleObject
+    (ModuleObject &, const std::string &moduleObjectFileName,
+     std::uint64_t sourceHash);
+
+// Writes a module object to the given file for reuse by later
+// compilations. On failure, a warning is written to the given stream and the
+// file is removed.
+void WriteModuleObject
+    (const ModuleObject &, const std::string &moduleObjectFileName,
+     std::ostream &warningStream);
+
+// Returns the names of the members that the main module and all the modules
+// it imports, directly or not, bind. These are taken from each module's
+// object, if it was compiled from the module's current source, and
+// otherwise gathered by parsing the module, without generating code, using
+// a pool of threads. Errors are left for compilation proper to report.
+std::set<std::string> ScanBoundMemberNames
+    (unsigned threadCount, const ModuleFinder &,
+     const std::string &specData,
+     const std::string &moduleObjectDirectoryName);
+
+// Pool of threads that compile modules into module objects independently of
+// one another. Each module is compiled by its own compiler instance with its
+// own symbol table, so the resulting objects must be merged into the main
+// compiler in the order a serial compilation would visit the modules.
+// Modules imported by each compiled module are submitted automatically.
+//
+// A pool may instead scan modules, in which case only the imports and bound
+// member names of each result's object are given.
+class ModulePool
+{
+    public:
+
+        struct Result
+        {
+            // Output to be reported when the module is merged, in order.
+            std::string messages;
+
+            // Lookup outcome. If the module's file could not be opened, the
+            // error describes why.
+            bool opened = false;
+            std::string openError;
+
+            // Compilation outcome. If the module was compiled without error
+            // but could not be captured as an object, its source is kept so
+            // that it can be compiled directly instead.
+            bool errorDetected = false;
+            bool saved = false, reused = false;
+            ModuleObject moduleObject;
+            std::string source;
+
+            // Error that ended compilation abnormally, if any.
+            std::string failure;
+        };
+
+        // Constructor, destructor.
+        ModulePool
+            (unsigned threadCount, const ModuleFinder &,
+             const std::string &specData, unsigned optimizationLevel,
+             const std::set<std::string> &boundMemberNames,
+             const std::string &moduleObjectDirectoryName,
+             bool scanning = false);
+        ~ModulePool();
+
+        // Submits the named module for compilation unless already submitted.
+        void Submit(const std::string &moduleName);
+
+        // Waits for the named module, which must have been submitted, and
+        // takes its result.
+        std::unique_ptr<Result> Take(const std::string &moduleName);
+
+    protected:
+
+        // Copy prevention.
+        ModulePool(const ModulePool &) = delete;
+        ModulePool &operator =(const ModulePool &) = delete;
+
+    private:
+
+        // Internal methods.
+        void Work();
+        std::unique_ptr<Result> Compile(const std::string &moduleName);
+        std::unique_ptr<Result> Scan(const std::string &moduleName);
+
+        // Configuration.
+        const ModuleFinder &finder;
+        std::string specData;
+        unsigned optimizationLevel;
+        std::set<std::string> boundMemberNames;
+        std::string moduleObjectDirectoryName;
+        bool scanning;
+
+        // Work queue and results, guarded by the mutex.
+        std::mutex mutex;
+        std::condition_variable workAvailable, resultAvailable;
+        bool stopping = false;
+        std::set<std::string> submittedModuleNames;
+        std::deque<std::string> pendingModuleNames;
+        std::map<std::string, std::unique_ptr<Result> > results;
+
+        std::vector<std::thread> threads;
+};
+
+#endif
@@ -0,0 +1,698 @@
+//
+// Asp executable optimization implementation.
+//
+
+#include "executable.hpp"
+#include "instruction.hpp"
+#include "opcode.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+static const unsigned MaxPeepholePasses = 16;
+static const unsigned MaxJumpChainLength = 32;
+
+static bool IsPurePush(uint8_t opCode);
+static bool IsConstantCondition(uint8_t opCode, bool &value);
+static bool IsJump(uint8_t opCode);
+static bool IsUnconditionalTransfer(uint8_t opCode);
+static bool IsSymbolVariant(uint8_t opCode, uint8_t opCode1);
+static bool IsParameterCode(uint8_t opCode);
+
+void Executable::Optimize()
+{
+    // Repeat the peephole pass until it no longer makes any changes, as one
+    // change may expose opportunities for others.
+    for (unsigned pass = 0; pass < MaxPeepholePasses; pass++)
+    {
+        if (!OptimizePeephole())
+            break;
+    }
+}
+
+bool Executable::OptimizePeephole()
+{
+    // Note that instructions are never removed from the list, as locations
+    // refer to them. Instead, they are replaced by null instructions, which
+    // occupy no space in the final code.
+    bool changed = false;
+    auto labels = Labels();
+    auto nullify = [&](const Location &location)
+    {
+        // Jumps to a removed instruction now reach the one that follows.
+        if (labels.count(&*location) != 0)
+        {
+            auto nextIter = NextInstruction(next(location));
+            if (nextIter != instructions.end())
+                labels.insert(&*nextIter);
+        }
+        Replace(location, new NullInstruction);
+        changed = true;
+    };
+    for (auto iter = instructions.begin(); iter != instructions.end(); iter++)
+    {
+        auto instruction = iter->instruction;
+        if (instruction->Size() == 0)
+            continue;
+        auto opCode = instruction->OpCode();
+
+        // Remove unreachable instructions, i.e., those that follow an
+        // unconditional transfer of control and are not the target of any
+        // jump.
+        if (IsUnconditionalTransfer(opCode))
+        {
+            for (auto unreachableIter = NextInstruction(next(iter));
+                 unreachableIter != instructions.end() &&
+                 labels.count(&*unreachableIter) == 0;
+                 unreachableIter = NextInstruction(next(unreachableIter)))
+                nullify(unreachableIter);
+        }
+
+        // Locate the instruction that follows. Patterns involving it may be
+        // applied only if it is not the target of any jump.
+        auto nextIter = NextInstruction(next(iter));
+        auto nextInstruction =
+            nextIter == instructions.end() ? nullptr : nextIter->instruction;
+        auto nextOpCode =
+            nextInstruction == nullptr ? OpCode_NOOP :
+            nextInstruction->OpCode();
+        bool nextIsLabel =
+            nextInstruction == nullptr || labels.count(&*nextIter) != 0;
+
+        // Drop no-operation instructions.
+        if (opCode == OpCode_NOOP)
+        {
+            nullify(iter);
+            continue;
+        }
+
+        // Remove a value pushed only to be popped.
+        if (!nextIsLabel && IsPurePush(opCode) &&
+            (nextOpCode == OpCode_POP || nextOpCode == OpCode_POP1))
+        {
+            auto count = static_cast<const PopInstruction *>
+                (nextInstruction)->Count();
+            auto comment = nextInstruction->Comment();
+            nullify(iter);
+            if (count > 1)
+                Replace(nextIter, new PopInstruction(count - 1, comment));
+            else
+                nullify(nextIter);
+            continue;
+        }
+
+        // Resolve a conditional jump on a constant condition, either into an
+        // unconditional jump or into nothing at all.
+        bool condition;
+        if (!nextIsLabel && IsConstantCondition(opCode, condition) &&
+            (nextOpCode == OpCode_JMPF || nextOpCode == OpCode_JMPT))
+        {
+            nullify(iter);
+            if (condition == (nextOpCode == OpCode_JMPT))
+                Replace
+                    (nextIter,
+                     new JumpInstruction
+                        (nextInstruction->TargetLocation(),
+                         nextInstruction->Comment()));
+            else
+                nullify(nextIter);
+            continue;
+        }
+
+        // Fold a pop into a preceding instruction that has a popping variant.
+        if (!nextIsLabel &&
+            (opCode == OpCode_SET || opCode == OpCode_ADDSET ||
+             opCode == OpCode_INS) &&
+            (nextOpCode == OpCode_POP || nextOpCode == OpCode_POP1))
+        {
+            auto count = static_cast<const PopInstruction *>
+                (nextInstruction)->Count();
+            auto comment = instruction->Comment();
+            auto popComment = nextInstruction->Comment();
+            Replace
+                (iter,
+                 opCode == OpCode_SET ?
+                 static_cast<Instruction *>
+                    (new SetInstruction(true, comment)) :
+                 opCode == OpCode_ADDSET ?
+                 static_cast<Instruction *>
+                    (new AddSetInstruction(true, comment)) :
+                 new InsertInstruction(true, comment));
+            if (count > 1)
+                Replace(nextIter, new PopInstruction(count - 1, popComment));
+            else
+                nullify(nextIter);
+            changed = true;
+            continue;
+        }
+
+        // Collapse an assignment to a variable followed by a load of the same
+        // variable into a non-popping assignment.
+        if ((opCode == OpCode_LDA1 || opCode == OpCode_LDA2 ||
+             opCode == OpCode_LDA4) &&
+            !nextIsLabel && nextOpCode == OpCode_SETP)
+        {
+            auto loadIter = NextInstruction(next(nextIter));
+            if (loadIter != instructions.end() &&
+                labels.count(&*loadIter) == 0)
+            {
+                auto loadOpCode = loadIter->instruction->OpCode();
+                if ((loadOpCode == OpCode_LD1 || loadOpCode == OpCode_LD2 ||
+                     loadOpCode == OpCode_LD4) &&
+                    static_cast<const LoadInstruction *>
+                        (loadIter->instruction)->Symbol() ==
+                    static_cast<const LoadInstruction *>
+                        (instruction)->Symbol())
+                {
+                    Replace
+                        (nextIter,
+                         new SetInstruction
+                            (false, "Assign, leave value on stack"));
+                    nullify(loadIter);
+                    continue;
+                }
+            }
+        }
+
+        // Turn a call whose result is returned at once into a tail call,
+        // which lets the called function reuse the caller's frame. The return
+        // remains in place for calls that cannot be made that way.
+        if (opCode == OpCode_CALL && nextOpCode == OpCode_RET)
+        {
+            Replace(iter, new CallInstruction(true, instruction->Comment()));
+            changed = true;
+            continue;
+        }
+
+        if (!IsJump(opCode))
+            continue;
+
+        // Thread jumps to unconditional jumps through to the final target.
+        auto targetLocation = instruction->TargetLocation();
+        auto targetIter = NextInstruction(targetLocation);
+        for (unsigned length = 0;
+             length < MaxJumpChainLength &&
+             targetIter != instructions.end() && targetIter != iter &&
+             targetIter->instruction->OpCode() == OpCode_JMP;
+             length++)
+        {
+            targetLocation = targetIter->instruction->TargetLocation();
+            targetIter = NextInstruction(targetLocation);
+        }
+        if (targetLocation != instruction->TargetLocation())
+        {
+            if (targetIter != instructions.end())
+                labels.insert(&*targetIter);
+            auto comment = instruction->Comment();
+            Replace
+                (iter,
+                 opCode == OpCode_JMP ?
+                 static_cast<Instruction *>
+                    (new JumpInstruction(targetLocation, comment)) :
+                 new ConditionalJumpInstruction
+                    (opCode == OpCode_JMPT, targetLocation, comment));
+            instruction = iter->instruction;
+            changed = true;
+        }
+
+        // Replace an unconditional jump to a return with the return itself.
+        if (opCode == OpCode_JMP && targetIter != instructions.end() &&
+            targetIter->instruction->OpCode() == OpCode_RET)
+        {
+            Replace
+                (iter,
+                 new ReturnInstruction(targetIter->instruction->Comment()));
+            changed = true;
+            continue;
+        }
+
+        // Remove an unconditional jump to the instruction that follows.
+        if (opCode == OpCode_JMP && targetIter == nextIter)
+        {
+            nullify(iter);
+            continue;
+        }
+
+        // Invert a conditional jump over an unconditional jump.
+        if ((opCode == OpCode_JMPF || opCode == OpCode_JMPT) &&
+            !nextIsLabel && nextOpCode == OpCode_JMP &&
+            targetIter == NextInstruction(next(nextIter)))
+        {
+            // The inverted jump takes over the role of the unconditional one.
+            auto comment = nextInstruction->Comment();
+            Replace
+                (iter,
+                 new ConditionalJumpInstruction
+                    (opCode == OpCode_JMPF,
+                     nextInstruction->TargetLocation(), comment));
+            nullify(nextIter);
+            continue;
+        }
+    }
+
+    return changed;
+}
+
+void Executable::EliminateDeadCode()
+{
+    // Count the references to each named symbol.
+    vector<unsigned> referenceCounts;
+    for (const auto &instructionInfo: instructions)
+    {
+        auto operand = instructionInfo.instruction->SymbolOperand();
+        if (operand == nullptr || *operand < 0)
+            continue;
+        auto symbol = static_cast<size_t>(*operand);
+        if (symbol >= referenceCounts.size())
+            referenceCounts.resize(symbol + 1);
+        referenceCounts[symbol]++;
+    }
+    auto symbolOf = [](const Location &location)
+    {
+        return *location->instruction->SymbolOperand();
+    };
+
+    // A name can be reached without being referenced by symbol through a
+    // module value, by iterating it or handing it to a function such as
+    // exists() along with a symbol obtained from the iteration. Give up
+    // unless the current module is never fetched and every module value is
+    // only ever used to look up members by symbol.
+    const auto &constSymbolTable = symbolTable;
+    if (constSymbolTable.IsDefined("module"))
+    {
+        auto symbol = constSymbolTable.Symbol("module");
+        if (static_cast<size_t>(symbol) < referenceCounts.size() &&
+            referenceCounts[symbol] != 0)
+            return;
+    }
+    auto labels = Labels();
+    auto isFollowedBy = [&]
+        (Location &iter, uint8_t opCode, uint8_t opCode1)
+    {
+        auto nextIter = NextInstruction(next(iter));
+        if (nextIter == instructions.end() || labels.count(&*nextIter) != 0)
+            return false;
+        auto nextOpCode = nextIter->instruction->OpCode();
+        if (nextOpCode != opCode &&
+            (opCode1 == 0 || !IsSymbolVariant(nextOpCode, opCode1)))
+            return false;
+        iter = nextIter;
+        return true;
+    };
+    unordered_set<int32_t> moduleVariables;
+    for (auto iter = instructions.begin(); iter != instructions.end(); iter++)
+    {
+        if (iter->instruction->Size() == 0 ||
+            !IsSymbolVariant(iter->instruction->OpCode(), OpCode_PUSHM1))
+            continue;
+        auto nextIter = iter;
+        if (isFollowedBy(nextIter, 0, OpCode_LDA1))
+        {
+            auto loadIter = nextIter;
+            if (!isFollowedBy(nextIter, OpCode_SETP, 0))
+                return;
+            moduleVariables.insert(symbolOf(loadIter));
+        }
+        else if (isFollowedBy(nextIter, 0, OpCode_LD1))
+        {
+            // A wildcard import looks up each member by the symbol obtained
+            // from iterating the module, held in a temporary variable.
+            if (symbolOf(nextIter) >= 0 ||
+                !isFollowedBy(nextIter, OpCode_MEM, 0))
+                return;
+        }
+        else if (!isFollowedBy(nextIter, OpCode_SITER, 0) &&
+                 !isFollowedBy(nextIter, 0, OpCode_MEM1))
+            return;
+    }
+    for (auto iter = instructions.begin(); iter != instructions.end(); iter++)
+    {
+        if (iter->instruction->Size() == 0)
+            continue;
+        auto opCode = iter->instruction->OpCode();
+        if ((IsSymbolVariant(opCode, OpCode_LD1) ||
+             IsSymbolVariant(opCode, OpCode_MEM1)) &&
+            moduleVariables.count(symbolOf(iter)) != 0)
+        {
+            auto nextIter = iter;
+            if (!isFollowedBy(nextIter, 0, OpCode_MEM1) &&
+                !isFollowedBy(nextIter, 0, OpCode_MEMA1))
+                return;
+        }
+    }
+
+    // Collect the definitions that may be removed if the variable they
+    // assign is referenced nowhere else: function definitions whose default
+    // parameter values have no side effects, and assignments of constants.
+    struct Definition
+    {
+        int32_t symbol;
+        Location first, last;
+    };
+    vector<Definition> definitions;
+    vector<vector<size_t> > definitionsBySymbol(referenceCounts.size());
+    auto addDefinition = [&](const Location &first, const Location &load)
+    {
+        auto symbol = symbolOf(load);
+        if (symbol < 0 || symbolTable.IsReserved(symbol))
+            return;
+        definitionsBySymbol[symbol].push_back(definitions.size());
+        definitions.push_back({symbol, first, NextInstruction(next(load))});
+    };
+    for (auto iter = instructions.begin(); iter != instructions.end(); iter++)
+    {
+        if (iter->instruction->Size() == 0)
+            continue;
+        auto opCode = iter->instruction->OpCode();
+
+        // Constant assignment: a value push, a variable address load, and an
+        // assignment with pop, with no way in other than through the first.
+        if (IsPurePush(opCode))
+        {
+            auto nextIter = iter;
+            if (isFollowedBy(nextIter, 0, OpCode_LDA1))
+            {
+                auto loadIter = nextIter;
+                if (isFollowedBy(nextIter, OpCode_SETP, 0))
+                    addDefinition(iter, loadIter);
+            }
+            continue;
+        }
+
+        // Function definition: a jump around the function's code, the
+        // parameter list, a code address push, a function make, and an
+        // assignment to the function's variable.
+        if (opCode != OpCode_PUSHCA || labels.count(&*iter) != 0)
+            continue;
+        auto nextIter = iter;
+        if (!isFollowedBy(nextIter, OpCode_MKFUN, 0) ||
+            !isFollowedBy(nextIter, 0, OpCode_LDA1))
+            continue;
+        auto loadIter = nextIter;
+        if (!isFollowedBy(nextIter, OpCode_SETP, 0))
+            continue;
+        auto jumpIter = iter->instruction->TargetLocation();
+        while (jumpIter != instructions.begin() &&
+               (--jumpIter)->instruction->Size() == 0)
+            ;
+        if (jumpIter->instruction->Size() == 0 ||
+            jumpIter->instruction->OpCode() != OpCode_JMP)
+            continue;
+        auto parameterIter = NextInstruction
+            (jumpIter->instruction->TargetLocation());
+        while (parameterIter != iter && parameterIter != instructions.end())
+        {
+            auto parameterOpCode = parameterIter->instruction->OpCode();
+            if (!IsPurePush(parameterOpCode) &&
+                !IsParameterCode(parameterOpCode))
+                break;
+            parameterIter = NextInstruction(next(parameterIter));
+        }
+        if (parameterIter == iter)
+            addDefinition(jumpIter, loadIter);
+    }
+
+    // Remove definitions whose variables are referenced only by the
+    // definitions themselves. Removing one may leave others unreferenced in
+    // turn, so the count for each symbol is kept up to date as instructions
+    // are removed.
+    vector<size_t> removable;
+    for (size_t i = 0; i < definitions.size(); i++)
+    {
+        if (referenceCounts[definitions[i].symbol] == 1)
+            removable.push_back(i);
+    }
+    auto remove = [&](const Location &first, const Location &last)
+    {
+        auto nextIter = NextInstruction(next(last));
+        if (labels.count(&*first) != 0 && nextIter != instructions.end())
+            labels.insert(&*nextIter);
+        for (auto iter = first; iter != nextIter; iter++)
+        {
+            auto instruction = iter->instruction;
+            if (instruction->Size() == 0)
+                continue;
+            auto operand = instruction->SymbolOperand();
+            if (operand != nullptr && *operand >= 0 &&
+                --referenceCounts[*operand] == 1)
+                removable.insert
+                    (removable.end(),
+                     definitionsBySymbol[*operand].begin(),
+                     definitionsBySymbol[*operand].end());
+            Replace(iter, new NullInstruction);
+        }
+    };
+
+    // Collect the references to each script module: its address, and the
+    // loads of the module by import statements. A module left with no code
+    // is removed along with its imports if those are the only references to
+    // the module and to the variables the imports assign.
+    unordered_map<int32_t, vector<Location> > moduleReferences;
+    for (auto iter = instructions.begin(); iter != instructions.end(); iter++)
+    {
+        auto opCode = iter->instruction->OpCode();
+        if (iter->instruction->Size() != 0 &&
+            (IsSymbolVariant(opCode, OpCode_ADDMOD1) ||
+             IsSymbolVariant(opCode, OpCode_LDMOD1)))
+            moduleReferences[symbolOf(iter)].push_back(iter);
+    }
+
+    bool changed = true;
+    while (changed)
+    {
+        while (!removable.empty())
+        {
+            const auto &definition = definitions[removable.back()];
+            removable.pop_back();
+            if (definition.first->instruction->Size() != 0 &&
+                definition.last->instruction->Size() != 0 &&
+                referenceCounts[definition.symbol] == 1)
+                remove(definition.first, definition.last);
+        }
+
+        changed = false;
+        for (const auto &moduleLocation: moduleLocations)
+        {
+            auto symbol = static_cast<int32_t>(moduleLocation.first);
+            auto exitIter = NextInstruction(moduleLocation.second.first);
+            if (exitIter == instructions.end() ||
+                exitIter->instruction->OpCode() != OpCode_XMOD)
+                continue;
+            auto referencesIter = moduleReferences.find(symbol);
+            if (referencesIter == moduleReferences.end())
+                continue;
+
+            vector<pair<Location, Location> > ranges;
+            unordered_map<int32_t, unsigned> rangeReferenceCounts;
+            bool unused = true;
+            for (const auto &location: referencesIter->second)
+            {
+                if (location->instruction->Size() == 0)
+                    continue;
+                rangeReferenceCounts[symbol]++;
+                if (IsSymbolVariant
+                        (location->instruction->OpCode(), OpCode_ADDMOD1))
+                {
+                    ranges.emplace_back(location, location);
+                    continue;
+                }
+                auto iter = location;
+                if (!isFollowedBy(iter, 0, OpCode_PUSHM1) ||
+                    symbolOf(iter) != symbol ||
+                    !isFollowedBy(iter, 0, OpCode_LDA1))
+                {
+                    unused = false;
+                    break;
+                }
+                rangeReferenceCounts[symbol]++;
+                rangeReferenceCounts[symbolOf(iter)]++;
+                if (!isFollowedBy(iter, OpCode_SETP, 0))
+                {
+                    unused = false;
+                    break;
+                }
+                ranges.emplace_back(location, iter);
+            }
+            for (const auto &rangeReferenceCount: rangeReferenceCounts)
+            {
+                if (referenceCounts[rangeReferenceCount.first] !=
+                    rangeReferenceCount.second)
+                    unused = false;
+            }
+            if (!unused)
+                continue;
+
+            for (const auto &range: ranges)
+                remove(range.first, range.second);
+            remove(exitIter, exitIter);
+            changed = true;
+        }
+    }
+}
+
+Executable::Location Executable::NextInstruction(Location location)
+{
+    // Skip null instructions, which generate no code.
+    while (location != instructions.end() &&
+           location->instruction->Size() == 0)
+        location++;
+    return location;
+}
+
+void Executable::Replace(const Location &location, Instruction *instruction)
+{
+    delete location->instruction;
+    location->instruction = instruction;
+}
+
+unordered_set<const Executable::InstructionInfo *> Executable::Labels()
+{
+    // Collect the instructions that may be reached other than by falling
+    // through from the preceding instruction.
+    unordered_set<const InstructionInfo *> labels;
+    for (const auto &instructionInfo: instructions)
+    {
+        const auto &instruction = instructionInfo.instruction;
+        if (!instruction->HasTargetLocation())
+            continue;
+        auto targetIter = NextInstruction(instruction->TargetLocation());
+        if (targetIter != instructions.end())
+            labels.insert(&*targetIter);
+    }
+    for (const auto &moduleLocation: moduleLocations)
+    {
+        auto moduleIter = NextInstruction(moduleLocation.second.first);
+        if (moduleIter != instructions.end())
+            labels.insert(&*moduleIter);
+    }
+    return labels;
+}
+
+void Executable::RenumberSymbols()
+{
+    // Count the references to each named symbol in the remaining code.
+    vector<unsigned> referenceCounts;
+    for (const auto &instructionInfo: instructions)
+    {
+        auto operand = instructionInfo.instruction->SymbolOperand();
+        if (operand == nullptr || *operand < 0)
+            continue;
+        auto symbol = static_cast<size_t>(*operand);
+        if (symbol >= referenceCounts.size())
+            referenceCounts.resize(symbol + 1);
+        referenceCounts[symbol]++;
+    }
+
+    // Give the most frequently referenced symbols the lowest values, so that
+    // they can be encoded in the shortest operands.
+    auto renumbering = symbolTable.Renumber(referenceCounts);
+    for (const auto &instructionInfo: instructions)
+    {
+        auto instruction = instructionInfo.instruction;
+        auto operand = instruction->SymbolOperand();
+        if (operand != nullptr && *operand >= 0 &&
+            renumbering[*operand] != *operand)
+            instruction->RenumberSymbol(renumbering[*operand]);
+    }
+    decltype(moduleLocations) renumberedModuleLocations;
+    for (const auto &moduleLocation: moduleLocations)
+        renumberedModuleLocations.emplace
+            (renumbering[moduleLocation.first], moduleLocation.second);
+    moduleLocations.swap(renumberedModuleLocations);
+}
+
+static bool IsPurePush(uint8_t opCode)
+{
+    switch (opCode)
+    {
+        default:
+            return false;
+
+        case OpCode_PUSHN:
+        case OpCode_PUSHE:
+        case OpCode_PUSHF:
+        case OpCode_PUSHT:
+        case OpCode_PUSHI0:
+        case OpCode_PUSHI1:
+        case OpCode_PUSHI2:
+        case OpCode_PUSHI4:
+        case OpCode_PUSHD:
+        case OpCode_PUSHY1:
+        case OpCode_PUSHY2:
+        case OpCode_PUSHY4:
+        case OpCode_PUSHS0:
+        case OpCode_PUSHS1:
+        case OpCode_PUSHS2:
+        case OpCode_PUSHS4:
+        case OpCode_PUSHTU:
+        case OpCode_PUSHLI:
+        case OpCode_PUSHSE:
+        case OpCode_PUSHDI:
+            return true;
+    }
+}
+
+static bool IsConstantCondition(uint8_t opCode, bool &value)
+{
+    switch (opCode)
+    {
+        default:
+            return false;
+
+        case OpCode_PUSHN:
+        case OpCode_PUSHF:
+        case OpCode_PUSHI0:
+        case OpCode_PUSHS0:
+            value = false;
+            return true;
+
+        case OpCode_PUSHE:
+        case OpCode_PUSHT:
+        case OpCode_PUSHI1:
+        case OpCode_PUSHI2:
+        case OpCode_PUSHI4:
+        case OpCode_PUSHS1:
+        case OpCode_PUSHS2:
+        case OpCode_PUSHS4:
+            value = true;
+            return true;
+    }
+}
+
+static bool IsJump(uint8_t opCode)
+{
+    return
+        opCode == OpCode_JMP ||
+        opCode == OpCode_JMPF ||
+        opCode == OpCode_JMPT;
+}
+
+static bool IsUnconditionalTransfer(uint8_t opCode)
+{
+    return
+        opCode == OpCode_JMP ||
+        opCode == OpCode_RET ||
+        opCode == OpCode_XMOD ||
+        opCode == OpCode_ABORT ||
+        opCode == OpCode_END;
+}
+
+static bool IsSymbolVariant(uint8_t opCode, uint8_t opCode1)
+{
+    // The low two bits of op codes with a symbol operand encode its size,
+    // and are zero only in variants that take the symbol from the stack.
+    return (opCode & ~0x03) == (opCode1 & ~0x03) && (opCode & 0x03) != 0;
+}
+
+static bool IsParameterCode(uint8_t opCode)
+{
+    return
+        opCode == OpCode_PUSHPL ||
+        opCode == OpCode_BLD ||
+        IsSymbolVariant(opCode, OpCode_MKPAR1) ||
+        IsSymbolVariant(opCode, OpCode_MKDPAR1) ||
+        IsSymbolVariant(opCode, OpCode_MKTGPAR1) ||
+        IsSymbolVariant(opCode, OpCode_MKDGPAR1);
+}
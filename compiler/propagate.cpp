@@ -0,0 +1,725 @@
+//
+// Asp constant propagation routines from all classes.
+//
+
+#include "statement.hpp"
+#include "expression.hpp"
+#include "asp.h"
+
+using namespace std;
+
+static void PropagateExpression(Expression *&, const KnownValues &);
+
+void Block::CollectBindings(ScopeBindings &bindings) const
+{
+    for (const auto &statement: statements)
+        statement->CollectBindings(bindings);
+}
+
+void Block::Propagate(const KnownValues &values)
+{
+    for (auto &statement: statements)
+        statement->Propagate(values);
+}
+
+void Block::PropagateModuleConstants
+    (const Executable &executable, set<string> &readNames)
+{
+    // Gather the names bound anywhere at the module level. A wildcard import
+    // may bind any name, ruling out propagation altogether.
+    ScopeBindings bindings;
+    CollectBindings(bindings);
+    if (bindings.hasWildcardImport)
+        return;
+
+    // A module's variables may also be bound from elsewhere: by functions
+    // that declare them global, and, by way of member assignments, from any
+    // module of the program, including this one. Note the names checked, as
+    // the code generated for those the module reads depends on the outcome.
+    const auto &memberNames = executable.BoundMemberNames();
+    set<string> checkedNames;
+    auto rebindable = [&](const string &name)
+    {
+        checkedNames.insert(name);
+        return
+            bindings.globalNames.count(name) != 0 ||
+            bindings.memberNames.count(name) != 0 ||
+            memberNames.count(name) != 0;
+    };
+
+    set<string> moduleReadNames;
+    KnownValues values;
+    values.readNames = &moduleReadNames;
+    values.executable = &executable;
+
+    // Treat as inlinable each small function that is defined exactly once,
+    // by a statement at the top level of the module, and that may not be
+    // rebound. So that inlined bodies never call for more inlining, exclude
+    // those that refer to any such function, including themselves.
+    list<InlineFunction> functions;
+    map<string, const InlineFunction *> inlineFunctions;
+    for (const auto &statement: statements)
+    {
+        auto defStatement = dynamic_cast<const DefStatement *>(statement);
+        if (defStatement == nullptr)
+            continue;
+
+        const auto &name = defStatement->Name();
+        InlineFunction function = {defStatement, {}};
+        if (bindings.bindingCounts[name] != 1 || rebindable(name) ||
+            !defStatement->Inlinable(function.freeNames))
+            continue;
+        functions.push_back(function);
+        inlineFunctions.insert(make_pair(name, &functions.back()));
+    }
+    set<string> excludedNames;
+    for (const auto &function: functions)
+    {
+        for (const auto &name: function.freeNames)
+        {
+            if (inlineFunctions.count(name) != 0)
+            {
+                excludedNames.insert(function.defStatement->Name());
+                break;
+            }
+        }
+    }
+    for (const auto &name: excludedNames)
+        inlineFunctions.erase(name);
+    for (const auto &function: functions)
+        moduleReadNames.insert
+            (function.freeNames.begin(), function.freeNames.end());
+
+    // Lookups of invariant names are hoisted out of loops, ahead of which
+    // they must already be bound. The functions and variables that the
+    // application defines globally, and that the module never binds, are
+    // invariant throughout; other application names, such as parameters,
+    // are not bound at all. Within functions, so are the module's variables
+    // and functions bound exactly once, by a statement at the top level of
+    // the module that precedes the function's definition. Neither may be
+    // rebound, as code called from within a loop may do so. Lookups of the
+    // latter are left alone at the top level of the module, where hoisting
+    // them would not save anything.
+    for (const auto &name: executable.ApplicationDefinitionNames())
+    {
+        auto iter = bindings.bindingCounts.find(name);
+        if ((iter == bindings.bindingCounts.end() || iter->second == 0) &&
+            !rebindable(name))
+            values.invariantNames.insert(name);
+    }
+    values.functionInvariantNames = values.invariantNames;
+
+    // Propagate through the module's statements in order, so that what is
+    // learned from each statement reaches only the code that runs after it:
+    // the statements that follow and the bodies of the functions they
+    // define. A variable assigned a constant exactly once, by a statement at
+    // the top level of the module, is treated as constant from then on
+    // unless it may be rebound, and calls to an inlinable function are
+    // inlined once its definition has run. Propagating into an assignment
+    // may reduce the value it assigns to a constant, so check only
+    // afterwards.
+    for (auto &statement: statements)
+    {
+        // A function's name is bound by the time its body runs.
+        auto defStatement = dynamic_cast<const DefStatement *>(statement);
+        if (defStatement == nullptr)
+            statement->Propagate(values);
+        auto assignmentStatement =
+            dynamic_cast<const AssignmentStatement *>(statement);
+        if (defStatement == nullptr && assignmentStatement == nullptr &&
+            dynamic_cast<const ImportStatement *>(statement) == nullptr)
+            continue;
+
+        ScopeBindings statementBindings;
+        statement->CollectBindings(statementBindings);
+        for (const auto &bindingCount: statementBindings.bindingCounts)
+        {
+            const auto &name = bindingCount.first;
+            if (bindings.bindingCounts[name] == 1 && !rebindable(name))
+                values.functionInvariantNames.insert(name);
+        }
+
+        string name;
+        const ConstantExpression *constantExpression = nullptr;
+        if (assignmentStatement != nullptr)
+            constantExpression =
+                assignmentStatement->ConstantAssignment(name);
+        if (constantExpression != nullptr &&
+            bindings.bindingCounts[name] == 1 && !rebindable(name))
+            values.constants.insert(make_pair(name, constantExpression));
+
+        if (defStatement != nullptr)
+        {
+            auto iter = inlineFunctions.find(defStatement->Name());
+            if (iter != inlineFunctions.end())
+                values.functions.insert(*iter);
+            statement->Propagate(values);
+        }
+    }
+
+    // Report the names read, including those that inlinable functions refer
+    // to, whose treatment depended on whether they may be rebound.
+    for (const auto &name: moduleReadNames)
+    {
+        if (checkedNames.count(name) != 0)
+            readNames.insert(name);
+    }
+}
+
+void Statement::CollectBindings(ScopeBindings &) const
+{
+    // Most statements bind no names.
+}
+
+void Statement::Propagate(const KnownValues &)
+{
+    // Most statements contain no expressions.
+}
+
+void ExpressionStatement::Propagate(const KnownValues &values)
+{
+    PropagateExpression(expression, values);
+}
+
+void AssignmentStatement::CollectBindings(ScopeBindings &bindings) const
+{
+    list<string> names;
+    targetExpression->BoundNames(names);
+    for (const auto &name: names)
+        bindings.bindingCounts[name]++;
+    names.clear();
+    targetExpression->BoundMemberNames(names);
+    bindings.memberNames.insert(names.begin(), names.end());
+    if (valueAssignmentStatement != nullptr)
+        valueAssignmentStatement->CollectBindings(bindings);
+}
+
+void AssignmentStatement::Propagate(const KnownValues &values)
+{
+    // Note that targets are left alone, even when they contain expressions,
+    // so that variable addresses are never replaced with constant values.
+    if (valueAssignmentStatement != nullptr)
+        valueAssignmentStatement->Propagate(values);
+    else
+        PropagateExpression(valueExpression, values);
+}
+
+const ConstantExpression *AssignmentStatement::ConstantAssignment
+    (string &name) const
+{
+    auto variableExpression = dynamic_cast<const VariableExpression *>
+        (targetExpression);
+    if (assignmentTokenType != TOKEN_ASSIGN ||
+        variableExpression == nullptr || variableExpression->HasSymbol())
+        return nullptr;
+
+    name = variableExpression->Name();
+    return dynamic_cast<const ConstantExpression *>(valueExpression);
+}
+
+void InsertionStatement::Propagate(const KnownValues &values)
+{
+    if (containerInsertionStatement != nullptr)
+        containerInsertionStatement->Propagate(values);
+    else
+        PropagateExpression(containerExpression, values);
+
+    if (keyValuePair != nullptr)
+        keyValuePair->Propagate(values);
+    else
+        PropagateExpression(itemExpression, values);
+}
+
+void ImportStatement::CollectBindings(ScopeBindings &bindings) const
+{
+    if (memberNameList == nullptr)
+    {
+        for (auto iter = moduleNameList->NamesBegin();
+             iter != moduleNameList->NamesEnd(); iter++)
+            bindings.bindingCounts[(*iter)->AsName()]++;
+    }
+    else
+    {
+        for (auto iter = memberNameList->NamesBegin();
+             iter != memberNameList->NamesEnd(); iter++)
+        {
+            const auto &name = (*iter)->Name();
+            if (name == "*")
+                bindings.hasWildcardImport = true;
+            else
+                bindings.bindingCounts[(*iter)->AsName()]++;
+        }
+    }
+}
+
+void GlobalStatement::CollectBindings(ScopeBindings &bindings) const
+{
+    for (auto iter = variableList->NamesBegin();
+         iter != variableList->NamesEnd(); iter++)
+        bindings.globalNames.insert(*iter);
+}
+
+void DelStatement::CollectBindings(ScopeBindings &bindings) const
+{
+    list<string> names;
+    GetExpression()->BoundNames(names);
+    for (const auto &name: names)
+        bindings.bindingCounts[name]++;
+    names.clear();
+    GetExpression()->BoundMemberNames(names);
+    bindings.memberNames.insert(names.begin(), names.end());
+}
+
+void DelStatement::Propagate(const KnownValues &)
+{
+    // Deleted variables must remain variables.
+}
+
+void ReturnStatement::Propagate(const KnownValues &values)
+{
+    if (expression != nullptr)
+        PropagateExpression(expression, values);
+}
+
+void IfStatement::CollectBindings(ScopeBindings &bindings) const
+{
+    trueBlock->CollectBindings(bindings);
+    if (falseBlock != nullptr)
+        falseBlock->CollectBindings(bindings);
+    else if (elsePart != nullptr)
+        elsePart->CollectBindings(bindings);
+}
+
+void IfStatement::Propagate(const KnownValues &values)
+{
+    PropagateExpression(conditionExpression, values);
+    trueBlock->Propagate(values);
+    if (falseBlock != nullptr)
+        falseBlock->Propagate(values);
+    else if (elsePart != nullptr)
+        elsePart->Propagate(values);
+}
+
+void WhileStatement::CollectBindings(ScopeBindings &bindings) const
+{
+    trueBlock->CollectBindings(bindings);
+    if (falseBlock != nullptr)
+        falseBlock->CollectBindings(bindings);
+}
+
+void WhileStatement::Propagate(const KnownValues &values)
+{
+    auto loopValues = LoopValues(values);
+    PropagateExpression(conditionExpression, loopValues);
+    trueBlock->Propagate(loopValues);
+    if (falseBlock != nullptr)
+        falseBlock->Propagate(loopValues);
+}
+
+void ForStatement::CollectBindings(ScopeBindings &bindings) const
+{
+    list<string> names;
+    targetExpression->BoundNames(names);
+    for (const auto &name: names)
+        bindings.bindingCounts[name]++;
+    trueBlock->CollectBindings(bindings);
+    if (falseBlock != nullptr)
+        falseBlock->CollectBindings(bindings);
+}
+
+void ForStatement::Propagate(const KnownValues &values)
+{
+    // The iterable is evaluated only once, ahead of the loop proper.
+    PropagateExpression(iterableExpression, values);
+    auto loopValues = LoopValues(values);
+    trueBlock->Propagate(loopValues);
+    if (falseBlock != nullptr)
+        falseBlock->Propagate(loopValues);
+}
+
+KnownValues LoopStatement::LoopValues(const KnownValues &values)
+{
+    // Hoist lookups within nested loops all the way out of the outermost
+    // one, which is the first to record hoisted names.
+    auto loopValues = values;
+    if (loopValues.hoistedSymbols == nullptr &&
+        !loopValues.invariantNames.empty())
+        loopValues.hoistedSymbols = &hoistedSymbols;
+    return loopValues;
+}
+
+void Parameter::CollectBindings(ScopeBindings &bindings) const
+{
+    bindings.bindingCounts[name]++;
+}
+
+void Parameter::Propagate(const KnownValues &values)
+{
+    if (defaultExpression != nullptr)
+        PropagateExpression(defaultExpression, values);
+}
+
+void ParameterList::CollectBindings(ScopeBindings &bindings) const
+{
+    for (const auto &parameter: parameters)
+        parameter->CollectBindings(bindings);
+}
+
+void ParameterList::Propagate(const KnownValues &values)
+{
+    for (auto &parameter: parameters)
+        parameter->Propagate(values);
+}
+
+void DefStatement::CollectBindings(ScopeBindings &bindings) const
+{
+    bindings.bindingCounts[name]++;
+
+    // Names declared global within the function may be bound by it, as may
+    // members of any module.
+    ScopeBindings localBindings;
+    block->CollectBindings(localBindings);
+    bindings.globalNames.insert
+        (localBindings.globalNames.begin(), localBindings.globalNames.end());
+    bindings.memberNames.insert
+        (localBindings.memberNames.begin(), localBindings.memberNames.end());
+}
+
+void DefStatement::Propagate(const KnownValues &values)
+{
+    // Default parameter values are evaluated in the enclosing scope.
+    parameterList->Propagate(values);
+
+    // Names bound anywhere within the function, including parameters, may
+    // refer to local variables, so exclude them from propagation within the
+    // function's body.
+    ScopeBindings localBindings;
+    parameterList->CollectBindings(localBindings);
+    block->CollectBindings(localBindings);
+    if (localBindings.hasWildcardImport)
+        return;
+    auto localValues = values;
+    localValues.invariantNames = values.functionInvariantNames;
+    localValues.hoistedSymbols = nullptr;
+    for (const auto &bindingCount: localBindings.bindingCounts)
+    {
+        localValues.constants.erase(bindingCount.first);
+        localValues.invariantNames.erase(bindingCount.first);
+    }
+
+    // Likewise, leave alone calls to functions whose names, or the names
+    // their bodies refer to, may be bound locally.
+    for (auto iter = localValues.functions.begin();
+         iter != localValues.functions.end(); )
+    {
+        auto hidden = localBindings.bindingCounts.count(iter->first) != 0;
+        for (const auto &name: iter->second->freeNames)
+            hidden = hidden || localBindings.bindingCounts.count(name) != 0;
+        if (hidden)
+            iter = localValues.functions.erase(iter);
+        else
+            iter++;
+    }
+
+    block->Propagate(localValues);
+}
+
+void Expression::BoundNames(list<string> &) const
+{
+    // Most expressions cannot be assignment targets.
+}
+
+void Expression::BoundMemberNames(list<string> &) const
+{
+    // Most expressions cannot be member assignment targets.
+}
+
+Expression *Expression::Propagate(const KnownValues &)
+{
+    return this;
+}
+
+Expression *ConditionalExpression::Propagate(const KnownValues &values)
+{
+    PropagateExpression(conditionExpression, values);
+    PropagateExpression(trueExpression, values);
+    PropagateExpression(falseExpression, values);
+
+    // Attempt to fold the expression now that its parts may be constant.
+    Expression *result = nullptr;
+    try
+    {
+        result = FoldTernaryExpression
+            (operatorTokenType,
+             conditionExpression, trueExpression, falseExpression);
+    }
+    catch (const string &)
+    {
+        // Leave the error to be reported at run time.
+    }
+    if (result == nullptr)
+        return this;
+
+    // Detach the result so that it survives the deletion of this expression.
+    (SourceElement &)*result = *this;
+    if (result == trueExpression)
+        trueExpression = nullptr;
+    else if (result == falseExpression)
+        falseExpression = nullptr;
+    return result;
+}
+
+Expression *ShortCircuitLogicalExpression::Propagate
+    (const KnownValues &values)
+{
+    for (auto &expression: expressions)
+        PropagateExpression(expression, values);
+
+    // Eliminate leading constant operands, stopping early if one of them
+    // determines the result.
+    while (expressions.size() > 1)
+    {
+        Expression *result = nullptr;
+        try
+        {
+            result = FoldBinaryExpression
+                (operatorTokenType,
+                 expressions.front(), *next(expressions.begin()));
+        }
+        catch (const string &)
+        {
+            // Leave the error to be reported at run time.
+        }
+        if (result == nullptr)
+            return this;
+
+        auto leftExpression = expressions.front();
+        expressions.pop_front();
+        if (result == leftExpression)
+            return result;
+        delete leftExpression;
+    }
+
+    auto result = expressions.front();
+    expressions.pop_front();
+    return result;
+}
+
+Expression *BinaryExpression::Propagate(const KnownValues &values)
+{
+    PropagateExpression(leftExpression, values);
+    PropagateExpression(rightExpression, values);
+
+    // Attempt to fold the expression now that its operands may be constant.
+    Expression *result = nullptr;
+    try
+    {
+        result = FoldBinaryExpression
+            (operatorTokenType, leftExpression, rightExpression);
+    }
+    catch (const string &)
+    {
+        // Leave the error to be reported at run time.
+    }
+    if (result == nullptr)
+        return this;
+
+    (SourceElement &)*result = *this;
+    if (result == leftExpression)
+        leftExpression = nullptr;
+    else if (result == rightExpression)
+        rightExpression = nullptr;
+    return result;
+}
+
+Expression *UnaryExpression::Propagate(const KnownValues &values)
+{
+    PropagateExpression(expression, values);
+
+    // Attempt to fold the expression now that its operand may be constant.
+    Expression *result = nullptr;
+    try
+    {
+        result = FoldUnaryExpression(operatorTokenType, expression);
+    }
+    catch (const string &)
+    {
+        // Leave the error to be reported at run time.
+    }
+    if (result == nullptr)
+        return this;
+
+    (SourceElement &)*result = *this;
+    if (result == expression)
+        expression = nullptr;
+    return result;
+}
+
+void TargetExpression::BoundNames(list<string> &names) const
+{
+    if (!name.empty())
+        names.push_back(name);
+    for (const auto &targetExpression: targetExpressions)
+        targetExpression->BoundNames(names);
+}
+
+void Argument::Propagate(const KnownValues &values)
+{
+    PropagateExpression(valueExpression, values);
+}
+
+void ArgumentList::Propagate(const KnownValues &values)
+{
+    for (auto &argument: arguments)
+        argument->Propagate(values);
+}
+
+Expression *CallExpression::Propagate(const KnownValues &values)
+{
+    PropagateExpression(functionExpression, values);
+    argumentList->Propagate(values);
+
+    // Replace a call to an inlinable function with the function's body.
+    auto variableExpression = dynamic_cast<const VariableExpression *>
+        (functionExpression);
+    if (variableExpression == nullptr || variableExpression->HasSymbol())
+        return this;
+    auto iter = values.functions.find(variableExpression->Name());
+    if (iter == values.functions.end())
+        return this;
+    auto result = iter->second->defStatement->Inline
+        (*this, *argumentList, values);
+    if (result == nullptr)
+        return this;
+    PropagateExpression(result, values);
+    return result;
+}
+
+Expression *InlinedCallExpression::Propagate(const KnownValues &values)
+{
+    for (auto &argument: arguments)
+        PropagateExpression(argument.valueExpression, values);
+    PropagateExpression(bodyExpression, values);
+    if (!arguments.empty())
+        return this;
+
+    // With no temporary variables to manage, the body stands on its own.
+    auto result = bodyExpression;
+    bodyExpression = nullptr;
+    return result;
+}
+
+Expression *ElementExpression::Propagate(const KnownValues &values)
+{
+    PropagateExpression(sequenceExpression, values);
+    PropagateExpression(indexExpression, values);
+    return this;
+}
+
+void MemberExpression::BoundMemberNames(list<string> &names) const
+{
+    names.push_back(name);
+}
+
+Expression *MemberExpression::Propagate(const KnownValues &values)
+{
+    PropagateExpression(expression, values);
+    return this;
+}
+
+void VariableExpression::BoundNames(list<string> &names) const
+{
+    if (!hasSymbol)
+        names.push_back(name);
+}
+
+Expression *VariableExpression::Propagate(const KnownValues &values)
+{
+    if (hasSymbol)
+        return this;
+    if (values.readNames != nullptr)
+        values.readNames->insert(name);
+    auto iter = values.constants.find(name);
+    if (iter != values.constants.end())
+        return new ConstantExpression(*this, *iter->second);
+
+    // Refer to the temporary variable holding the value of an invariant name
+    // looked up ahead of the enclosing loop.
+    if (values.hoistedSymbols == nullptr ||
+        values.invariantNames.count(name) == 0)
+        return this;
+    auto &symbol = (*values.hoistedSymbols)[name];
+    if (symbol == 0)
+        symbol = values.executable->TemporarySymbol();
+    return new VariableExpression(*this, symbol);
+}
+
+void KeyValuePair::Propagate(const KnownValues &values)
+{
+    PropagateExpression(keyExpression, values);
+    PropagateExpression(valueExpression, values);
+}
+
+Expression *DictionaryExpression::Propagate(const KnownValues &values)
+{
+    for (auto &entry: entries)
+        entry->Propagate(values);
+    return this;
+}
+
+Expression *SetExpression::Propagate(const KnownValues &values)
+{
+    for (auto &expression: expressions)
+        PropagateExpression(expression, values);
+    return this;
+}
+
+Expression *ListExpression::Propagate(const KnownValues &values)
+{
+    for (auto &expression: expressions)
+        PropagateExpression(expression, values);
+    return this;
+}
+
+void TupleExpression::BoundNames(list<string> &names) const
+{
+    for (const auto &expression: expressions)
+        expression->BoundNames(names);
+}
+
+void TupleExpression::BoundMemberNames(list<string> &names) const
+{
+    for (const auto &expression: expressions)
+        expression->BoundMemberNames(names);
+}
+
+Expression *TupleExpression::Propagate(const KnownValues &values)
+{
+    for (auto &expression: expressions)
+        PropagateExpression(expression, values);
+    return this;
+}
+
+Expression *RangeExpression::Propagate(const KnownValues &values)
+{
+    if (startExpression != nullptr)
+        PropagateExpression(startExpression, values);
+    if (endExpression != nullptr)
+        PropagateExpression(endExpression, values);
+    if (stepExpression != nullptr)
+        PropagateExpression(stepExpression, values);
+    return this;
+}
+
+static void PropagateExpression
+    (Expression *&expression, const KnownValues &values)
+{
+    // Replace the expression if propagation produced a new one.
+    auto result = expression->Propagate(values);
+    if (result != expression)
+    {
+        result->Parent(expression->Parent());
+        delete expression;
+        expression = result;
+    }
+}
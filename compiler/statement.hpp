@@ -9,12 +9,25 @@
 #include "expression.hpp"
 #include "executable.hpp"
 #include <list>
+#include <map>
+#include <set>
 #include <string>
+#include <cstdint>
 
 class Block;
 class LoopStatement;
 class DefStatement;
 
+// Names bound within a scope, gathered to identify constant variables.
+// Member names bound anywhere within the scope, including within functions,
+// are gathered too, as they may name variables of any module.
+struct ScopeBindings
+{
+    std::map<std::string, unsigned> bindingCounts;
+    std::set<std::string> globalNames, memberNames;
+    bool hasWildcardImport = false;
+};
+
 class Statement : public NonTerminal
 {
     protected:
@@ -27,6 +40,9 @@ class Statement : public NonTerminal
         virtual const Block *Parent() const final;
         virtual unsigned StackUsage() const;
 
+        virtual void CollectBindings(ScopeBindings &) const;
+        virtual void Propagate(const KnownValues &);
+
         virtual void Emit(Executable &) const = 0;
 
         const LoopStatement *ParentLoop() const;
@@ -50,11 +66,17 @@ class Block : public NonTerminal
 
         const Statement *FinalStatement() const;
 
+        void CollectBindings(ScopeBindings &) const;
+        void Propagate(const KnownValues &);
+        void PropagateModuleConstants
+            (const Executable &, std::set<std::string> &readNames);
+
         void Emit(Executable &) const;
 
     private:
 
         friend class BlockStatement;
+        friend class DefStatement;
 
         const Statement *parentStatement = nullptr;
         std::list<Statement *> statements;
@@ -83,6 +105,8 @@ class ExpressionStatement : public Statement
         explicit ExpressionStatement(Expression *);
         ~ExpressionStatement() override;
 
+        void Propagate(const KnownValues &) override;
+
         void Emit(Executable &) const override;
 
         const Expression *GetExpression() const
@@ -109,6 +133,11 @@ class AssignmentStatement : public Statement
 
         void Parent(const Block *) override;
 
+        void CollectBindings(ScopeBindings &) const override;
+        void Propagate(const KnownValues &) override;
+
+        const ConstantExpression *ConstantAssignment(std::string &name) const;
+
         void Emit(Executable &) const override;
         void Emit1(Executable &, bool top) const;
 
@@ -137,6 +166,8 @@ class InsertionStatement : public Statement
              Expression *container, KeyValuePair *);
         ~InsertionStatement() override;
 
+        void Propagate(const KnownValues &) override;
+
         void Emit(Executable &) const override;
         void Emit1(Executable &, bool top) const;
 
@@ -231,6 +262,8 @@ class ImportStatement : public Statement
              ImportNameList *memberNameList = nullptr);
         ~ImportStatement() override;
 
+        void CollectBindings(ScopeBindings &) const override;
+
         void Emit(Executable &) const override;
 
     private:
@@ -273,6 +306,8 @@ class GlobalStatement : public Statement
         explicit GlobalStatement(VariableList *);
         ~GlobalStatement() override;
 
+        void CollectBindings(ScopeBindings &) const override;
+
         void Emit(Executable &) const override;
 
     private:
@@ -300,6 +335,9 @@ class DelStatement : public ExpressionStatement
 
         explicit DelStatement(Expression *);
 
+        void CollectBindings(ScopeBindings &) const override;
+        void Propagate(const KnownValues &) override;
+
         void Emit(Executable &) const override;
         void Emit1(Executable &, const Expression *) const;
 };
@@ -311,6 +349,13 @@ class ReturnStatement : public Statement
         ReturnStatement(const Token &keywordToken, Expression *);
         ~ReturnStatement() override;
 
+        const Expression *GetExpression() const
+        {
+            return expression;
+        }
+
+        void Propagate(const KnownValues &) override;
+
         void Emit(Executable &) const override;
 
     private:
@@ -338,6 +383,9 @@ class IfStatement : public Statement
 
         void Parent(const Block *) override;
 
+        void CollectBindings(ScopeBindings &) const override;
+        void Propagate(const KnownValues &) override;
+
         void Emit(Executable &) const override;
 
     private:
@@ -358,7 +406,15 @@ class LoopStatement : public Statement
 
         explicit LoopStatement(const SourceElement &);
 
+        KnownValues LoopValues(const KnownValues &);
+        void EmitHoistedLoads(Executable &) const;
+        void EmitHoistedDeletes(Executable &) const;
+
         mutable Executable::Location continueLocation, endLocation;
+
+    private:
+
+        std::map<std::string, std::int32_t> hoistedSymbols;
 };
 
 class WhileStatement : public LoopStatement
@@ -368,6 +424,9 @@ class WhileStatement : public LoopStatement
         WhileStatement(Expression *, Block *, Block *);
         ~WhileStatement() override;
 
+        void CollectBindings(ScopeBindings &) const override;
+        void Propagate(const KnownValues &) override;
+
         void Emit(Executable &) const override;
 
     private:
@@ -387,6 +446,9 @@ class ForStatement : public LoopStatement
 
         unsigned StackUsage() const override;
 
+        void CollectBindings(ScopeBindings &) const override;
+        void Propagate(const KnownValues &) override;
+
         void Emit(Executable &) const override;
 
     private:
@@ -426,6 +488,13 @@ class Parameter : public NonTerminal
         {
             return defaultExpression != nullptr;
         }
+        const Expression *DefaultExpression() const
+        {
+            return defaultExpression;
+        }
+
+        void CollectBindings(ScopeBindings &) const;
+        void Propagate(const KnownValues &);
 
         void Emit(Executable &) const;
 
@@ -456,6 +525,9 @@ class ParameterList : public NonTerminal
             return parameters.end();
         }
 
+        void CollectBindings(ScopeBindings &) const;
+        void Propagate(const KnownValues &);
+
         void Emit(Executable &) const;
 
     private:
@@ -470,10 +542,24 @@ class DefStatement : public Statement
         DefStatement(const Token &nameToken, ParameterList *, Block *);
         ~DefStatement() override;
 
+        const std::string &Name() const
+        {
+            return name;
+        }
+
+        void CollectBindings(ScopeBindings &) const override;
+        void Propagate(const KnownValues &) override;
+        bool Inlinable(std::set<std::string> &freeNames) const;
+        Expression *Inline
+            (const SourceElement &, ArgumentList &,
+             const KnownValues &) const;
+
         void Emit(Executable &) const override;
 
     private:
 
+        const Expression *ReturnExpression() const;
+
         std::string name;
         ParameterList *parameterList;
         Block *block;
@@ -5,8 +5,9 @@
 #include "symbol.hpp"
 #include "symbols.h"
 #include "word.h"
+#include <algorithm>
 #include <sstream>
-#include <utility>
+#include <vector>
 
 using namespace std;
 
@@ -18,24 +19,35 @@ SymbolTable::SymbolTable(bool reserveSystemSymbols)
         Symbol(AspSystemModuleName);
         Symbol(AspSystemArgumentsName);
         Symbol(AspSystemMainModuleName);
+        ReserveDefinedSymbols();
     }
 }
 
 int32_t SymbolTable::Symbol(const string &name)
 {
-    // Return a unique symbol for the given name.
-    bool empty = symbolsByName.empty();
-    auto result = symbolsByName.insert(make_pair(name, nextNamedSymbol));
-    if (result.second)
+    // Return the existing symbol if there is one, avoiding a copy of the
+    // name in this common case.
+    auto iter = symbolsByName.find(name);
+    if (iter != symbolsByName.end())
     {
-        if (nextNamedSymbol == 0 && !empty)
-            throw string("Maximum number of name symbols exceeded");
-        if (nextNamedSymbol == AspSignedWordMax)
-            nextNamedSymbol = 0;
-        else
-            nextNamedSymbol++;
+        if (recording)
+            Record(name, iter->second);
+        return iter->second;
     }
-    return result.first->second;
+
+    // Otherwise, assign a unique symbol for the given name.
+    if (nextNamedSymbol == 0 && !symbolsByName.empty())
+        throw string("Maximum number of name symbols exceeded");
+    auto symbol = nextNamedSymbol;
+    symbolsByName.emplace(name, symbol);
+    sortedSymbolsValid = false;
+    if (recording)
+        Record(name, symbol);
+    if (nextNamedSymbol == AspSignedWordMax)
+        nextNamedSymbol = 0;
+    else
+        nextNamedSymbol++;
+    return symbol;
 }
 
 int32_t SymbolTable::Symbol(const string &name) const
@@ -68,12 +80,99 @@ bool SymbolTable::IsDefined(const string &name) const
     return symbolsByName.find(name) != symbolsByName.end();
 }
 
+void SymbolTable::ReserveDefinedSymbols()
+{
+    reservedSymbolCount = nextNamedSymbol;
+}
+
+bool SymbolTable::IsReserved(int32_t symbol) const
+{
+    return symbol >= 0 && symbol < reservedSymbolCount;
+}
+
+vector<int32_t> SymbolTable::Renumber(const vector<unsigned> &referenceCounts)
+{
+    // Order the unreserved named symbols by decreasing reference count,
+    // keeping the original order among symbols referenced equally often.
+    using Iterator = decltype(symbolsByName)::iterator;
+    vector<Iterator> entries;
+    for (auto iter = symbolsByName.begin();
+         iter != symbolsByName.end(); iter++)
+    {
+        if (iter->second >= reservedSymbolCount)
+            entries.push_back(iter);
+    }
+    auto count = [&](int32_t symbol)
+    {
+        return
+            static_cast<size_t>(symbol) < referenceCounts.size() ?
+            referenceCounts[symbol] : 0U;
+    };
+    sort
+        (entries.begin(), entries.end(),
+         [&](const Iterator &left, const Iterator &right)
+         {
+             auto leftCount = count(left->second);
+             auto rightCount = count(right->second);
+             return
+                 leftCount != rightCount ? leftCount > rightCount :
+                 left->second < right->second;
+         });
+
+    // Assign new values in that order.
+    vector<int32_t> renumbering(symbolsByName.size());
+    for (int32_t symbol = 0; symbol < reservedSymbolCount; symbol++)
+        renumbering[symbol] = symbol;
+    auto symbol = reservedSymbolCount;
+    for (auto &entry: entries)
+    {
+        renumbering[entry->second] = symbol;
+        entry->second = symbol++;
+    }
+    sortedSymbolsValid = false;
+    return renumbering;
+}
+
+void SymbolTable::StartRecording()
+{
+    recording = true;
+    currentRecording = Recording();
+    currentRecording.firstTemporarySymbol = nextUnnamedSymbol;
+    recordedSymbols.clear();
+}
+
+SymbolTable::Recording SymbolTable::StopRecording()
+{
+    recording = false;
+    currentRecording.temporarySymbolCount = static_cast<uint32_t>
+        (currentRecording.firstTemporarySymbol - nextUnnamedSymbol);
+    recordedSymbols.clear();
+    return move(currentRecording);
+}
+
+void SymbolTable::Record(const string &name, int32_t symbol)
+{
+    if (recordedSymbols.insert(symbol).second)
+        currentRecording.symbols.emplace_back(name, symbol);
+}
+
 SymbolTable::Map::const_iterator SymbolTable::Begin() const
 {
-    return symbolsByName.begin();
+    return SortedSymbols().begin();
 }
 
 SymbolTable::Map::const_iterator SymbolTable::End() const
 {
-    return symbolsByName.end();
+    return SortedSymbols().end();
+}
+
+const SymbolTable::Map &SymbolTable::SortedSymbols() const
+{
+    if (!sortedSymbolsValid)
+    {
+        sortedSymbolsByName.clear();
+        sortedSymbolsByName.insert(symbolsByName.begin(), symbolsByName.end());
+        sortedSymbolsValid = true;
+    }
+    return sortedSymbolsByName;
 }
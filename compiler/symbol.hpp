@@ -7,6 +7,10 @@
 
 #include <map>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 #include <cstdint>
 
 class SymbolTable
@@ -28,17 +32,51 @@ class SymbolTable
         // Symbol check method.
         bool IsDefined(const std::string &) const;
 
-        // Symbol iteration methods.
+        // Symbol renumbering methods. Symbols defined before the most recent
+        // reservation keep their values. The remaining named symbols are
+        // renumbered in decreasing order of the given reference counts,
+        // indexed by symbol, and the new value of each named symbol is
+        // returned, also indexed by its old value.
+        void ReserveDefinedSymbols();
+        bool IsReserved(std::int32_t) const;
+        std::vector<std::int32_t> Renumber
+            (const std::vector<unsigned> &referenceCounts);
+
+        // Symbol recording methods. While recording, each named symbol that
+        // is fetched is noted once, in order of first use, along with the
+        // range of temporary symbols issued. Starting discards any previous
+        // recording.
+        struct Recording
+        {
+            std::vector<std::pair<std::string, std::int32_t> > symbols;
+            std::int32_t firstTemporarySymbol = -1;
+            std::uint32_t temporarySymbolCount = 0;
+        };
+        void StartRecording();
+        Recording StopRecording();
+
+        // Symbol iteration methods, in order of name.
         using Map = std::map<std::string, std::int32_t>;
         Map::const_iterator Begin() const;
         Map::const_iterator End() const;
 
     private:
 
-        // Data.
-        Map symbolsByName;
+        // Internal methods.
+        void Record(const std::string &, std::int32_t);
+        const Map &SortedSymbols() const;
+
+        // Data. Lookups use the hashed table; the ordered one is built from
+        // it only when iterating.
+        std::unordered_map<std::string, std::int32_t> symbolsByName;
+        mutable Map sortedSymbolsByName;
+        mutable bool sortedSymbolsValid = true;
         std::int32_t nextNamedSymbol = 0;
         std::int32_t nextUnnamedSymbol = -1;
+        std::int32_t reservedSymbolCount = 0;
+        bool recording = false;
+        Recording currentRecording;
+        std::unordered_set<std::int32_t> recordedSymbols;
 };
 
 #endif
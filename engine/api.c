@@ -476,9 +476,17 @@ static AspDataEntry *ToString
 
             case DataType_Integer:
             {
+                /* Format directly into the resulting string. */
+                *buffer = '\0';
                 int32_t i;
                 AspIntegerValue(entry, &i);
-                snprintf(buffer, sizeof buffer, "%d", (int)i);
+                AspRunResult appendResult = AspStringAppendInteger
+                    (engine, result, i);
+                if (appendResult != AspRunResult_OK)
+                {
+                    AspUnref(engine, result);
+                    result = 0;
+                }
                 break;
             }
 
@@ -495,32 +503,53 @@ static AspDataEntry *ToString
 
             case DataType_Symbol:
             {
+                /* Format directly into the resulting string. */
+                *buffer = '\0';
                 int32_t symbol;
                 AspSymbolValue(entry, &symbol);
-                snprintf(buffer, sizeof buffer, "`%d", symbol);
+                AspRunResult appendResult = AspStringAppendBuffer
+                    (engine, result, "`", 1);
+                if (appendResult == AspRunResult_OK)
+                    appendResult = AspStringAppendInteger
+                        (engine, result, symbol);
+                if (appendResult != AspRunResult_OK)
+                {
+                    AspUnref(engine, result);
+                    result = 0;
+                }
                 break;
             }
 
             case DataType_Range:
             {
-                int count = 0;
+                /* Format directly into the resulting string. */
+                *buffer = '\0';
                 int32_t start, end, step;
                 bool bounded;
                 AspRangeValues(engine, entry, &start, &end, &step, &bounded);
+                AspRunResult appendResult = AspRunResult_OK;
                 if (start != (step < 0 ? -1 : 0))
-                    count += snprintf
-                        (buffer + count, sizeof buffer - count,
-                         "%d", start);
-                count += snprintf
-                    (buffer + count, sizeof buffer - count, "..");
-                if (bounded)
-                    count += snprintf
-                        (buffer + count, sizeof buffer - count,
-                         "%d", end);
-                if (step != 1)
-                    count += snprintf
-                        (buffer + count, sizeof buffer - count,
-                         ":%d", step);
+                    appendResult = AspStringAppendInteger
+                        (engine, result, start);
+                if (appendResult == AspRunResult_OK)
+                    appendResult = AspStringAppendBuffer
+                        (engine, result, "..", 2);
+                if (appendResult == AspRunResult_OK && bounded)
+                    appendResult = AspStringAppendInteger
+                        (engine, result, end);
+                if (appendResult == AspRunResult_OK && step != 1)
+                {
+                    appendResult = AspStringAppendBuffer
+                        (engine, result, ":", 1);
+                    if (appendResult == AspRunResult_OK)
+                        appendResult = AspStringAppendInteger
+                            (engine, result, step);
+                }
+                if (appendResult != AspRunResult_OK)
+                {
+                    AspUnref(engine, result);
+                    result = 0;
+                }
                 break;
             }
 
@@ -576,17 +605,26 @@ static AspDataEntry *ToString
                     {
                         /* Encode the string in canonical representation if
                            requested or if it is contained within another
-                           structure. */
-                        for (uint8_t i = 0; i < fragmentSize; i++)
+                           structure. Runs of printable characters are
+                           appended together. */
+                        uint8_t runStart = 0;
+                        for (uint8_t i = 0; i <= fragmentSize; i++)
                         {
                             AspRunResult appendResult = AspRunResult_OK;
-                            char c = fragmentData[i];
-                            if (isprint(c))
+                            char c = i < fragmentSize ? fragmentData[i] : 0;
+                            if (i < fragmentSize && isprint(c))
+                                continue;
+
+                            /* Flush the run of printable characters. */
+                            if (i > runStart)
                             {
                                 appendResult = AspStringAppendBuffer
-                                    (engine, result, &c, 1);
+                                    (engine, result,
+                                     fragmentData + runStart, i - runStart);
                             }
-                            else
+                            runStart = i + 1;
+                            if (appendResult == AspRunResult_OK &&
+                                i < fragmentSize)
                             {
                                 char encoded[5] = "\\";
                                 char code = 0;
@@ -1100,8 +1138,19 @@ AspDataEntry *AspIterable(AspEngine *engine, const AspDataEntry *iterator)
 {
     if (!AspIsIterator(iterator))
         return 0;
-    return AspValueEntry
+    AspDataEntry *iterable = AspValueEntry
         (engine, AspDataGetIteratorIterableIndex(iterator));
+    if (!AspDataGetIteratorIsAdapter(iterator))
+        return iterable;
+
+    /* An adapter's own iterable is internal to it. That of an enumerate
+       adapter is the iterator it wraps, whose iterable is the one given to
+       enumerate, unless the wrapped iterator is itself an adapter, in which
+       case it is the one given. A zip adapter has no single iterable. */
+    if (!AspIsIterator(iterable))
+        return 0;
+    return AspDataGetIteratorIsAdapter(iterable) ? iterable :
+        AspValueEntry(engine, AspDataGetIteratorIterableIndex(iterable));
 }
 
 bool AspAppObjectTypeValue
@@ -20,6 +20,8 @@ extern "C" {
 typedef struct AspEngine AspEngine;
 typedef union AspDataEntry AspDataEntry;
 typedef struct AspCodePageEntry AspCodePageEntry;
+typedef struct AspExpansion AspExpansion;
+typedef struct AspCodeExpander AspCodeExpander;
 typedef struct AspAppSpec AspAppSpec;
 
 #ifdef __cplusplus
@@ -38,8 +40,39 @@ typedef AspRunResult (AspDispatchFunction)
 
 struct AspCodePageEntry
 {
-    uint8_t index;
-    int8_t age;
+    uint32_t index, next;
+    bool used, referenced;
+};
+
+struct AspExpansion
+{
+    uint32_t literalCount, matchCount, matchDistance;
+    uint8_t stage;
+};
+
+struct AspCodeExpander
+{
+    /* Reader of the compressed executable and buffer for its blocks. */
+    AspCodeReader reader;
+    void *id;
+    uint8_t *buffer;
+    size_t bufferSize;
+
+    /* Compressed executable header, read with the first page. */
+    uint8_t header[12];
+    bool headerRead;
+    uint8_t blockSizeBits;
+    uint32_t expandedSize;
+
+    /* Progress through the page being read, which is resumed when the
+       reader returns AspRunResult_Again. */
+    bool reading;
+    uint32_t blockIndex, blockEndIndex;
+    uint8_t blockOffsets[8];
+    bool blockOffsetsRead;
+    uint32_t compressedIndex, compressedEndIndex;
+    size_t outputIndex;
+    AspExpansion expansion;
 };
 
 struct AspAppSpec
@@ -55,6 +88,7 @@ typedef enum AspEngineState
     AspEngineState_Reset,
     AspEngineState_LoadingHeader,
     AspEngineState_LoadingCode,
+    AspEngineState_ExpandingCode,
     AspEngineState_LoadError,
     AspEngineState_Ready,
     AspEngineState_Running,
@@ -84,14 +118,39 @@ struct AspEngine
     size_t maxCodeSize, codeEndIndex;
     uint32_t pc, instructionAddress;
 
-    /* Code paging data. */
-    uint8_t cachedCodePageCount, cachedCodePageIndex;
+    /* Compressed code loading state. The rest of the compressed header and
+       the block offsets are skipped, and the blocks are expanded in turn,
+       starting with the uncompressed header. Compressed code read by
+       AspLoadCode goes into the code area beyond the expanded code if there
+       is room, and into the load buffer otherwise. */
+    AspExpansion expansion;
+    uint8_t blockSizeBits;
+    uint32_t expandedSize, expandedIndex;
+    uint32_t compressedIndex, blockOffsetsEndIndex;
+    uint8_t loadBuffer[8];
+
+    /* Code paging data. Cached pages are found by way of a hash table whose
+       buckets chain together the entries of pages with the same hash, and
+       are replaced in clock order, sparing those referenced since the clock
+       hand last passed them. At most one page is read at a time; while the
+       reader has yet to complete it, its entry is the pending one. While an
+       instruction is being tried again, the retried page is the one that it
+       was waiting for, and the last step is noted as having waited. */
+    uint32_t cachedCodePageCount, cachedCodePageIndex;
+    uint32_t codePageBucketMask, codePageClockHand;
+    uint32_t pendingCodePage, retriedCodePage;
+    bool codeWaiting;
+    bool codePrefetching;
     bool codeEndKnown;
     size_t codePageSize;
     AspCodePageEntry *cachedCodePages;
+    uint32_t *codePageBuckets;
     AspCodeReader codeReader;
     void *pagedCodeId;
     size_t codePageReadCount;
+    AspCodePageStats codePageStats;
+    AspCodePageObserver codePageObserver;
+    void *codePageObserverId;
 
     /* Data space. */
     AspDataEntry *data;
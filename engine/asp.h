@@ -21,7 +21,8 @@
 extern "C" {
 #endif
 
-/* Result returned from AspAddCode, AspSeal, AspSealCode, and AspPageCode. */
+/* Result returned from AspAddCode, AspLoadCode, AspSeal, AspSealCode, and
+   AspPageCode. */
 typedef enum
 {
     AspAddCodeResult_OK = 0x00,
@@ -29,7 +30,9 @@ typedef enum
     AspAddCodeResult_InvalidVersion = 0x02,
     AspAddCodeResult_InvalidCheckValue = 0x03,
     AspAddCodeResult_OutOfCodeMemory = 0x04,
+    AspAddCodeResult_ReadError = 0x05,
     AspAddCodeResult_InvalidState = 0x08,
+    AspAddCodeResult_Again = 0xFA,
 } AspAddCodeResult;
 
 /* Result returned from AspInitialize, AspReset, and AspStep, among others. */
@@ -76,6 +79,25 @@ typedef double (*AspFloatConverter)(uint8_t ieee754_binary64[8]);
 typedef AspRunResult (*AspCodeReader)
     (void *id, uint32_t offset, size_t *size, void *codePage);
 
+/* Code page cache statistics. */
+typedef struct
+{
+    size_t hitCount, missCount, prefetchCount, evictionCount;
+} AspCodePageStats;
+
+/* Code page cache events and observer type. Pages are numbered by their
+   offset within the executable divided by the page size. The address is that
+   of the instruction being executed when the event occurred. */
+typedef enum
+{
+    AspCodePageEvent_Hit,
+    AspCodePageEvent_Miss,
+    AspCodePageEvent_Prefetch,
+    AspCodePageEvent_Eviction,
+} AspCodePageEvent;
+typedef void (*AspCodePageObserver)
+    (void *id, AspCodePageEvent, uint32_t page, uint32_t address);
+
 #ifdef __cplusplus
 }
 #endif
@@ -97,16 +119,29 @@ ASP_API AspRunResult AspInitializeEx
     (AspEngine *, void *code, size_t codeSize, void *data, size_t dataSize,
      const AspAppSpec *, void *context, AspFloatConverter);
 ASP_API AspRunResult AspSetCodePaging
-    (AspEngine *, uint8_t pageCount, size_t pageSize, AspCodeReader);
+    (AspEngine *, uint32_t pageCount, size_t pageSize, AspCodeReader);
+ASP_API AspRunResult AspSetCodePrefetching(AspEngine *, bool);
+ASP_API AspRunResult AspSetCodePageObserver
+    (AspEngine *, AspCodePageObserver, void *id);
 ASP_API void AspCodeVersion(const AspEngine *, uint8_t version[4]);
 ASP_API size_t AspMaxCodeSize(const AspEngine *);
 ASP_API size_t AspMaxDataSize(const AspEngine *);
 ASP_API AspAddCodeResult AspAddCode
     (AspEngine *, const void *code, size_t codeSize);
+ASP_API AspAddCodeResult AspLoadCode
+    (AspEngine *, AspCodeReader, void *id);
 ASP_API AspAddCodeResult AspSeal(AspEngine *);
 ASP_API AspAddCodeResult AspSealCode
     (AspEngine *, const void *code, size_t codeSize);
 ASP_API AspAddCodeResult AspPageCode(AspEngine *, void *id);
+ASP_API AspRunResult AspInitializeCodeExpander
+    (AspCodeExpander *, AspCodeReader, void *id,
+     void *buffer, size_t bufferSize);
+ASP_API AspRunResult AspExpandCodePage
+    (void *id, uint32_t offset, size_t *size, void *codePage);
+ASP_API AspAddCodeResult AspCompressedCodeSizes
+    (const void *header, size_t headerSize,
+     size_t *codeSize, size_t *blockSize);
 ASP_API AspRunResult AspReset(AspEngine *);
 ASP_API AspRunResult AspSetArguments(AspEngine *, const char * const *);
 ASP_API AspRunResult AspSetArgumentsString(AspEngine *, const char *);
@@ -119,9 +154,12 @@ ASP_API AspRunResult AspStep(AspEngine *);
 ASP_API bool AspIsReady(const AspEngine *);
 ASP_API bool AspIsRunning(const AspEngine *);
 ASP_API bool AspIsRunnable(const AspEngine *);
+ASP_API bool AspIsWaitingForCode(const AspEngine *);
 ASP_API size_t AspProgramCounter(const AspEngine *);
 ASP_API size_t AspLowFreeCount(const AspEngine *);
 ASP_API size_t AspCodePageReadCount(AspEngine *, bool reset);
+ASP_API void AspCodePageStatistics
+    (AspEngine *, AspCodePageStats *, bool reset);
 #ifdef ASP_DEBUG
 ASP_API uint32_t AspDataAddress(const AspEngine *, const AspDataEntry *);
 ASP_API uint32_t AspUseCount(const AspDataEntry *);
@@ -5,7 +5,21 @@
 #include "code.h"
 #include <stdint.h>
 
-static void UpdateAges(AspEngine *);
+/* Number of bytes in the longest instruction other than those that load
+   strings, i.e., an op code followed by up to eight bytes of operands. */
+static const uint32_t MaxFixedInstructionSize = 9;
+
+static const uint32_t NoCodePage = UINT32_MAX;
+
+static bool InCurrentCodePage(const AspEngine *, uint32_t offset);
+static AspRunResult EnsureCodePage
+    (AspEngine *, uint32_t codePageIndex, bool prefetch,
+     uint32_t *entryIndex);
+static AspRunResult ReadCodePage(AspEngine *, uint32_t entryIndex);
+static void DropCodePage(AspEngine *, uint32_t entryIndex);
+static void PrefetchCodePage(AspEngine *, uint32_t codePageIndex);
+static void NoteCodePageEvent
+    (AspEngine *, AspCodePageEvent, uint32_t codePageIndex);
 
 AspRunResult AspLoadCodeBytes
     (AspEngine *engine, uint8_t *bytes, size_t count)
@@ -20,13 +34,81 @@ AspRunResult AspLoadCodeBytes
         return AspRunResult_OK;
     }
 
-    /* Handle paged code. */
+    /* Handle paged code. At the start of an instruction, before anything has
+       been done that would need undoing, ensure the page holding it is
+       present and, if all but the longest instructions could extend into
+       the one after it, that one too. While any of them is still being
+       read, give up on the instruction for now so that it is executed again
+       on the next step. The page after the current one is only looked ahead
+       to, so it is treated as a prefetch, being counted as a hit only if and
+       when code is actually loaded from it. */
     uint32_t offset = engine->headerIndex + engine->pc;
+    if (engine->pc == engine->instructionAddress)
+    {
+        bool switched = false;
+        if (!InCurrentCodePage(engine, offset))
+        {
+            AspRunResult loadResult = AspLoadCodePage(engine, offset);
+            if (loadResult != AspRunResult_OK)
+                return loadResult;
+            switched = true;
+        }
+
+        uint32_t codePageIndex = offset / (uint32_t)engine->codePageSize;
+        uint32_t lastOffset = offset + MaxFixedInstructionSize - 1;
+        uint32_t entryIndex;
+        if (engine->cachedCodePageCount > 1 &&
+            !InCurrentCodePage(engine, lastOffset) &&
+            (!engine->codeEndKnown ||
+             (codePageIndex + 1) * (uint32_t)engine->codePageSize <
+             engine->headerIndex + engine->codeEndIndex))
+        {
+            AspRunResult loadResult = EnsureCodePage
+                (engine, codePageIndex + 1, true, &entryIndex);
+            if (loadResult != AspRunResult_OK)
+                return loadResult;
+        }
+        else if (switched)
+            PrefetchCodePage(engine, codePageIndex + 1);
+    }
+
+    /* Load the bytes. Only longer instructions (i.e., those that load
+       strings) reach a page that has yet to be read. If the cache can hold
+       all the pages the instruction spans so far, start reading the page and
+       return AspRunResult_Again with the program counter back at the start of
+       the instruction, for the caller to undo anything it has done and to
+       try the instruction again on the next step. While it is being tried
+       again, the pages it spans are spared from replacement, and returning
+       to them counts as no further reference to them. Otherwise, wait for
+       the page. */
     while (count--)
     {
-        AspRunResult checkResult = AspValidateCodeAddress(engine, engine->pc);
-        if (checkResult != AspRunResult_OK)
-            return checkResult;
+        if (!InCurrentCodePage(engine, offset))
+        {
+            uint32_t codePageIndex = offset / (uint32_t)engine->codePageSize;
+            uint32_t instructionCodePageIndex =
+                (engine->headerIndex + engine->instructionAddress) /
+                (uint32_t)engine->codePageSize;
+            bool retry =
+                codePageIndex - instructionCodePageIndex <
+                engine->cachedCodePageCount;
+            AspRunResult loadResult = AspLoadCodePage(engine, offset);
+            if (loadResult == AspRunResult_Again && retry)
+            {
+                engine->retriedCodePage = codePageIndex;
+                engine->pc = engine->instructionAddress;
+                return loadResult;
+            }
+            while (loadResult == AspRunResult_Again)
+                loadResult = AspLoadCodePage(engine, offset);
+            if (loadResult != AspRunResult_OK)
+                return loadResult;
+            if (engine->retriedCodePage != NoCodePage &&
+                codePageIndex >= engine->retriedCodePage)
+                engine->retriedCodePage = NoCodePage;
+        }
+        if (engine->codeEndKnown && engine->pc >= engine->codeEndIndex)
+            return AspRunResult_BeyondEndOfCode;
 
         const uint8_t *page =
             engine->codeArea +
@@ -48,18 +130,22 @@ AspRunResult AspValidateCodeAddress(AspEngine *engine, uint32_t address)
     }
     else
     {
-        /* Load the applicable code page. */
+        /* Load the applicable code page, or when prefetching, just begin
+           reading it. Either way, the page need not be present until code is
+           actually loaded from it. */
         uint32_t offset = engine->headerIndex + address;
-        const AspCodePageEntry *entry =
-            engine->cachedCodePages + engine->cachedCodePageIndex;
-        uint32_t codePageOffset =
-            entry->index * (uint32_t)engine->codePageSize;
-        if (offset < codePageOffset ||
-            offset >= codePageOffset + engine->codePageSize)
+        if (!InCurrentCodePage(engine, offset))
         {
-            AspRunResult loadResult = AspLoadCodePage(engine, offset);
-            if (loadResult != AspRunResult_OK)
-                return loadResult;
+            if (engine->codePrefetching)
+                PrefetchCodePage
+                    (engine, offset / (uint32_t)engine->codePageSize);
+            else
+            {
+                AspRunResult loadResult = AspLoadCodePage(engine, offset);
+                if (loadResult != AspRunResult_OK &&
+                    loadResult != AspRunResult_Again)
+                    return loadResult;
+            }
         }
 
         /* Ensure the program counter is in bounds if possible (i.e., if the
@@ -73,62 +159,142 @@ AspRunResult AspValidateCodeAddress(AspEngine *engine, uint32_t address)
 
 AspRunResult AspLoadCodePage(AspEngine *engine, uint32_t offset)
 {
-    /* Determine which page to load. */
-    uint8_t codePageIndex = (uint8_t)(offset / (uint32_t)engine->codePageSize);
+    /* Ensure the page is present and make it the current one. */
+    uint32_t entryIndex;
+    AspRunResult loadResult = EnsureCodePage
+        (engine, offset / (uint32_t)engine->codePageSize, false,
+         &entryIndex);
+    if (loadResult != AspRunResult_OK)
+        return loadResult;
+    engine->cachedCodePages[entryIndex].referenced = true;
+    engine->cachedCodePageIndex = entryIndex;
+    return AspRunResult_OK;
+}
 
-    /* Determine whether the page is already cached. */
-    for (uint8_t i = 0; i < engine->cachedCodePageCount; i++)
+static bool InCurrentCodePage(const AspEngine *engine, uint32_t offset)
+{
+    const AspCodePageEntry *entry =
+        engine->cachedCodePages + engine->cachedCodePageIndex;
+    uint32_t codePageOffset = entry->index * (uint32_t)engine->codePageSize;
+    return
+        entry->used &&
+        engine->cachedCodePageIndex != engine->pendingCodePage &&
+        offset >= codePageOffset &&
+        offset < codePageOffset + engine->codePageSize;
+}
+
+static AspRunResult EnsureCodePage
+    (AspEngine *engine, uint32_t codePageIndex, bool prefetch,
+     uint32_t *entryIndex)
+{
+    /* Only one page is read at a time, so finish any read in progress,
+       discarding the page if the read failed. */
+    if (engine->pendingCodePage != NoCodePage)
     {
-        const AspCodePageEntry *entry = engine->cachedCodePages + i;
+        uint32_t pendingCodePage = engine->pendingCodePage;
+        AspRunResult readResult = ReadCodePage(engine, pendingCodePage);
+        if (readResult == AspRunResult_Again)
+            return readResult;
+        if (readResult != AspRunResult_OK)
+            DropCodePage(engine, pendingCodePage);
+    }
 
-        uint32_t codePageOffset =
-            entry->index * (uint32_t)engine->codePageSize;
-        if (entry->age >= 0 &&
-            offset >= codePageOffset &&
-            offset < codePageOffset + engine->codePageSize)
+    /* Determine whether the page is already cached. */
+    uint32_t *bucket =
+        engine->codePageBuckets + (codePageIndex & engine->codePageBucketMask);
+    for (uint32_t i = *bucket; i != NoCodePage;
+         i = engine->cachedCodePages[i].next)
+    {
+        if (engine->cachedCodePages[i].index == codePageIndex)
         {
-            if (engine->cachedCodePageIndex != i)
-            {
-                engine->cachedCodePageIndex = i;
-                UpdateAges(engine);
-            }
+            if (!prefetch &&
+                (engine->retriedCodePage == NoCodePage ||
+                 codePageIndex > engine->retriedCodePage))
+                NoteCodePageEvent(engine, AspCodePageEvent_Hit, codePageIndex);
+            *entryIndex = i;
             return AspRunResult_OK;
         }
     }
 
-    /* Find the least recently used cache page. */
-    int8_t oldestAge = 0;
-    for (uint8_t i = 0; i < engine->cachedCodePageCount; i++)
+    /* Advance the clock hand to the first unused entry or to the first one
+       not referenced since the hand last passed it, giving those that were
+       a second chance. The current page is spared, except when it is the
+       only one. So are the earlier pages of an instruction that spans pages,
+       provided that leaves a page to replace. */
+    uint32_t instructionCodePageIndex =
+        (engine->headerIndex + engine->instructionAddress) /
+        (uint32_t)engine->codePageSize;
+    bool spareInstruction = false;
+    if (codePageIndex > instructionCodePageIndex)
     {
-        const AspCodePageEntry *entry = engine->cachedCodePages + i;
-
-        /* Check for a previously unused entry. */
-        if (entry->age < 0)
-        {
-            engine->cachedCodePageIndex = i;
+        const AspCodePageEntry *currentEntry =
+            engine->cachedCodePages + engine->cachedCodePageIndex;
+        uint32_t sparedCount = codePageIndex - instructionCodePageIndex;
+        if (!currentEntry->used ||
+            currentEntry->index < instructionCodePageIndex ||
+            currentEntry->index >= codePageIndex)
+            sparedCount++;
+        spareInstruction = sparedCount < engine->cachedCodePageCount;
+    }
+    AspCodePageEntry *entry;
+    while (true)
+    {
+        entry = engine->cachedCodePages + engine->codePageClockHand;
+        bool spared =
+            (engine->codePageClockHand == engine->cachedCodePageIndex &&
+             engine->cachedCodePageCount != 1) ||
+            (spareInstruction &&
+             entry->index >= instructionCodePageIndex &&
+             entry->index < codePageIndex);
+        if (!entry->used || (!entry->referenced && !spared))
             break;
-        }
+        entry->referenced = false;
+        if (++engine->codePageClockHand == engine->cachedCodePageCount)
+            engine->codePageClockHand = 0;
+    }
+    *entryIndex = engine->codePageClockHand;
+    if (++engine->codePageClockHand == engine->cachedCodePageCount)
+        engine->codePageClockHand = 0;
 
-        if (i == 0 || entry->age > oldestAge)
-        {
-            oldestAge = entry->age;
-            engine->cachedCodePageIndex = i;
-        }
+    /* Unlink the replaced page from its hash chain and link in the new
+       one. */
+    if (entry->used)
+    {
+        NoteCodePageEvent(engine, AspCodePageEvent_Eviction, entry->index);
+        DropCodePage(engine, *entryIndex);
     }
-    engine->cachedCodePages[engine->cachedCodePageIndex].index = codePageIndex;
-    UpdateAges(engine);
+    entry->index = codePageIndex;
+    entry->next = *bucket;
+    entry->used = true;
+    entry->referenced = false;
+    *bucket = *entryIndex;
 
-    /* Read the page from offline storage into the least recently used cache
-       page. */
-    uint32_t codePageOffset =
-        codePageIndex * (uint32_t)engine->codePageSize;
-    size_t pageSize = engine->codePageSize;
+    /* Read the page from offline storage into the chosen cache page. */
     if (engine->codePageReadCount < SIZE_MAX)
         engine->codePageReadCount++;
+    NoteCodePageEvent
+        (engine,
+         prefetch ? AspCodePageEvent_Prefetch : AspCodePageEvent_Miss,
+         codePageIndex);
+    AspRunResult readResult = ReadCodePage(engine, *entryIndex);
+    if (readResult != AspRunResult_OK && readResult != AspRunResult_Again)
+        DropCodePage(engine, *entryIndex);
+    return readResult;
+}
+
+static AspRunResult ReadCodePage(AspEngine *engine, uint32_t entryIndex)
+{
+    /* Read the page, or poll a read in progress, which the reader indicates
+       by returning AspRunResult_Again. */
+    const AspCodePageEntry *entry = engine->cachedCodePages + entryIndex;
+    uint32_t codePageOffset =
+        entry->index * (uint32_t)engine->codePageSize;
+    size_t pageSize = engine->codePageSize;
     AspRunResult readResult = engine->codeReader
         (engine->pagedCodeId, codePageOffset, &pageSize,
-         engine->codeArea +
-         engine->cachedCodePageIndex * engine->codePageSize);
+         engine->codeArea + entryIndex * engine->codePageSize);
+    engine->pendingCodePage =
+        readResult == AspRunResult_Again ? entryIndex : NoCodePage;
     if (readResult != AspRunResult_OK)
         return readResult;
     if (codePageOffset == 0 && pageSize < engine->headerIndex)
@@ -148,15 +314,47 @@ AspRunResult AspLoadCodePage(AspEngine *engine, uint32_t offset)
     return AspRunResult_OK;
 }
 
-static void UpdateAges(AspEngine *engine)
+static void DropCodePage(AspEngine *engine, uint32_t entryIndex)
 {
-    for (unsigned i = 0; i < engine->cachedCodePageCount; i++)
-    {
-        AspCodePageEntry *entry = engine->cachedCodePages + i;
+    AspCodePageEntry *entry = engine->cachedCodePages + entryIndex;
+    uint32_t *link = engine->codePageBuckets +
+        (entry->index & engine->codePageBucketMask);
+    while (*link != entryIndex)
+        link = &engine->cachedCodePages[*link].next;
+    *link = entry->next;
+    entry->next = NoCodePage;
+    entry->used = entry->referenced = false;
+}
 
-        if (i == engine->cachedCodePageIndex)
-            entry->age = 0;
-        else if (entry->age >= 0)
-            entry->age++;
-    }
+static void PrefetchCodePage(AspEngine *engine, uint32_t codePageIndex)
+{
+    /* Begin reading the page if it lies within the code and no other read is
+       in progress. Any error is left to be reported if and when code is
+       actually loaded from the page. */
+    if (!engine->codePrefetching || engine->cachedCodePageCount < 2 ||
+        engine->pendingCodePage != NoCodePage ||
+        (engine->codeEndKnown &&
+         codePageIndex * (uint32_t)engine->codePageSize >=
+         engine->headerIndex + engine->codeEndIndex))
+        return;
+    uint32_t entryIndex;
+    EnsureCodePage(engine, codePageIndex, true, &entryIndex);
+}
+
+static void NoteCodePageEvent
+    (AspEngine *engine, AspCodePageEvent event, uint32_t codePageIndex)
+{
+    size_t *count =
+        event == AspCodePageEvent_Hit ? &engine->codePageStats.hitCount :
+        event == AspCodePageEvent_Miss ? &engine->codePageStats.missCount :
+        event == AspCodePageEvent_Prefetch ?
+        &engine->codePageStats.prefetchCount :
+        &engine->codePageStats.evictionCount;
+    if (*count < SIZE_MAX)
+        (*count)++;
+
+    if (engine->codePageObserver != 0)
+        engine->codePageObserver
+            (engine->codePageObserverId, event, codePageIndex,
+             engine->instructionAddress);
 }
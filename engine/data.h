@@ -259,6 +259,14 @@ int32_t AspDataGetSignedWord3(const AspDataEntry *);
     (AspDataSetWord3((eptr), (value)))
 #define AspDataGetIteratorCollectionIndex(eptr) \
     (AspDataGetWord3((eptr)))
+#define AspDataSetIteratorIsAdapter(eptr, value) \
+    (AspDataSetBit1((eptr), (unsigned)(value)))
+#define AspDataGetIteratorIsAdapter(eptr) \
+    ((bool)(AspDataGetBit1((eptr))))
+#define AspDataSetIteratorAdapterDepth(eptr, value) \
+    ((eptr)->s.s[11] = (value))
+#define AspDataGetIteratorAdapterDepth(eptr) \
+    ((eptr)->s.s[11])
 
 /* Function entry field access. */
 #define AspDataSetFunctionIsApp(eptr, value) \
@@ -4,6 +4,7 @@
 
 #include "asp-priv.h"
 #include "code.h"
+#include "expand.h"
 #include "data.h"
 #include "sequence.h"
 #include "tree.h"
@@ -20,6 +21,9 @@
 #error ASP_ENGINE_VERSION_* macros undefined
 #endif
 
+static AspAddCodeResult ProcessHeader(AspEngine *);
+static AspAddCodeResult ExpandCode
+    (AspEngine *, const uint8_t *code, size_t codeSize);
 static void ProcessCodeHeader(AspEngine *);
 static AspRunResult ResetData(AspEngine *);
 static AspRunResult InitializeAppDefinitions(AspEngine *);
@@ -63,7 +67,11 @@ AspRunResult AspInitializeEx
     engine->cachedCodePageCount = 0;
     engine->codePageSize = 0;
     engine->cachedCodePages = 0;
+    engine->codePageBuckets = 0;
+    engine->codePrefetching = false;
     engine->codeReader = 0;
+    engine->codePageObserver = 0;
+    engine->codePageObserverId = 0;
     engine->data = data;
     engine->maxDataSize = dataSize;
     engine->dataEndIndex = dataSize / AspDataEntrySize();
@@ -79,7 +87,7 @@ AspRunResult AspInitializeEx
 }
 
 AspRunResult AspSetCodePaging
-    (AspEngine *engine, uint8_t pageCount, size_t pageSize,
+    (AspEngine *engine, uint32_t pageCount, size_t pageSize,
      AspCodeReader reader)
 {
     if (engine->inApp || engine->state != AspEngineState_Reset)
@@ -94,24 +102,58 @@ AspRunResult AspSetCodePaging
 
     if (pageSize == 0)
         pageCount = 0;
-    size_t requiredSize = pageCount * pageSize;
-    if (requiredSize > engine->maxCodeSize)
+    if (pageCount != 0 && pageCount > engine->maxCodeSize / pageSize)
         return AspRunResult_InitializationError;
-    size_t pageEntriesSize = pageCount * sizeof(AspCodePageEntry);
-    if (pageEntriesSize >= engine->maxDataSize)
+
+    /* Size the hash table to the smallest power of two that accommodates
+       all the pages. */
+    size_t bucketCount = pageCount == 0 ? 0 : 1;
+    while (bucketCount < pageCount)
+        bucketCount <<= 1;
+
+    /* Place the page entries and hash buckets at the end of the data
+       area. */
+    size_t pageTableSize =
+        pageCount * sizeof(AspCodePageEntry) +
+        bucketCount * sizeof(uint32_t);
+    if (pageTableSize >= engine->maxDataSize)
         return AspRunResult_OutOfDataMemory;
+    size_t pageTableIndex =
+        (engine->maxDataSize - pageTableSize) & ~(sizeof(uint32_t) - 1);
 
-    engine->dataEndIndex =
-        (engine->maxDataSize - pageEntriesSize) / AspDataEntrySize();
+    engine->dataEndIndex = pageTableIndex / AspDataEntrySize();
     engine->cachedCodePageCount = pageCount;
+    engine->codePageBucketMask = (uint32_t)(bucketCount - 1);
     engine->codePageSize = pageSize;
     engine->codeReader = reader;
     engine->cachedCodePages = (AspCodePageEntry *)(pageCount == 0 ? 0 :
-        (uint8_t *)engine->data + engine->maxDataSize - pageEntriesSize);
+        (uint8_t *)engine->data + pageTableIndex);
+    engine->codePageBuckets = pageCount == 0 ? 0 :
+        (uint32_t *)(engine->cachedCodePages + pageCount);
 
     return AspReset(engine);
 }
 
+AspRunResult AspSetCodePrefetching(AspEngine *engine, bool enable)
+{
+    if (engine->inApp)
+        return AspRunResult_InvalidState;
+
+    engine->codePrefetching = enable;
+    return AspRunResult_OK;
+}
+
+AspRunResult AspSetCodePageObserver
+    (AspEngine *engine, AspCodePageObserver observer, void *id)
+{
+    if (engine->inApp)
+        return AspRunResult_InvalidState;
+
+    engine->codePageObserver = observer;
+    engine->codePageObserverId = id;
+    return AspRunResult_OK;
+}
+
 void AspCodeVersion
     (const AspEngine *engine, uint8_t version[sizeof engine->version])
 {
@@ -139,46 +181,42 @@ AspAddCodeResult AspAddCode
         engine->headerIndex = 0;
     }
     else if (engine->state != AspEngineState_LoadingHeader &&
-             engine->state != AspEngineState_LoadingCode ||
+             engine->state != AspEngineState_LoadingCode &&
+             engine->state != AspEngineState_ExpandingCode ||
              engine->code == 0)
         return AspAddCodeResult_InvalidState;
 
     const uint8_t *codePtr = (const uint8_t *)code;
     if (engine->state == AspEngineState_LoadingHeader)
     {
-        while (engine->headerIndex < HeaderSize && codeSize > 0)
-        {
-            engine->code[engine->headerIndex++] = *codePtr++;
-            codeSize--;
-
-            if (engine->headerIndex == HeaderSize)
-            {
-                /* Ensure the header is valid. */
-                ProcessCodeHeader(engine);
-                if (engine->loadResult != AspAddCodeResult_OK)
-                    return engine->loadResult;
-
-                engine->state = AspEngineState_LoadingCode;
-                break;
-            }
-        }
-
-        if (engine->state == AspEngineState_LoadingHeader ||
-            engine->state == AspEngineState_LoadError)
+        size_t headerByteCount = HeaderSize - engine->headerIndex;
+        if (headerByteCount > codeSize)
+            headerByteCount = codeSize;
+        memcpy(engine->code + engine->headerIndex, codePtr, headerByteCount);
+        engine->headerIndex += (uint8_t)headerByteCount;
+        codePtr += headerByteCount;
+        codeSize -= headerByteCount;
+
+        /* Process the header once it is complete. */
+        if (engine->headerIndex < HeaderSize)
+            return engine->loadResult;
+        if (ProcessHeader(engine) != AspAddCodeResult_OK)
             return engine->loadResult;
     }
 
+    if (engine->state == AspEngineState_ExpandingCode)
+        return ExpandCode(engine, codePtr, codeSize);
     if (engine->state != AspEngineState_LoadingCode)
     {
         engine->state = AspEngineState_LoadError;
-        engine->loadResult = AspAddCodeResult_InvalidState;
+        return engine->loadResult = AspAddCodeResult_InvalidState;
     }
 
     /* Ensure there's enough room to copy the code. */
     if (engine->codeEndIndex + codeSize > engine->maxCodeSize)
     {
         engine->state = AspEngineState_LoadError;
-        engine->loadResult = AspAddCodeResult_OutOfCodeMemory;
+        return engine->loadResult = AspAddCodeResult_OutOfCodeMemory;
     }
 
     memcpy(engine->code + engine->codeEndIndex, codePtr, codeSize);
@@ -187,8 +225,107 @@ AspAddCodeResult AspAddCode
     return engine->loadResult;
 }
 
+AspAddCodeResult AspLoadCode
+    (AspEngine *engine, AspCodeReader reader, void *id)
+{
+    if (engine->state == AspEngineState_LoadError)
+        return engine->loadResult;
+    else if (engine->state == AspEngineState_Reset)
+    {
+        engine->state = AspEngineState_LoadingHeader;
+        engine->headerIndex = 0;
+    }
+    else if (engine->state != AspEngineState_LoadingHeader &&
+             engine->state != AspEngineState_LoadingCode &&
+             engine->state != AspEngineState_ExpandingCode ||
+             engine->code == 0 || reader == 0)
+        return AspAddCodeResult_InvalidState;
+
+    /* Read the code sequentially straight into the code area, asking for as
+       much as there is room for. The reader may supply less than asked for,
+       indicating the end of the code only by supplying nothing. If it returns
+       AspRunResult_Again, loading resumes where it left off on the next
+       call. */
+    while (true)
+    {
+        uint32_t offset;
+        uint8_t *buffer;
+        size_t size;
+        if (engine->state == AspEngineState_LoadingHeader)
+        {
+            offset = engine->headerIndex;
+            buffer = engine->code + engine->headerIndex;
+            size = (size_t)(HeaderSize - engine->headerIndex);
+        }
+        else if (engine->state == AspEngineState_LoadingCode)
+        {
+            offset = (uint32_t)(HeaderSize + engine->codeEndIndex);
+            buffer = engine->code + engine->codeEndIndex;
+            size = engine->maxCodeSize - engine->codeEndIndex;
+        }
+        else
+        {
+            /* Read compressed code into whatever room remains beyond the
+               expanded code, including its header. */
+            size_t expandedEndIndex = engine->expandedSize - HeaderSize;
+            if (expandedEndIndex < HeaderSize)
+                expandedEndIndex = HeaderSize;
+            offset = engine->compressedIndex;
+            buffer = engine->code + expandedEndIndex;
+            size = engine->maxCodeSize > expandedEndIndex ?
+                engine->maxCodeSize - expandedEndIndex : 0;
+        }
+
+        /* Use the load buffer instead when there's little room for
+           compressed code, and when the code area is full, to check for
+           more code. */
+        bool expanding = engine->state == AspEngineState_ExpandingCode;
+        if (expanding ? size < sizeof engine->loadBuffer : size == 0)
+        {
+            buffer = engine->loadBuffer;
+            size = expanding ? sizeof engine->loadBuffer : 1;
+        }
+
+        AspRunResult readResult = reader(id, offset, &size, buffer);
+        if (readResult == AspRunResult_Again)
+            return AspAddCodeResult_Again;
+        if (readResult != AspRunResult_OK)
+        {
+            engine->state = AspEngineState_LoadError;
+            return engine->loadResult = AspAddCodeResult_ReadError;
+        }
+
+        if (size == 0)
+            return AspSeal(engine);
+        if (engine->state == AspEngineState_LoadingHeader)
+        {
+            engine->headerIndex += (uint8_t)size;
+            if (engine->headerIndex == HeaderSize &&
+                ProcessHeader(engine) != AspAddCodeResult_OK)
+                return engine->loadResult;
+        }
+        else if (expanding)
+        {
+            if (ExpandCode(engine, buffer, size) != AspAddCodeResult_OK)
+                return engine->loadResult;
+        }
+        else if (buffer == engine->loadBuffer)
+        {
+            engine->state = AspEngineState_LoadError;
+            return engine->loadResult = AspAddCodeResult_OutOfCodeMemory;
+        }
+        else
+            engine->codeEndIndex += size;
+    }
+}
+
 AspAddCodeResult AspSeal(AspEngine *engine)
 {
+    /* Ensure compressed code was expanded in its entirety. */
+    if (engine->state == AspEngineState_ExpandingCode &&
+        engine->expandedIndex == engine->expandedSize)
+        engine->state = AspEngineState_LoadingCode;
+
     /* Ensure we got past loading the header. */
     if (engine->state != AspEngineState_LoadingCode)
     {
@@ -238,10 +375,19 @@ AspAddCodeResult AspPageCode(AspEngine *engine, void *id)
         return AspAddCodeResult_InvalidState;
 
     /* Load the first page, which contains the header, and then ensure the
-       header is valid. */
+       header is valid. If the reader returns AspRunResult_Again, so does
+       this function, and reading resumes on the next call, which must pass
+       the same id. The same holds for code pages read while running: an
+       instruction whose code has yet to be read is tried again on the next
+       call to AspStep, which returns AspRunResult_OK meanwhile. The reader is
+       never polled in a loop, except when an instruction spans more pages
+       than the cache holds, in which case it is polled until the page it
+       waits for is read. */
     engine->pagedCodeId = id;
     engine->headerIndex = HeaderSize;
     AspRunResult pageResult = AspLoadCodePage(engine, 0);
+    if (pageResult == AspRunResult_Again)
+        return AspAddCodeResult_Again;
     if (pageResult != AspRunResult_OK)
         return AspAddCodeResult_InvalidFormat;
     engine->code = engine->codeArea;
@@ -271,17 +417,24 @@ AspRunResult AspReset(AspEngine *engine)
     engine->codeEndIndex = 0;
     engine->pc = engine->instructionAddress = 0;
     engine->cachedCodePageIndex = 0;
+    engine->codePageClockHand = 0;
+    engine->pendingCodePage = engine->retriedCodePage = UINT32_MAX;
+    engine->codeWaiting = false;
     engine->codeEndKnown = false;
     engine->pagedCodeId = 0;
     engine->codePageReadCount = 0;
+    memset(&engine->codePageStats, 0, sizeof engine->codePageStats);
     if (engine->cachedCodePages != 0)
     {
         for (size_t i = 0; i < engine->cachedCodePageCount; i++)
         {
             AspCodePageEntry *entry = engine->cachedCodePages + i;
             entry->index = 0;
-            entry->age = -1;
+            entry->next = UINT32_MAX;
+            entry->used = entry->referenced = false;
         }
+        for (size_t i = 0; i <= engine->codePageBucketMask; i++)
+            engine->codePageBuckets[i] = UINT32_MAX;
     }
     engine->again = false;
     engine->callFromApp = false;
@@ -320,6 +473,8 @@ AspRunResult AspRestart(AspEngine *engine)
     engine->state = AspEngineState_Ready;
     engine->runResult = AspRunResult_OK;
     engine->pc = engine->instructionAddress = 0;
+    engine->retriedCodePage = UINT32_MAX;
+    engine->codeWaiting = false;
     engine->codePageReadCount = 0;
     engine->again = false;
     engine->callFromApp = false;
@@ -333,6 +488,134 @@ AspRunResult AspRestart(AspEngine *engine)
     return ResetData(engine);
 }
 
+static AspAddCodeResult ProcessHeader(AspEngine *engine)
+{
+    /* Prepare to expand a compressed executable, deferring the checks of
+       the executable's own header until it has been expanded. */
+    if (AspIsCompressedCode(engine->code))
+    {
+        AspAddCodeResult headerResult = AspCompressedCodeHeader
+            (engine->code, &engine->blockSizeBits, &engine->expandedSize);
+        if (headerResult == AspAddCodeResult_OK &&
+            engine->expandedSize - HeaderSize > engine->maxCodeSize)
+            headerResult = AspAddCodeResult_OutOfCodeMemory;
+        if (headerResult != AspAddCodeResult_OK)
+        {
+            engine->state = AspEngineState_LoadError;
+            return engine->loadResult = headerResult;
+        }
+
+        uint32_t blockCount =
+            ((engine->expandedSize - 1) >> engine->blockSizeBits) + 1;
+        engine->headerIndex = 0;
+        engine->expandedIndex = 0;
+        engine->compressedIndex = HeaderSize;
+        engine->blockOffsetsEndIndex = HeaderSize + 4 * (blockCount + 1);
+        AspStartExpansion(&engine->expansion);
+        engine->state = AspEngineState_ExpandingCode;
+        return engine->loadResult;
+    }
+
+    /* Ensure the header is valid. */
+    ProcessCodeHeader(engine);
+    if (engine->loadResult != AspAddCodeResult_OK)
+    {
+        engine->state = AspEngineState_LoadError;
+        return engine->loadResult;
+    }
+    engine->state = AspEngineState_LoadingCode;
+    return engine->loadResult;
+}
+
+static AspAddCodeResult ExpandCode
+    (AspEngine *engine, const uint8_t *code, size_t codeSize)
+{
+    /* Skip any of the block offsets that remain. */
+    if (engine->compressedIndex < engine->blockOffsetsEndIndex)
+    {
+        size_t skipCount =
+            engine->blockOffsetsEndIndex - engine->compressedIndex;
+        if (skipCount > codeSize)
+            skipCount = codeSize;
+        code += skipCount;
+        codeSize -= skipCount;
+        engine->compressedIndex += (uint32_t)skipCount;
+    }
+
+    /* Expand the blocks in turn. The executable's header is expanded in
+       place and checked before the code that follows overwrites it. */
+    uint32_t blockSize = (uint32_t)1 << engine->blockSizeBits;
+    while (engine->expandedIndex < engine->expandedSize)
+    {
+        uint32_t blockStartIndex = engine->expandedIndex & ~(blockSize - 1);
+        uint32_t blockEndIndex = blockStartIndex + blockSize;
+        if (blockEndIndex > engine->expandedSize)
+            blockEndIndex = engine->expandedSize;
+        bool expandingHeader = engine->expandedIndex < HeaderSize;
+        size_t outputIndex, outputStartIndex, outputEndIndex;
+        if (expandingHeader)
+        {
+            outputIndex = engine->expandedIndex;
+            outputStartIndex = 0;
+            outputEndIndex = HeaderSize;
+        }
+        else
+        {
+            outputIndex = engine->expandedIndex - HeaderSize;
+            outputStartIndex = blockStartIndex > HeaderSize ?
+                blockStartIndex - HeaderSize : 0;
+            outputEndIndex = blockEndIndex - HeaderSize;
+        }
+
+        size_t oldCodeSize = codeSize, oldOutputIndex = outputIndex;
+        AspAddCodeResult expandResult = AspExpand
+            (&engine->expansion, &code, &codeSize,
+             engine->code, &outputIndex, outputStartIndex, outputEndIndex);
+        engine->compressedIndex += (uint32_t)(oldCodeSize - codeSize);
+        engine->expandedIndex += (uint32_t)(outputIndex - oldOutputIndex);
+        if (expandingHeader)
+            engine->headerIndex = (uint8_t)engine->expandedIndex;
+        else
+            engine->codeEndIndex = outputIndex;
+        if (expandResult != AspAddCodeResult_OK)
+        {
+            engine->state = AspEngineState_LoadError;
+            return engine->loadResult = expandResult;
+        }
+        if (outputIndex < outputEndIndex)
+            break;
+
+        if (expandingHeader)
+        {
+            ProcessCodeHeader(engine);
+            if (engine->loadResult != AspAddCodeResult_OK)
+            {
+                engine->state = AspEngineState_LoadError;
+                return engine->loadResult;
+            }
+            engine->codeEndIndex = 0;
+        }
+        if (engine->expandedIndex == blockEndIndex)
+        {
+            if (!AspExpansionEnded(&engine->expansion))
+            {
+                engine->state = AspEngineState_LoadError;
+                return engine->loadResult = AspAddCodeResult_InvalidFormat;
+            }
+            AspStartExpansion(&engine->expansion);
+        }
+    }
+
+    /* Ensure nothing follows the last block. */
+    if (codeSize != 0)
+    {
+        engine->state = AspEngineState_LoadError;
+        return engine->loadResult = AspAddCodeResult_InvalidFormat;
+    }
+
+    return engine->loadResult;
+}
+
 static void ProcessCodeHeader(AspEngine *engine)
 {
     /* Ensure the application specification has been specified. */
@@ -868,6 +1151,11 @@ bool AspIsRunnable(const AspEngine *engine)
         engine->state == AspEngineState_Running;
 }
 
+bool AspIsWaitingForCode(const AspEngine *engine)
+{
+    return engine->codeWaiting;
+}
+
 size_t AspProgramCounter(const AspEngine *engine)
 {
     return (size_t)engine->pc;
@@ -885,3 +1173,11 @@ size_t AspCodePageReadCount(AspEngine *engine, bool reset)
         engine->codePageReadCount = 0;
     return count;
 }
+
+void AspCodePageStatistics
+    (AspEngine *engine, AspCodePageStats *stats, bool reset)
+{
+    *stats = engine->codePageStats;
+    if (reset)
+        memset(&engine->codePageStats, 0, sizeof engine->codePageStats);
+}
@@ -0,0 +1,364 @@
+/*
+ * Asp engine code expansion implementation.
+ */
+
+#include "expand.h"
+#include <string.h>
+
+/* A compressed executable consists of a header, the offsets of the
+   compressed blocks, and the blocks themselves. The header holds the
+   signature "AspZ", the base 2 logarithm of the block size, three zero
+   bytes, and the size of the executable once expanded, including its own
+   header. Each block expands to the block size, except the last, which
+   expands to whatever remains. The block offsets, one for each block plus
+   one for the end of the last, are from the start of the file. All
+   multi-byte values are big-endian.
+
+   A block is a series of sequences, each consisting of a token, any further
+   literal length bytes, the literal bytes, and then, unless the block is
+   complete, a match distance and any further match length bytes. The token's
+   high nibble is the literal length and its low nibble the match length less
+   the minimum. A nibble of 15 is extended by adding the bytes that follow,
+   up to and including the first that is not 255. A match copies bytes from
+   the given distance back within the same block, possibly overlapping the
+   bytes it produces. */
+static const uint8_t CompressedHeaderSize = 12, ExecutableHeaderSize = 12;
+static const uint8_t MinBlockSizeBits = 6, MaxBlockSizeBits = 16;
+static const uint8_t ExtendedLength = 15;
+static const uint32_t MinMatchLength = 4;
+
+typedef enum
+{
+    ExpansionStage_Token,
+    ExpansionStage_LiteralLength,
+    ExpansionStage_Literals,
+    ExpansionStage_DistanceHigh,
+    ExpansionStage_DistanceLow,
+    ExpansionStage_MatchLength,
+    ExpansionStage_Match,
+} ExpansionStage;
+
+static AspRunResult ExpandCodePage
+    (AspCodeExpander *, uint32_t offset, size_t *size, uint8_t *codePage);
+static uint32_t LoadWord(const uint8_t *);
+
+AspRunResult AspInitializeCodeExpander
+    (AspCodeExpander *expander, AspCodeReader reader, void *id,
+     void *buffer, size_t bufferSize)
+{
+    if (reader == 0 || buffer == 0 || bufferSize == 0)
+        return AspRunResult_InitializationError;
+
+    expander->reader = reader;
+    expander->id = id;
+    expander->buffer = (uint8_t *)buffer;
+    expander->bufferSize = bufferSize;
+    expander->headerRead = false;
+    expander->reading = false;
+    return AspRunResult_OK;
+}
+
+AspRunResult AspExpandCodePage
+    (void *id, uint32_t offset, size_t *size, void *codePage)
+{
+    /* Expand the page, or resume expanding it if the reader had yet to
+       complete a read. */
+    AspCodeExpander *expander = (AspCodeExpander *)id;
+    AspRunResult result = ExpandCodePage
+        (expander, offset, size, (uint8_t *)codePage);
+    if (result != AspRunResult_Again)
+        expander->reading = false;
+    return result;
+}
+
+static AspRunResult ExpandCodePage
+    (AspCodeExpander *expander, uint32_t offset, size_t *size,
+     uint8_t *codePage)
+{
+    /* Read the compressed header ahead of the first page. */
+    if (!expander->headerRead)
+    {
+        size_t headerSize = sizeof expander->header;
+        AspRunResult readResult = expander->reader
+            (expander->id, 0, &headerSize, expander->header);
+        if (readResult != AspRunResult_OK)
+            return readResult;
+        if (headerSize != sizeof expander->header)
+            return AspRunResult_BeyondEndOfCode;
+        if (AspCompressedCodeHeader
+                (expander->header,
+                 &expander->blockSizeBits, &expander->expandedSize)
+            != AspAddCodeResult_OK)
+            return AspRunResult_InvalidInstruction;
+        expander->headerRead = true;
+    }
+
+    /* Begin a new page, which must consist of whole blocks. */
+    uint32_t blockSize = (uint32_t)1 << expander->blockSizeBits;
+    if (!expander->reading)
+    {
+        if (offset % blockSize != 0 || *size % blockSize != 0)
+            return AspRunResult_InitializationError;
+        if (offset >= expander->expandedSize)
+        {
+            *size = 0;
+            return AspRunResult_OK;
+        }
+
+        expander->blockIndex = offset >> expander->blockSizeBits;
+        expander->blockEndIndex = expander->blockIndex +
+            (uint32_t)(*size >> expander->blockSizeBits);
+        expander->blockOffsetsRead = false;
+        expander->reading = true;
+    }
+
+    /* Expand each block of the page in turn. */
+    size_t pageSize = expander->expandedSize - offset;
+    if (pageSize > *size)
+        pageSize = *size;
+    for (; expander->blockIndex < expander->blockEndIndex &&
+           expander->blockIndex << expander->blockSizeBits <
+           expander->expandedSize;
+         expander->blockIndex++, expander->blockOffsetsRead = false)
+    {
+        /* Locate the compressed block. */
+        size_t outputStartIndex =
+            (expander->blockIndex << expander->blockSizeBits) - offset;
+        size_t outputEndIndex = outputStartIndex + blockSize;
+        if (outputEndIndex > pageSize)
+            outputEndIndex = pageSize;
+        if (!expander->blockOffsetsRead)
+        {
+            size_t offsetsSize = sizeof expander->blockOffsets;
+            AspRunResult readResult = expander->reader
+                (expander->id,
+                 CompressedHeaderSize + 4 * expander->blockIndex,
+                 &offsetsSize, expander->blockOffsets);
+            if (readResult != AspRunResult_OK)
+                return readResult;
+            if (offsetsSize != sizeof expander->blockOffsets)
+                return AspRunResult_BeyondEndOfCode;
+            expander->compressedIndex = LoadWord(expander->blockOffsets);
+            expander->compressedEndIndex =
+                LoadWord(expander->blockOffsets + 4);
+            if (expander->compressedEndIndex < expander->compressedIndex)
+                return AspRunResult_InvalidInstruction;
+
+            expander->outputIndex = outputStartIndex;
+            AspStartExpansion(&expander->expansion);
+            expander->blockOffsetsRead = true;
+        }
+
+        /* Expand the block, reading as much of it at a time as fits in the
+           buffer. */
+        while (expander->outputIndex < outputEndIndex)
+        {
+            size_t inputSize = 0;
+            if (expander->compressedIndex < expander->compressedEndIndex)
+            {
+                inputSize =
+                    expander->compressedEndIndex - expander->compressedIndex;
+                if (inputSize > expander->bufferSize)
+                    inputSize = expander->bufferSize;
+                AspRunResult readResult = expander->reader
+                    (expander->id, expander->compressedIndex,
+                     &inputSize, expander->buffer);
+                if (readResult != AspRunResult_OK)
+                    return readResult;
+                if (inputSize == 0)
+                    return AspRunResult_BeyondEndOfCode;
+                expander->compressedIndex += (uint32_t)inputSize;
+            }
+
+            /* Ensure the block expands to exactly its size. */
+            const uint8_t *input = expander->buffer;
+            bool inputRead = inputSize != 0;
+            size_t oldOutputIndex = expander->outputIndex;
+            AspAddCodeResult expandResult = AspExpand
+                (&expander->expansion, &input, &inputSize,
+                 codePage, &expander->outputIndex,
+                 outputStartIndex, outputEndIndex);
+            if (expandResult != AspAddCodeResult_OK || inputSize != 0 ||
+                (!inputRead && expander->outputIndex == oldOutputIndex))
+                return AspRunResult_InvalidInstruction;
+        }
+        if (expander->compressedIndex != expander->compressedEndIndex ||
+            !AspExpansionEnded(&expander->expansion))
+            return AspRunResult_InvalidInstruction;
+    }
+
+    *size = pageSize;
+    return AspRunResult_OK;
+}
+
+AspAddCodeResult AspCompressedCodeSizes
+    (const void *header, size_t headerSize,
+     size_t *codeSize, size_t *blockSize)
+{
+    if (headerSize < CompressedHeaderSize)
+        return AspAddCodeResult_InvalidFormat;
+    uint8_t blockSizeBits;
+    uint32_t expandedSize;
+    AspAddCodeResult result = AspCompressedCodeHeader
+        ((const uint8_t *)header, &blockSizeBits, &expandedSize);
+    if (result != AspAddCodeResult_OK)
+        return result;
+
+    /* The code area holds the expanded code without the executable's own
+       header, but must have room for the header while it is checked. Room
+       for a block's worth of compressed code beyond the expanded code lets
+       loading read the compressed code a block at a time rather than
+       through the engine's small load buffer. Code pages must consist of
+       whole blocks. */
+    *blockSize = (size_t)1 << blockSizeBits;
+    *codeSize = expandedSize - ExecutableHeaderSize + *blockSize;
+    if (*codeSize < ExecutableHeaderSize)
+        *codeSize = ExecutableHeaderSize;
+    return AspAddCodeResult_OK;
+}
+
+bool AspIsCompressedCode(const uint8_t *header)
+{
+    return memcmp(header, "AspZ", 4) == 0;
+}
+
+AspAddCodeResult AspCompressedCodeHeader
+    (const uint8_t *header, uint8_t *blockSizeBits, uint32_t *expandedSize)
+{
+    if (!AspIsCompressedCode(header) ||
+        header[4] < MinBlockSizeBits || header[4] > MaxBlockSizeBits ||
+        header[5] != 0 || header[6] != 0 || header[7] != 0)
+        return AspAddCodeResult_InvalidFormat;
+
+    /* Ensure the expanded executable at least has room for its header. */
+    *blockSizeBits = header[4];
+    *expandedSize = LoadWord(header + 8);
+    return *expandedSize < CompressedHeaderSize ?
+        AspAddCodeResult_InvalidFormat : AspAddCodeResult_OK;
+}
+
+void AspStartExpansion(AspExpansion *expansion)
+{
+    expansion->literalCount = expansion->matchCount = 0;
+    expansion->matchDistance = 0;
+    expansion->stage = ExpansionStage_Token;
+}
+
+AspAddCodeResult AspExpand
+    (AspExpansion *expansion, const uint8_t **input, size_t *inputSize,
+     uint8_t *output, size_t *outputIndex,
+     size_t outputStartIndex, size_t outputEndIndex)
+{
+    /* Expand until either the output is complete or the input runs out. */
+    while (*outputIndex < outputEndIndex)
+    {
+        size_t outputSize = outputEndIndex - *outputIndex;
+        if (expansion->stage == ExpansionStage_Match)
+        {
+            /* Copy the match a byte at a time, as the bytes it copies may
+               include those it produces. */
+            if (expansion->matchDistance > *outputIndex - outputStartIndex)
+                return AspAddCodeResult_InvalidFormat;
+            size_t count = expansion->matchCount;
+            if (count > outputSize)
+                count = outputSize;
+            uint8_t *p = output + *outputIndex;
+            const uint8_t *q = p - expansion->matchDistance;
+            *outputIndex += count;
+            expansion->matchCount -= (uint32_t)count;
+            while (count--)
+                *p++ = *q++;
+            if (expansion->matchCount == 0)
+                expansion->stage = ExpansionStage_Token;
+            continue;
+        }
+
+        if (*inputSize == 0)
+            break;
+        if (expansion->stage == ExpansionStage_Literals)
+        {
+            size_t count = expansion->literalCount;
+            if (count > outputSize)
+                count = outputSize;
+            if (count > *inputSize)
+                count = *inputSize;
+            memcpy(output + *outputIndex, *input, count);
+            *outputIndex += count;
+            *input += count;
+            *inputSize -= count;
+            expansion->literalCount -= (uint32_t)count;
+            if (expansion->literalCount == 0)
+                expansion->stage = ExpansionStage_DistanceHigh;
+            continue;
+        }
+
+        uint8_t c = *(*input)++;
+        (*inputSize)--;
+        switch (expansion->stage)
+        {
+            case ExpansionStage_Token:
+                expansion->literalCount = c >> 4;
+                expansion->matchCount = (c & 0x0F) + MinMatchLength;
+                expansion->stage =
+                    expansion->literalCount == ExtendedLength ?
+                    ExpansionStage_LiteralLength :
+                    expansion->literalCount != 0 ?
+                    ExpansionStage_Literals : ExpansionStage_DistanceHigh;
+                break;
+
+            case ExpansionStage_LiteralLength:
+                if (expansion->literalCount > UINT32_MAX - 0xFF)
+                    return AspAddCodeResult_InvalidFormat;
+                expansion->literalCount += c;
+                if (c != 0xFF)
+                    expansion->stage = ExpansionStage_Literals;
+                break;
+
+            case ExpansionStage_DistanceHigh:
+                expansion->matchDistance = (uint32_t)c << 8;
+                expansion->stage = ExpansionStage_DistanceLow;
+                break;
+
+            case ExpansionStage_DistanceLow:
+                expansion->matchDistance |= c;
+                if (expansion->matchDistance == 0)
+                    return AspAddCodeResult_InvalidFormat;
+                expansion->stage =
+                    expansion->matchCount == ExtendedLength + MinMatchLength ?
+                    ExpansionStage_MatchLength : ExpansionStage_Match;
+                break;
+
+            case ExpansionStage_MatchLength:
+                if (expansion->matchCount > UINT32_MAX - 0xFF)
+                    return AspAddCodeResult_InvalidFormat;
+                expansion->matchCount += c;
+                if (c != 0xFF)
+                    expansion->stage = ExpansionStage_Match;
+                break;
+
+            default:
+                return AspAddCodeResult_InvalidFormat;
+        }
+    }
+
+    return AspAddCodeResult_OK;
+}
+
+bool AspExpansionEnded(const AspExpansion *expansion)
+{
+    /* A block may end after a match or after literals in place of one. */
+    return
+        expansion->stage == ExpansionStage_Token ||
+        expansion->stage == ExpansionStage_DistanceHigh;
+}
+
+static uint32_t LoadWord(const uint8_t *bytes)
+{
+    uint32_t value = 0;
+    for (unsigned i = 0; i < 4; i++)
+    {
+        value <<= 8;
+        value |= *bytes++;
+    }
+    return value;
+}
@@ -0,0 +1,31 @@
+/*
+ * Asp engine code expansion definitions.
+ */
+
+#ifndef ASP_EXPAND_H
+#define ASP_EXPAND_H
+
+#include "asp.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool AspIsCompressedCode(const uint8_t *header);
+AspAddCodeResult AspCompressedCodeHeader
+    (const uint8_t *header, uint8_t *blockSizeBits, uint32_t *expandedSize);
+void AspStartExpansion(AspExpansion *);
+AspAddCodeResult AspExpand
+    (AspExpansion *, const uint8_t **input, size_t *inputSize,
+     uint8_t *output, size_t *outputIndex,
+     size_t outputStartIndex, size_t outputEndIndex);
+bool AspExpansionEnded(const AspExpansion *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
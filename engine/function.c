@@ -474,6 +474,64 @@ AspRunResult AspCallFunction
     return AspRunResult_OK;
 }
 
+AspRunResult AspTailCallFunction
+    (AspEngine *engine, AspDataEntry *function, AspDataEntry *argumentList)
+{
+    /* Make an ordinary call unless a script function is calling another
+       script function on its own behalf, with its frame on top of the
+       stack. */
+    const AspDataEntry *frame = AspTopValue(engine);
+    if (engine->inApp || engine->again || engine->callFromApp ||
+        engine->localNamespace == engine->globalNamespace ||
+        frame == 0 || AspDataGetType(frame) != DataType_Frame ||
+        function == 0 || AspDataGetType(function) != DataType_Function ||
+        AspDataGetFunctionIsApp(function))
+        return AspCallFunction
+            (engine, function, argumentList, engine->callFromApp);
+
+    /* Gain access to the parameter list within the function. */
+    const AspDataEntry *parameters = AspEntry
+        (engine, AspDataGetFunctionParametersIndex(function));
+    if (AspDataGetType(parameters) != DataType_ParameterList)
+        return AspRunResult_UnexpectedType;
+
+    /* Create a local namespace for the call. */
+    AspDataEntry *ns = AspAllocEntry(engine, DataType_Namespace);
+    if (ns == 0)
+        return AspRunResult_OutOfDataMemory;
+    AspRunResult loadArgumentsResult = LoadArguments
+        (engine, argumentList, parameters, ns);
+    if (loadArgumentsResult != AspRunResult_OK)
+        return loadArgumentsResult;
+    AspUnref(engine, argumentList);
+    if (engine->runResult != AspRunResult_OK)
+        return engine->runResult;
+
+    /* Discard the caller's local namespace. Its frame is kept as is, so that
+       the called function returns directly to the caller's caller. */
+    AspUnref(engine, engine->localNamespace);
+    if (engine->runResult != AspRunResult_OK)
+        return engine->runResult;
+
+    /* Switch to the called function's context. */
+    AspDataEntry *functionModule = AspValueEntry
+        (engine, AspDataGetFunctionModuleIndex(function));
+    engine->module = functionModule;
+    engine->globalNamespace = AspEntry
+        (engine, AspDataGetModuleNamespaceIndex(functionModule));
+    engine->localNamespace = ns;
+
+    /* Transfer control to the function's code. */
+    uint32_t codeAddress = AspDataGetFunctionCodeAddress(function);
+    AspRunResult validateResult = AspValidateCodeAddress
+        (engine, codeAddress);
+    if (validateResult != AspRunResult_OK)
+        return validateResult;
+    engine->pc = codeAddress;
+
+    return AspRunResult_OK;
+}
+
 /* Builds a namespace based on arguments and parameters. */
 static AspRunResult LoadArguments
     (AspEngine *engine,
@@ -18,6 +18,8 @@ AspRunResult AspExpandDictionaryGroupArgument
 AspRunResult AspCallFunction
     (AspEngine *, AspDataEntry *function, AspDataEntry *argumentList,
      bool fromApp);
+AspRunResult AspTailCallFunction
+    (AspEngine *, AspDataEntry *function, AspDataEntry *argumentList);
 AspRunResult AspReturnToCaller(AspEngine *);
 
 #ifdef __cplusplus
@@ -9,9 +9,16 @@
 #include "integer.h"
 #include "integer-result.h"
 
+static const uint8_t MaxAdapterDepth = 4;
+
 static bool ReversedRangeIteratorAtEnd
     (int32_t testValue,
      int32_t startValue, int32_t endValue, int32_t stepValue);
+static uint8_t AdapterDepth(const AspDataEntry *iterator);
+static AspRunResult AdapterNext
+    (AspEngine *, AspDataEntry *iterator, AspDataEntry *member);
+static AspIteratorResult AdapterDereference
+    (AspEngine *, const AspDataEntry *iterator, AspDataEntry *member);
 
 AspIteratorResult AspIteratorCreate
     (AspEngine *engine, AspDataEntry *iterable, bool reversed)
@@ -22,6 +29,20 @@ AspIteratorResult AspIteratorCreate
     if (result.result != AspRunResult_OK)
         return result;
 
+    /* Adapter iterators are not copied, because doing so would mean copying
+       the iterators they wrap. The same iterator is returned instead. */
+    if (AspIsIterator(iterable) && AspDataGetIteratorIsAdapter(iterable))
+    {
+        if (reversed)
+        {
+            result.result = AspRunResult_UnexpectedType;
+            return result;
+        }
+        AspRef(engine, iterable);
+        result.value = iterable;
+        return result;
+    }
+
     /* Create an iterator entry. Note that the type may be changed later if
        it turns out the new iterator is reversed. */
     AspDataEntry *iterator = AspAllocEntry(engine, DataType_ForwardIterator);
@@ -207,6 +228,137 @@ AspIteratorResult AspIteratorCreate
     return result;
 }
 
+AspIteratorResult AspIteratorCreateEnumerate
+    (AspEngine *engine, AspDataEntry *iterable, int32_t start)
+{
+    AspIteratorResult result = {AspRunResult_OK, 0};
+
+    result.result = AspAssert(engine, iterable != 0);
+    if (result.result != AspRunResult_OK)
+        return result;
+
+    /* Create an iterator for the underlying iterable. */
+    AspIteratorResult innerResult = AspIteratorCreate
+        (engine, iterable, false);
+    if (innerResult.result != AspRunResult_OK)
+        return innerResult;
+    AspDataEntry *inner = innerResult.value;
+    uint8_t depth = AdapterDepth(inner) + 1U;
+    if (depth > MaxAdapterDepth)
+    {
+        AspUnref(engine, inner);
+        result.result = AspRunResult_ValueOutOfRange;
+        return result;
+    }
+
+    /* Create the adapter, giving it the reference to the inner iterator. */
+    AspDataEntry *iterator = AspAllocEntry(engine, DataType_ForwardIterator);
+    if (iterator == 0)
+    {
+        AspUnref(engine, inner);
+        result.result = AspRunResult_OutOfDataMemory;
+        return result;
+    }
+    AspDataSetIteratorIsAdapter(iterator, true);
+    AspDataSetIteratorAdapterDepth(iterator, depth);
+    AspDataSetIteratorIterableIndex(iterator, AspIndex(engine, inner));
+
+    /* The member of an enumerate adapter is the current count. */
+    if (AspDataGetIteratorMemberIndex(inner) != 0)
+    {
+        AspDataEntry *count = AspAllocEntry(engine, DataType_Integer);
+        if (count == 0)
+        {
+            AspUnref(engine, iterator);
+            result.result = AspRunResult_OutOfDataMemory;
+            return result;
+        }
+        AspDataSetInteger(count, start);
+        AspDataSetIteratorMemberNeedsCleanup(iterator, true);
+        AspDataSetIteratorMemberIndex(iterator, AspIndex(engine, count));
+    }
+
+    result.value = iterator;
+    return result;
+}
+
+AspIteratorResult AspIteratorCreateZip
+    (AspEngine *engine, AspDataEntry *iterables)
+{
+    AspIteratorResult result = {AspRunResult_OK, 0};
+
+    result.result = AspAssert
+        (engine, iterables != 0 && AspIsSequence(iterables));
+    if (result.result != AspRunResult_OK)
+        return result;
+
+    /* Create the adapter. Its iterable is a tuple of inner iterators. */
+    AspDataEntry *iterator = AspAllocEntry(engine, DataType_ForwardIterator);
+    if (iterator == 0)
+    {
+        result.result = AspRunResult_OutOfDataMemory;
+        return result;
+    }
+    AspDataSetIteratorIsAdapter(iterator, true);
+    AspDataEntry *inners = AspAllocEntry(engine, DataType_Tuple);
+    if (inners == 0)
+    {
+        AspUnref(engine, iterator);
+        result.result = AspRunResult_OutOfDataMemory;
+        return result;
+    }
+    AspDataSetIteratorIterableIndex(iterator, AspIndex(engine, inners));
+
+    /* Create an iterator for each of the given iterables. */
+    bool atEnd = AspDataGetSequenceCount(iterables) == 0;
+    uint8_t depth = 1;
+    for (AspSequenceResult nextResult = AspSequenceNext
+            (engine, iterables, 0, true);
+         nextResult.element != 0;
+         nextResult = AspSequenceNext
+            (engine, iterables, nextResult.element, true))
+    {
+        AspIteratorResult innerResult = AspIteratorCreate
+            (engine, nextResult.value, false);
+        if (innerResult.result != AspRunResult_OK)
+        {
+            result.result = innerResult.result;
+            break;
+        }
+        AspDataEntry *inner = innerResult.value;
+        AspSequenceResult appendResult = AspSequenceAppend
+            (engine, inners, inner);
+        AspUnref(engine, inner);
+        if (appendResult.result != AspRunResult_OK)
+        {
+            result.result = appendResult.result;
+            break;
+        }
+
+        if (AspDataGetIteratorMemberIndex(inner) == 0)
+            atEnd = true;
+        uint8_t innerDepth = AdapterDepth(inner) + 1U;
+        if (innerDepth > depth)
+            depth = innerDepth;
+    }
+    if (result.result == AspRunResult_OK && depth > MaxAdapterDepth)
+        result.result = AspRunResult_ValueOutOfRange;
+    if (result.result != AspRunResult_OK)
+    {
+        AspUnref(engine, iterator);
+        return result;
+    }
+    AspDataSetIteratorAdapterDepth(iterator, depth);
+
+    /* The member of a zip adapter is the tuple of inner iterators itself,
+       which serves only to indicate that the adapter is not at its end. */
+    if (!atEnd)
+        AspDataSetIteratorMemberIndex(iterator, AspIndex(engine, inners));
+
+    result.value = iterator;
+    return result;
+}
+
 AspRunResult AspIteratorNext
     (AspEngine *engine, AspDataEntry *iterator)
 {
@@ -227,6 +379,9 @@ AspRunResult AspIteratorNext
     if (member == 0)
         return AspRunResult_IteratorAtEnd;
 
+    if (AspDataGetIteratorIsAdapter(iterator))
+        return AdapterNext(engine, iterator, member);
+
     /* Determine the direction of iteration. */
     bool reversed = AspIsReverseIterator(iterator);
 
@@ -399,6 +554,9 @@ AspIteratorResult AspIteratorDereference
         return result;
     }
 
+    if (AspDataGetIteratorIsAdapter(iterator))
+        return AdapterDereference(engine, iterator, member);
+
     /* Dereference the iterator, creating a new value object. */
     uint8_t iterableType = AspDataGetType(iterable);
     AspDataEntry *value = 0;
@@ -604,8 +762,8 @@ AspRunResult AspIteratorErase
     if (assertResult != AspRunResult_OK)
         return assertResult;
 
-    /* Ensure the erasure point is an iterator. */
-    if (!AspIsIterator(iterator))
+    /* Ensure the erasure point is an iterator over a container. */
+    if (!AspIsIterator(iterator) || AspDataGetIteratorIsAdapter(iterator))
         return AspRunResult_UnexpectedType;
 
     /* Get the iterator's container. */
@@ -660,3 +818,173 @@ static bool ReversedRangeIteratorAtEnd
         stepValue == 0 ? testValue == endValue :
         stepValue < 0 ? testValue > startValue : testValue < startValue;
 }
+
+static uint8_t AdapterDepth(const AspDataEntry *iterator)
+{
+    return AspDataGetIteratorIsAdapter(iterator) ?
+        AspDataGetIteratorAdapterDepth(iterator) : 0;
+}
+
+static AspRunResult AdapterNext
+    (AspEngine *engine, AspDataEntry *iterator, AspDataEntry *member)
+{
+    AspDataEntry *iterable = AspValueEntry
+        (engine, AspDataGetIteratorIterableIndex(iterator));
+    bool atEnd = false;
+    switch (AspDataGetType(iterable))
+    {
+        default:
+            return AspRunResult_UnexpectedType;
+
+        case DataType_ForwardIterator:
+        case DataType_ReverseIterator:
+        {
+            /* Enumerate: advance the inner iterator and the count. */
+            if (AspDataGetType(member) != DataType_Integer)
+                return AspRunResult_UnexpectedType;
+            int32_t newCount;
+            AspIntegerResult integerResult = AspAddIntegers
+                (AspDataGetInteger(member), 1, &newCount);
+            if (integerResult != AspIntegerResult_OK)
+                return AspTranslateIntegerResult(integerResult);
+            AspRunResult nextResult = AspIteratorNext(engine, iterable);
+            if (nextResult != AspRunResult_OK)
+                return nextResult;
+
+            /* Update the count in place unless it is shared (e.g., by a
+               tuple produced by an earlier dereference). */
+            atEnd = AspDataGetIteratorMemberIndex(iterable) == 0;
+            if (!atEnd && AspDataGetUseCount(member) == 1)
+            {
+                AspDataSetInteger(member, newCount);
+                break;
+            }
+            AspUnref(engine, member);
+            if (engine->runResult != AspRunResult_OK)
+                return engine->runResult;
+            if (atEnd)
+            {
+                AspDataSetIteratorMemberNeedsCleanup(iterator, false);
+                member = 0;
+            }
+            else
+            {
+                member = AspAllocEntry(engine, DataType_Integer);
+                if (member == 0)
+                    return AspRunResult_OutOfDataMemory;
+                AspDataSetInteger(member, newCount);
+            }
+
+            break;
+        }
+
+        case DataType_Tuple:
+        {
+            /* Zip: advance all the inner iterators in lockstep, stopping
+               when any one of them reaches its end. */
+            for (AspSequenceResult nextResult = AspSequenceNext
+                    (engine, iterable, 0, true);
+                 nextResult.element != 0;
+                 nextResult = AspSequenceNext
+                    (engine, iterable, nextResult.element, true))
+            {
+                AspDataEntry *inner = nextResult.value;
+                AspRunResult innerResult = AspIteratorNext(engine, inner);
+                if (innerResult != AspRunResult_OK)
+                    return innerResult;
+                if (AspDataGetIteratorMemberIndex(inner) == 0)
+                    atEnd = true;
+            }
+            if (atEnd)
+                member = 0;
+
+            break;
+        }
+    }
+
+    /* Update the iterator. */
+    AspDataSetIteratorMemberIndex(iterator, AspIndex(engine, member));
+    return AspRunResult_OK;
+}
+
+static AspIteratorResult AdapterDereference
+    (AspEngine *engine, const AspDataEntry *iterator, AspDataEntry *member)
+{
+    AspIteratorResult result = {AspRunResult_OK, 0};
+
+    const AspDataEntry *iterable = AspValueEntry
+        (engine, AspDataGetIteratorIterableIndex(iterator));
+    uint8_t iterableType = AspDataGetType(iterable);
+    if (iterableType != DataType_ForwardIterator &&
+        iterableType != DataType_ReverseIterator &&
+        iterableType != DataType_Tuple)
+    {
+        result.result = AspRunResult_UnexpectedType;
+        return result;
+    }
+
+    /* Both adapters produce a tuple. */
+    AspDataEntry *tuple = AspAllocEntry(engine, DataType_Tuple);
+    if (tuple == 0)
+    {
+        result.result = AspRunResult_OutOfDataMemory;
+        return result;
+    }
+
+    if (iterableType == DataType_Tuple)
+    {
+        /* Zip: gather the values of all the inner iterators. */
+        for (AspSequenceResult nextResult = AspSequenceNext
+                (engine, iterable, 0, true);
+             result.result == AspRunResult_OK && nextResult.element != 0;
+             nextResult = AspSequenceNext
+                (engine, iterable, nextResult.element, true))
+        {
+            AspIteratorResult innerResult = AspIteratorDereference
+                (engine, nextResult.value);
+            if (innerResult.result != AspRunResult_OK)
+            {
+                result.result = innerResult.result;
+                break;
+            }
+            AspSequenceResult appendResult = AspSequenceAppend
+                (engine, tuple, innerResult.value);
+            AspUnref(engine, innerResult.value);
+            result.result = appendResult.result;
+        }
+    }
+    else
+    {
+        /* Enumerate: pair the count with the inner iterator's value. */
+        if (AspDataGetType(member) != DataType_Integer)
+            result.result = AspRunResult_UnexpectedType;
+        AspIteratorResult innerResult = {AspRunResult_OK, 0};
+        if (result.result == AspRunResult_OK)
+        {
+            innerResult = AspIteratorDereference(engine, iterable);
+            result.result = innerResult.result;
+        }
+        if (result.result == AspRunResult_OK)
+        {
+            AspSequenceResult appendResult = AspSequenceAppend
+                (engine, tuple, member);
+            result.result = appendResult.result;
+            if (result.result == AspRunResult_OK)
+            {
+                appendResult = AspSequenceAppend
+                    (engine, tuple, innerResult.value);
+                result.result = appendResult.result;
+            }
+            AspUnref(engine, innerResult.value);
+        }
+    }
+
+    if (result.result != AspRunResult_OK)
+    {
+        AspUnref(engine, tuple);
+        return result;
+    }
+
+    result.value = tuple;
+    return result;
+}
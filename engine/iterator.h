@@ -21,6 +21,10 @@ typedef struct
 
 AspIteratorResult AspIteratorCreate
     (AspEngine *, AspDataEntry *iterable, bool reversed);
+AspIteratorResult AspIteratorCreateEnumerate
+    (AspEngine *, AspDataEntry *iterable, int32_t start);
+AspIteratorResult AspIteratorCreateZip
+    (AspEngine *, AspDataEntry *iterables);
 AspRunResult AspIteratorNext
     (AspEngine *, AspDataEntry *iterator);
 AspIteratorResult AspIteratorDereference
@@ -97,3 +97,93 @@ static AspRunResult FillSequence
 
     return AspRunResult_OK;
 }
+
+/* sort(list, reverse)
+ * Sort the list in place.
+ */
+ASP_LIB_API AspRunResult AspLib_sort
+    (AspEngine *engine,
+     AspDataEntry *list, AspDataEntry *reverse,
+     AspDataEntry **returnValue)
+{
+    if (!AspIsList(list))
+        return AspRunResult_UnexpectedType;
+
+    return AspSequenceSort(engine, list, AspIsTrue(engine, reverse));
+}
+
+/* sorted(iterable, reverse)
+ * Return a new sorted list containing the items of the iterable.
+ */
+ASP_LIB_API AspRunResult AspLib_sorted
+    (AspEngine *engine,
+     AspDataEntry *iterable, AspDataEntry *reverse,
+     AspDataEntry **returnValue)
+{
+    *returnValue = AspNewList(engine);
+    if (*returnValue == 0)
+        return AspRunResult_OutOfDataMemory;
+
+    AspRunResult result = FillSequence(engine, *returnValue, iterable);
+    if (result != AspRunResult_OK)
+        return result;
+
+    return AspSequenceSort
+        (engine, *returnValue, AspIsTrue(engine, reverse));
+}
+
+/* join(sep, iterable)
+ * Return a string made by concatenating the strings of the iterable, placing
+ * the separator between them.
+ */
+ASP_LIB_API AspRunResult AspLib_join
+    (AspEngine *engine,
+     AspDataEntry *sep, AspDataEntry *iterable,
+     AspDataEntry **returnValue)
+{
+    if (!AspIsString(sep))
+        return AspRunResult_UnexpectedType;
+
+    *returnValue = AspNewString(engine, 0, 0);
+    if (*returnValue == 0)
+        return AspRunResult_OutOfDataMemory;
+
+    AspIteratorResult iteratorResult = AspIteratorCreate
+        (engine, iterable, false);
+    if (iteratorResult.result != AspRunResult_OK)
+        return iteratorResult.result;
+    AspDataEntry *iterator = iteratorResult.value;
+
+    /* Append each item directly into the result's fragments. */
+    AspRunResult result = AspRunResult_OK;
+    uint32_t iterationCount = 0;
+    for (; iterationCount < engine->cycleDetectionLimit; iterationCount++)
+    {
+        iteratorResult = AspIteratorDereference(engine, iterator);
+        if (iteratorResult.result == AspRunResult_IteratorAtEnd)
+            break;
+        result = iteratorResult.result;
+        if (result != AspRunResult_OK)
+            break;
+        AspDataEntry *value = iteratorResult.value;
+
+        if (!AspIsString(value))
+            result = AspRunResult_UnexpectedType;
+        if (result == AspRunResult_OK && iterationCount != 0)
+            result = AspStringAppendString(engine, *returnValue, sep);
+        if (result == AspRunResult_OK)
+            result = AspStringAppendString(engine, *returnValue, value);
+        AspUnref(engine, value);
+        if (result == AspRunResult_OK)
+            result = AspIteratorNext(engine, iterator);
+        if (result != AspRunResult_OK)
+            break;
+    }
+    if (result == AspRunResult_OK &&
+        iterationCount >= engine->cycleDetectionLimit)
+        result = AspRunResult_CycleDetected;
+
+    AspUnref(engine, iterator);
+
+    return result;
+}
@@ -33,6 +33,40 @@ ASP_LIB_API AspRunResult AspLib_reversed
     return result.result;
 }
 
+/* enumerate(iterable, start = 0)
+ * Return an iterator that yields (count, item) tuples for the given iterable.
+ */
+ASP_LIB_API AspRunResult AspLib_enumerate
+    (AspEngine *engine,
+     AspDataEntry *iterable, AspDataEntry *start,
+     AspDataEntry **returnValue)
+{
+    int32_t startValue;
+    if (!AspIntegerValue(start, &startValue))
+        return AspRunResult_UnexpectedType;
+
+    AspIteratorResult result = AspIteratorCreateEnumerate
+        (engine, iterable, startValue);
+    if (result.result == AspRunResult_OK)
+        *returnValue = result.value;
+    return result.result;
+}
+
+/* zip(*iterables)
+ * Return an iterator that yields tuples of items taken from each of the
+ * given iterables in parallel.
+ */
+ASP_LIB_API AspRunResult AspLib_zip
+    (AspEngine *engine,
+     AspDataEntry *iterables,
+     AspDataEntry **returnValue)
+{
+    AspIteratorResult result = AspIteratorCreateZip(engine, iterables);
+    if (result.result == AspRunResult_OK)
+        *returnValue = result.value;
+    return result.result;
+}
+
 /* at(iterator, end = None)
  * Return the current item at the iterator, returning the given end value
    if the iterator is at its end.
@@ -111,7 +145,7 @@ ASP_LIB_API AspRunResult AspLib_del_at
 
 /* iterable(iterator)
  * Return the iterable for the given iterator, or None if the parameter is not
- * an iterator.
+ * an iterator or is a zip adapter.
  */
 ASP_LIB_API AspRunResult AspLib_iterable
     (AspEngine *engine,
@@ -120,6 +154,9 @@ ASP_LIB_API AspRunResult AspLib_iterable
 {
     AspDataEntry *iterable = AspIterable(engine, iterator);
     if (iterable != 0)
+    {
+        AspRef(engine, iterable);
         *returnValue = iterable;
+    }
     return AspRunResult_OK;
 }
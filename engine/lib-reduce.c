@@ -0,0 +1,525 @@
+/*
+ * Asp script function library implementation: reduction functions.
+ */
+
+#include "asp.h"
+#include "data.h"
+#include "range.h"
+#include "sequence.h"
+#include "tree.h"
+#include "iterator.h"
+#include "compare.h"
+#include "operation.h"
+#include "opcode.h"
+#include "integer.h"
+#include "integer-result.h"
+
+/* State for traversing the members of an iterable without creating an
+   iterator object where possible. Ranges, tuples, lists, sets, and
+   dictionaries are traversed directly; other iterables are traversed using
+   a regular iterator. */
+typedef struct
+{
+    const AspDataEntry *iterable;
+    uint8_t type;
+    int32_t value, end, step;
+    bool bounded, atEnd;
+    const AspDataEntry *member;
+    AspDataEntry *iterator;
+    uint32_t iterationCount;
+} Traversal;
+
+/* A member produced by a traversal. For ranges, only intValue is used. For
+   dictionaries, both key and value are given. If owned is true, the value
+   must be released after use. */
+typedef struct
+{
+    int32_t intValue;
+    AspDataEntry *key, *value;
+    bool owned;
+} TraversalItem;
+
+/* Accumulator used by sum. */
+typedef enum
+{
+    Accumulator_Integer,
+    Accumulator_Float,
+    Accumulator_Object,
+} AccumulatorType;
+
+static AspRunResult TraversalStart
+    (AspEngine *, Traversal *, AspDataEntry *iterable);
+static AspRunResult TraversalNext
+    (AspEngine *, Traversal *, TraversalItem *);
+static void TraversalEnd(AspEngine *, Traversal *);
+static AspDataEntry *ItemObject(AspEngine *, const TraversalItem *);
+static void ItemRelease(AspEngine *, TraversalItem *);
+static AspRunResult Extreme
+    (AspEngine *, AspDataEntry *args, bool max, AspDataEntry **returnValue);
+static AspRunResult Test
+    (AspEngine *, AspDataEntry *iterable, bool all,
+     AspDataEntry **returnValue);
+
+/* sum(iterable, start)
+ * Return the sum of start and the items of the iterable.
+ */
+ASP_LIB_API AspRunResult AspLib_sum
+    (AspEngine *engine,
+     AspDataEntry *iterable, AspDataEntry *start,
+     AspDataEntry **returnValue)
+{
+    /* Start accumulating with the given object. */
+    AccumulatorType accumulatorType = Accumulator_Object;
+    int32_t intSum = 0;
+    double floatSum = 0.0;
+    AspRef(engine, start);
+    AspDataEntry *objectSum = start;
+
+    Traversal traversal;
+    AspRunResult result = TraversalStart(engine, &traversal, iterable);
+    while (result == AspRunResult_OK)
+    {
+        /* Switch back to a native accumulator whenever the sum is a plain
+           number. */
+        if (accumulatorType == Accumulator_Object &&
+            (AspIsInteger(objectSum) || AspIsFloat(objectSum)))
+        {
+            if (AspIsInteger(objectSum))
+            {
+                accumulatorType = Accumulator_Integer;
+                intSum = AspDataGetInteger(objectSum);
+            }
+            else
+            {
+                accumulatorType = Accumulator_Float;
+                floatSum = AspDataGetFloat(objectSum);
+            }
+            AspUnref(engine, objectSum);
+            objectSum = 0;
+        }
+
+        TraversalItem item;
+        result = TraversalNext(engine, &traversal, &item);
+        if (result != AspRunResult_OK)
+            break;
+
+        /* Determine the numeric nature of the item. */
+        const AspDataEntry *value = item.key != 0 ? 0 : item.value;
+        bool isInteger = value == 0 ? item.key == 0 : AspIsIntegral(value);
+        bool isFloat = value != 0 && AspIsFloat(value);
+        int32_t intValue = item.intValue;
+        if (value != 0 && isInteger)
+            AspIntegerValue(value, &intValue);
+
+        if (accumulatorType == Accumulator_Integer && isInteger)
+        {
+            result = AspTranslateIntegerResult
+                (AspAddIntegers(intSum, intValue, &intSum));
+        }
+        else if (accumulatorType != Accumulator_Object &&
+                 (isInteger || isFloat))
+        {
+            if (accumulatorType == Accumulator_Integer)
+            {
+                accumulatorType = Accumulator_Float;
+                floatSum = (double)intSum;
+            }
+            double floatValue = (double)intValue;
+            if (isFloat)
+                AspFloatValue(value, &floatValue);
+            floatSum += floatValue;
+        }
+        else
+        {
+            /* Resort to performing a general addition. */
+            if (accumulatorType != Accumulator_Object)
+            {
+                objectSum = accumulatorType == Accumulator_Integer ?
+                    AspNewInteger(engine, intSum) :
+                    AspNewFloat(engine, floatSum);
+                accumulatorType = Accumulator_Object;
+            }
+            AspDataEntry *itemObject = ItemObject(engine, &item);
+            if (objectSum == 0 || itemObject == 0)
+                result = AspRunResult_OutOfDataMemory;
+            else
+            {
+                AspOperationResult addResult = AspPerformBinaryOperation
+                    (engine, OpCode_ADD, objectSum, itemObject);
+                result = addResult.result;
+                AspUnref(engine, objectSum);
+                objectSum = addResult.value;
+            }
+            if (itemObject != 0)
+                AspUnref(engine, itemObject);
+        }
+
+        ItemRelease(engine, &item);
+    }
+    TraversalEnd(engine, &traversal);
+    if (result == AspRunResult_IteratorAtEnd)
+        result = AspRunResult_OK;
+    if (result != AspRunResult_OK)
+    {
+        if (objectSum != 0)
+            AspUnref(engine, objectSum);
+        return result;
+    }
+
+    *returnValue =
+        accumulatorType == Accumulator_Integer ?
+        AspNewInteger(engine, intSum) :
+        accumulatorType == Accumulator_Float ?
+        AspNewFloat(engine, floatSum) : objectSum;
+    return *returnValue == 0 ?
+        AspRunResult_OutOfDataMemory : AspRunResult_OK;
+}
+
+/* min(*values)
+ * Return the smallest item of the given iterable or, if more than one
+ * argument is given, the smallest argument.
+ */
+ASP_LIB_API AspRunResult AspLib_min
+    (AspEngine *engine,
+     AspDataEntry *args, /* iterable group */
+     AspDataEntry **returnValue)
+{
+    return Extreme(engine, args, false, returnValue);
+}
+
+/* max(*values)
+ * Return the largest item of the given iterable or, if more than one
+ * argument is given, the largest argument.
+ */
+ASP_LIB_API AspRunResult AspLib_max
+    (AspEngine *engine,
+     AspDataEntry *args, /* iterable group */
+     AspDataEntry **returnValue)
+{
+    return Extreme(engine, args, true, returnValue);
+}
+
+/* any(iterable)
+ * Return True if any item of the iterable is true.
+ */
+ASP_LIB_API AspRunResult AspLib_any
+    (AspEngine *engine,
+     AspDataEntry *iterable,
+     AspDataEntry **returnValue)
+{
+    return Test(engine, iterable, false, returnValue);
+}
+
+/* all(iterable)
+ * Return True if all items of the iterable are true.
+ */
+ASP_LIB_API AspRunResult AspLib_all
+    (AspEngine *engine,
+     AspDataEntry *iterable,
+     AspDataEntry **returnValue)
+{
+    return Test(engine, iterable, true, returnValue);
+}
+
+static AspRunResult Extreme
+    (AspEngine *engine, AspDataEntry *args, bool max,
+     AspDataEntry **returnValue)
+{
+    int32_t argCount;
+    AspCount(engine, args, &argCount);
+    if (argCount == 0)
+        return AspRunResult_MalformedFunctionCall;
+    AspDataEntry *iterable =
+        argCount == 1 ? AspElement(engine, args, 0) : args;
+
+    /* Track the best item found so far, either as a native integer (for
+       ranges) or as an object. */
+    bool found = false;
+    int32_t bestInt = 0;
+    AspDataEntry *best = 0;
+
+    Traversal traversal;
+    AspRunResult result = TraversalStart(engine, &traversal, iterable);
+    while (result == AspRunResult_OK)
+    {
+        TraversalItem item;
+        result = TraversalNext(engine, &traversal, &item);
+        if (result != AspRunResult_OK)
+            break;
+
+        if (item.key == 0 && item.value == 0)
+        {
+            /* Ranges yield only integers. */
+            if (!found ||
+                (max ? item.intValue > bestInt : item.intValue < bestInt))
+                bestInt = item.intValue;
+            found = true;
+            continue;
+        }
+
+        AspDataEntry *value = ItemObject(engine, &item);
+        ItemRelease(engine, &item);
+        if (value == 0)
+        {
+            result = AspRunResult_OutOfDataMemory;
+            break;
+        }
+
+        bool replace = !found;
+        if (found)
+        {
+            if (AspIsInteger(value) && AspIsInteger(best))
+            {
+                int32_t
+                    intValue = AspDataGetInteger(value),
+                    intBest = AspDataGetInteger(best);
+                replace = max ? intValue > intBest : intValue < intBest;
+            }
+            else if (AspIsFloat(value) && AspIsFloat(best))
+            {
+                double
+                    floatValue = AspDataGetFloat(value),
+                    floatBest = AspDataGetFloat(best);
+                replace = max ?
+                    floatValue > floatBest : floatValue < floatBest;
+            }
+            else
+            {
+                int comparison = 0;
+                bool nanDetected = false;
+                result = AspCompare
+                    (engine, value, best, AspCompareType_Relational,
+                     &comparison, &nanDetected);
+                replace =
+                    !nanDetected && (max ? comparison > 0 : comparison < 0);
+            }
+        }
+        found = true;
+
+        if (replace)
+        {
+            if (best != 0)
+                AspUnref(engine, best);
+            best = value;
+        }
+        else
+            AspUnref(engine, value);
+    }
+    TraversalEnd(engine, &traversal);
+    if (result == AspRunResult_IteratorAtEnd && !found)
+        result = AspRunResult_ValueOutOfRange;
+    if (result != AspRunResult_IteratorAtEnd)
+    {
+        if (best != 0)
+            AspUnref(engine, best);
+        return result;
+    }
+
+    *returnValue = best != 0 ? best : AspNewInteger(engine, bestInt);
+    return *returnValue == 0 ?
+        AspRunResult_OutOfDataMemory : AspRunResult_OK;
+}
+
+static AspRunResult Test
+    (AspEngine *engine, AspDataEntry *iterable, bool all,
+     AspDataEntry **returnValue)
+{
+    /* Look for an item whose truth value differs from the default answer. */
+    bool resultValue = all;
+
+    Traversal traversal;
+    AspRunResult result = TraversalStart(engine, &traversal, iterable);
+    while (result == AspRunResult_OK)
+    {
+        TraversalItem item;
+        result = TraversalNext(engine, &traversal, &item);
+        if (result != AspRunResult_OK)
+            break;
+
+        /* Note that dictionary items (key/value pairs) are always true. */
+        bool isTrue =
+            item.key != 0 ? true :
+            item.value != 0 ? AspIsTrue(engine, item.value) :
+            item.intValue != 0;
+        ItemRelease(engine, &item);
+        if (isTrue != all)
+        {
+            resultValue = !all;
+            break;
+        }
+    }
+    TraversalEnd(engine, &traversal);
+    if (result != AspRunResult_OK && result != AspRunResult_IteratorAtEnd)
+        return result;
+
+    *returnValue = AspNewBoolean(engine, resultValue);
+    return *returnValue == 0 ?
+        AspRunResult_OutOfDataMemory : AspRunResult_OK;
+}
+
+static AspRunResult TraversalStart
+    (AspEngine *engine, Traversal *traversal, AspDataEntry *iterable)
+{
+    traversal->iterable = iterable;
+    traversal->type = AspDataGetType(iterable);
+    traversal->member = 0;
+    traversal->iterator = 0;
+    traversal->iterationCount = 0;
+    traversal->atEnd = false;
+
+    switch (traversal->type)
+    {
+        default:
+        {
+            AspIteratorResult iteratorResult = AspIteratorCreate
+                (engine, iterable, false);
+            if (iteratorResult.result != AspRunResult_OK)
+                return iteratorResult.result;
+            traversal->iterator = iteratorResult.value;
+            break;
+        }
+
+        case DataType_Range:
+            AspGetRange
+                (engine, iterable,
+                 &traversal->value, &traversal->end, &traversal->step,
+                 &traversal->bounded);
+            traversal->atEnd = AspIsValueAtRangeEnd
+                (traversal->value, traversal->end, traversal->step,
+                 traversal->bounded);
+            break;
+
+        case DataType_Tuple:
+        case DataType_List:
+        case DataType_Set:
+        case DataType_Dictionary:
+            break;
+    }
+
+    return engine->runResult;
+}
+
+static AspRunResult TraversalNext
+    (AspEngine *engine, Traversal *traversal, TraversalItem *item)
+{
+    item->intValue = 0;
+    item->key = item->value = 0;
+    item->owned = false;
+
+    /* Guard against cycles. Note that bounded ranges are always finite. */
+    if ((traversal->type != DataType_Range || !traversal->bounded) &&
+        traversal->iterationCount++ >= engine->cycleDetectionLimit)
+        return AspRunResult_CycleDetected;
+
+    switch (traversal->type)
+    {
+        default:
+        {
+            AspIteratorResult dereferenceResult = AspIteratorDereference
+                (engine, traversal->iterator);
+            if (dereferenceResult.result != AspRunResult_OK)
+                return dereferenceResult.result;
+            item->value = dereferenceResult.value;
+            item->owned = true;
+            return AspIteratorNext(engine, traversal->iterator);
+        }
+
+        case DataType_Range:
+        {
+            if (traversal->atEnd)
+                return AspRunResult_IteratorAtEnd;
+            item->intValue = traversal->value;
+
+            /* Advance. Note that overflow implies the end of a bounded
+               range, whereas it is an error for an unbounded one. */
+            int32_t newValue;
+            AspIntegerResult integerResult = AspAddIntegers
+                (traversal->value, traversal->step, &newValue);
+            if (integerResult != AspIntegerResult_OK && !traversal->bounded)
+                return AspTranslateIntegerResult(integerResult);
+            traversal->atEnd =
+                integerResult != AspIntegerResult_OK ||
+                AspIsValueAtRangeEnd
+                    (newValue, traversal->end, traversal->step,
+                     traversal->bounded);
+            traversal->value = newValue;
+            return AspRunResult_OK;
+        }
+
+        case DataType_Tuple:
+        case DataType_List:
+        {
+            AspSequenceResult nextResult = AspSequenceNext
+                (engine, traversal->iterable, traversal->member, true);
+            if (nextResult.result != AspRunResult_OK)
+                return nextResult.result;
+            if (nextResult.element == 0)
+                return AspRunResult_IteratorAtEnd;
+            traversal->member = nextResult.element;
+            item->value = nextResult.value;
+            return AspRunResult_OK;
+        }
+
+        case DataType_Set:
+        case DataType_Dictionary:
+        {
+            AspTreeResult nextResult = AspTreeNext
+                (engine, traversal->iterable, traversal->member, true);
+            if (nextResult.result != AspRunResult_OK)
+                return nextResult.result;
+            if (nextResult.node == 0)
+                return AspRunResult_IteratorAtEnd;
+            traversal->member = nextResult.node;
+            if (traversal->type == DataType_Set)
+                item->value = nextResult.key;
+            else
+            {
+                item->key = nextResult.key;
+                item->value = nextResult.value;
+            }
+            return AspRunResult_OK;
+        }
+    }
+}
+
+static void TraversalEnd(AspEngine *engine, Traversal *traversal)
+{
+    if (traversal->iterator != 0)
+    {
+        AspUnref(engine, traversal->iterator);
+        traversal->iterator = 0;
+    }
+}
+
+/* Return a new reference to an object representing the item. */
+static AspDataEntry *ItemObject(AspEngine *engine, const TraversalItem *item)
+{
+    if (item->key != 0)
+    {
+        /* Form a key/value pair, as is done when iterating a dictionary. */
+        AspDataEntry *tuple = AspNewTuple(engine);
+        if (tuple == 0)
+            return 0;
+        if (!AspTupleAppend(engine, tuple, item->key, false) ||
+            !AspTupleAppend(engine, tuple, item->value, false))
+        {
+            AspUnref(engine, tuple);
+            return 0;
+        }
+        return tuple;
+    }
+    else if (item->value != 0)
+    {
+        AspRef(engine, item->value);
+        return item->value;
+    }
+    else
+        return AspNewInteger(engine, item->intValue);
+}
+
+static void ItemRelease(AspEngine *engine, TraversalItem *item)
+{
+    if (item->owned && item->value != 0)
+        AspUnref(engine, item->value);
+    item->owned = false;
+}
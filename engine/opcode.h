@@ -35,6 +35,8 @@ typedef enum OpCode
     OpCode_PUSHDI = 0x17, /* empty dictionary */
     OpCode_PUSHAL = 0x18, /* argument list */
     OpCode_PUSHPL = 0x19, /* parameter list */
+    OpCode_PUSHCA1 = 0x1A, /* 1-byte relative code address */
+    OpCode_PUSHCA2 = 0x1B, /* 2-byte relative code address */
     OpCode_PUSHCA = 0x1C, /* 4-byte code address */
     OpCode_PUSHM1 = 0x1D, /* 1-byte module symbol */
     OpCode_PUSHM2 = 0x1E, /* 2-byte module symbol */
@@ -42,6 +44,20 @@ typedef enum OpCode
     OpCode_POP = 0x20, /* pop single entry */
     OpCode_POP1 = 0x21, /* pop N entries with 1-byte count */
 
+    /* Relative jump operations. These take a signed displacement from the
+       end of the instruction, and their low three bits match those of the
+       corresponding jump operations that take a 4-byte code address. */
+    OpCode_JMPF1 = 0x31, /* jump false, 1-byte displacement */
+    OpCode_JMPT1 = 0x32, /* jump true, 1-byte displacement */
+    OpCode_JMP1 = 0x33, /* unconditional jump, 1-byte displacement */
+    OpCode_LOR1 = 0x34, /* short-cut logical or, 1-byte displacement */
+    OpCode_LAND1 = 0x35, /* short-cut logical and, 1-byte displacement */
+    OpCode_JMPF2 = 0x39, /* jump false, 2-byte displacement */
+    OpCode_JMPT2 = 0x3A, /* jump true, 2-byte displacement */
+    OpCode_JMP2 = 0x3B, /* unconditional jump, 2-byte displacement */
+    OpCode_LOR2 = 0x3C, /* short-cut logical or, 2-byte displacement */
+    OpCode_LAND2 = 0x3D, /* short-cut logical and, 2-byte displacement */
+
     /* Unary operations. */
     OpCode_LNOT = 0x40, /* logical not */
     OpCode_POS = 0x48, /* positive value */
@@ -88,6 +104,8 @@ typedef enum OpCode
     /* Assignment and deletion operations. */
     OpCode_SET = 0x88, /* assign variable (no pop) */
     OpCode_SETP = 0x89, /* assign variable with pop */
+    OpCode_ADDSET = 0x8A, /* add and assign variable (no pop) */
+    OpCode_ADDSETP = 0x8B, /* add and assign variable with pop */
     OpCode_ERASE = 0x8C, /* delete element or slice */
     OpCode_DEL1 = 0x8D, /* delete variable with 1-byte symbol */
     OpCode_DEL2 = 0x8E, /* delete variable with 2-byte symbol */
@@ -118,6 +136,7 @@ typedef enum OpCode
     /* Function call/return operations. */
     OpCode_CALL = 0xB6, /* call function */
     OpCode_RET = 0xB7, /* return from function */
+    OpCode_TCALL = 0xB8, /* call function in place of current one */
 
     /* Module operations. */
     OpCode_ADDMOD1 = 0xB9, /* add module with 1-byte symbol to engine */
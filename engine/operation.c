@@ -798,6 +798,8 @@ static AspOperationResult PerformFormatBinaryOperation
         const char *fragmentData =
             AspDataGetStringFragmentData(fragment);
 
+        /* Non-format characters are copied to the result in runs. */
+        uint8_t runStart = 0;
         for (uint8_t fragmentIndex = 0;
              fragmentIndex < fragmentSize;
              fragmentIndex++)
@@ -808,21 +810,25 @@ static AspOperationResult PerformFormatBinaryOperation
                 /* Process non-format character. */
                 if (c == '%')
                 {
+                    /* Copy the preceding run of non-format characters to
+                       the result. */
+                    if (fragmentIndex > runStart)
+                    {
+                        AspRunResult appendResult = AspStringAppendBuffer
+                            (engine, result.value,
+                             fragmentData + runStart,
+                             fragmentIndex - runStart);
+                        if (appendResult != AspRunResult_OK)
+                        {
+                            result.result = appendResult;
+                            return result;
+                        }
+                    }
+
                     /* Switch to processing format characters. */
                     fp = formatBuffer;
                     *fp++ = '%';
                 }
-                else
-                {
-                    /* Copy the non-format character to the result. */
-                    AspRunResult appendResult = AspStringAppendBuffer
-                        (engine, result.value, &c, 1);
-                    if (appendResult != AspRunResult_OK)
-                    {
-                        result.result = appendResult;
-                        return result;
-                    }
-                }
             }
             else
             {
@@ -965,16 +971,13 @@ static AspOperationResult PerformFormatBinaryOperation
                             paddingSize = fieldSize - sourceSize;
 
                         /* Add left padding if applicable. */
-                        static char space = ' ';
                         if (!leftJustify)
                         {
-                            for (unsigned long i = 0; i < paddingSize; i++)
-                            {
-                                result.result = AspStringAppendBuffer
-                                    (engine, result.value, &space, 1);
-                                if (result.result != AspRunResult_OK)
-                                    return result;
-                            }
+                            result.result = AspStringAppendPadding
+                                (engine, result.value,
+                                 ' ', (uint32_t)paddingSize);
+                            if (result.result != AspRunResult_OK)
+                                return result;
                         }
 
                         /* Append the applicable portion of the string value
@@ -1015,13 +1018,11 @@ static AspOperationResult PerformFormatBinaryOperation
                         /* Add right padding if applicable. */
                         if (leftJustify)
                         {
-                            for (unsigned long i = 0; i < paddingSize; i++)
-                            {
-                                result.result = AspStringAppendBuffer
-                                    (engine, result.value, &space, 1);
-                                if (result.result != AspRunResult_OK)
-                                    return result;
-                            }
+                            result.result = AspStringAppendPadding
+                                (engine, result.value,
+                                 ' ', (uint32_t)paddingSize);
+                            if (result.result != AspRunResult_OK)
+                                return result;
                         }
 
                         AspUnref(engine, str);
@@ -1031,6 +1032,17 @@ static AspOperationResult PerformFormatBinaryOperation
                             return result;
                         }
                     }
+                    else if ((c == 'd' || c == 'i') &&
+                             formatBuffer[2] == '\0' && AspIsInteger(nextValue))
+                    {
+                        /* Format a plain integer directly into the result. */
+                        int32_t value;
+                        AspIntegerValue(nextValue, &value);
+                        result.result = AspStringAppendInteger
+                            (engine, result.value, value);
+                        if (result.result != AspRunResult_OK)
+                            return result;
+                    }
                     else
                     {
                         /* Format the non-string value. */
@@ -1143,6 +1155,20 @@ static AspOperationResult PerformFormatBinaryOperation
 
                 /* Switch back to processing non-format characters. */
                 fp = 0;
+                runStart = fragmentIndex + 1;
+            }
+        }
+
+        /* Copy any remaining run of non-format characters to the result. */
+        if (fp == 0 && fragmentSize > runStart)
+        {
+            AspRunResult appendResult = AspStringAppendBuffer
+                (engine, result.value,
+                 fragmentData + runStart, fragmentSize - runStart);
+            if (appendResult != AspRunResult_OK)
+            {
+                result.result = appendResult;
+                return result;
             }
         }
     }
@@ -4,6 +4,8 @@
 
 #include "sequence.h"
 #include "data.h"
+#include "compare.h"
+#include <string.h>
 
 static bool IsSequenceType(DataType);
 static bool IsElementType(DataType);
@@ -276,6 +278,120 @@ AspSequenceResult AspSequenceNext
     return result;
 }
 
+/* Sort the elements of a sequence in place by relinking its elements, using a
+   bottom-up merge sort that requires neither recursion nor additional data
+   entries. The sort is stable, including when reversed. */
+AspRunResult AspSequenceSort
+    (AspEngine *engine, AspDataEntry *sequence, bool reverse)
+{
+    AspRunResult result = AspAssert
+        (engine,
+         sequence != 0 && IsSequenceType(AspDataGetType(sequence)) &&
+         AspDataGetType(sequence) != DataType_String);
+    if (result != AspRunResult_OK)
+        return result;
+
+    uint32_t headIndex = AspDataGetSequenceHeadIndex(sequence);
+    if (headIndex == 0)
+        return AspRunResult_OK;
+
+    /* Ensure the elements end within the cycle detection limit before any
+       of them are relinked, so that detecting a cycle cannot leave the
+       sequence partially relinked. */
+    uint32_t iterationCount = 0;
+    for (uint32_t index = headIndex; index != 0;
+         index = AspDataGetElementNextIndex(AspEntry(engine, index)))
+    {
+        if (++iterationCount >= engine->cycleDetectionLimit)
+            return AspRunResult_CycleDetected;
+    }
+
+    /* Merge adjacent runs of increasing size until a single run remains.
+       If an error occurs, the remainder of the current pass is completed
+       without comparing values, so that the sequence remains properly linked
+       (although only partially sorted). */
+    uint32_t tailIndex = 0;
+    for (uint32_t runSize = 1; result == AspRunResult_OK; runSize <<= 1)
+    {
+        uint32_t leftIndex = headIndex;
+        headIndex = tailIndex = 0;
+        unsigned mergeCount = 0;
+        while (leftIndex != 0)
+        {
+            mergeCount++;
+
+            /* Locate the start of the right run. */
+            uint32_t rightIndex = leftIndex, leftSize = 0;
+            for (; leftSize < runSize && rightIndex != 0; leftSize++)
+                rightIndex = AspDataGetElementNextIndex
+                    (AspEntry(engine, rightIndex));
+            uint32_t rightSize = runSize;
+
+            /* Merge the two runs, appending to the output chain. */
+            while (leftSize > 0 || (rightSize > 0 && rightIndex != 0))
+            {
+                bool takeLeft;
+                if (leftSize == 0)
+                    takeLeft = false;
+                else if (rightSize == 0 || rightIndex == 0 ||
+                         result != AspRunResult_OK)
+                    takeLeft = true;
+                else
+                {
+                    const AspDataEntry
+                        *leftValue = AspValueEntry
+                            (engine, AspDataGetElementValueIndex
+                                (AspEntry(engine, leftIndex))),
+                        *rightValue = AspValueEntry
+                            (engine, AspDataGetElementValueIndex
+                                (AspEntry(engine, rightIndex)));
+                    int comparison = 0;
+                    result = AspCompare
+                        (engine, leftValue, rightValue,
+                         AspCompareType_Order, &comparison, 0);
+                    takeLeft = reverse ? comparison >= 0 : comparison <= 0;
+                }
+
+                uint32_t elementIndex;
+                if (takeLeft)
+                {
+                    elementIndex = leftIndex;
+                    leftIndex = AspDataGetElementNextIndex
+                        (AspEntry(engine, leftIndex));
+                    leftSize--;
+                }
+                else
+                {
+                    elementIndex = rightIndex;
+                    rightIndex = AspDataGetElementNextIndex
+                        (AspEntry(engine, rightIndex));
+                    rightSize--;
+                }
+
+                AspDataEntry *element = AspEntry(engine, elementIndex);
+                if (tailIndex == 0)
+                    headIndex = elementIndex;
+                else
+                    AspDataSetElementNextIndex
+                        (AspEntry(engine, tailIndex), elementIndex);
+                AspDataSetElementPreviousIndex(element, tailIndex);
+                tailIndex = elementIndex;
+            }
+
+            leftIndex = rightIndex;
+        }
+        AspDataSetElementNextIndex(AspEntry(engine, tailIndex), 0);
+
+        if (mergeCount <= 1)
+            break;
+    }
+
+    AspDataSetSequenceHeadIndex(sequence, headIndex);
+    AspDataSetSequenceTailIndex(sequence, tailIndex);
+
+    return result;
+}
+
 AspRunResult AspStringAppendBuffer
     (AspEngine *engine, AspDataEntry *str,
      const char *buffer, size_t bufferSize)
@@ -348,6 +464,83 @@ AspRunResult AspStringAppendBuffer
     return result;
 }
 
+AspRunResult AspStringAppendString
+    (AspEngine *engine, AspDataEntry *str, const AspDataEntry *source)
+{
+    AspRunResult result = AspAssert
+        (engine,
+         str != 0 && AspDataGetType(str) == DataType_String &&
+         source != 0 && AspDataGetType(source) == DataType_String &&
+         source != str);
+    if (result != AspRunResult_OK)
+        return result;
+
+    /* Copy the contents of each of the source's fragments, packing them into
+       the destination's fragments. */
+    uint32_t iterationCount = 0;
+    for (AspSequenceResult nextResult = AspSequenceNext
+            (engine, source, 0, true);
+         iterationCount < engine->cycleDetectionLimit &&
+         nextResult.element != 0;
+         iterationCount++,
+         nextResult = AspSequenceNext
+            (engine, source, nextResult.element, true))
+    {
+        const AspDataEntry *fragment = nextResult.value;
+        result = AspStringAppendBuffer
+            (engine, str,
+             AspDataGetStringFragmentData(fragment),
+             AspDataGetStringFragmentSize(fragment));
+        if (result != AspRunResult_OK)
+            return result;
+    }
+    if (iterationCount >= engine->cycleDetectionLimit)
+        return AspRunResult_CycleDetected;
+
+    return AspRunResult_OK;
+}
+
+AspRunResult AspStringAppendInteger
+    (AspEngine *engine, AspDataEntry *str, int32_t value)
+{
+    /* Generate the digits from least to most significant, working with the
+       unsigned magnitude so that the most negative value is handled. */
+    char buffer[11];
+    char *p = buffer + sizeof buffer;
+    uint32_t magnitude = value < 0 ? 0U - (uint32_t)value : (uint32_t)value;
+    do
+    {
+        *--p = (char)('0' + magnitude % 10U);
+        magnitude /= 10U;
+    } while (magnitude != 0);
+    if (value < 0)
+        *--p = '-';
+
+    return AspStringAppendBuffer
+        (engine, str, p, (size_t)(buffer + sizeof buffer - p));
+}
+
+AspRunResult AspStringAppendPadding
+    (AspEngine *engine, AspDataEntry *str, char c, uint32_t count)
+{
+    /* Append in chunks of at most one fragment's worth. */
+    char buffer[16];
+    memset(buffer, c, sizeof buffer);
+    while (count > 0)
+    {
+        uint32_t chunkSize = count;
+        if (chunkSize > AspDataGetStringFragmentMaxSize())
+            chunkSize = AspDataGetStringFragmentMaxSize();
+        AspRunResult result = AspStringAppendBuffer
+            (engine, str, buffer, chunkSize);
+        if (result != AspRunResult_OK)
+            return result;
+        count -= chunkSize;
+    }
+
+    return AspRunResult_OK;
+}
+
 static bool IsSequenceType(DataType type)
 {
     return
@@ -38,8 +38,16 @@ AspSequenceResult AspSequenceIndex
 AspSequenceResult AspSequenceNext
     (AspEngine *, const AspDataEntry *sequence,
      const AspDataEntry *element, bool right);
+AspRunResult AspSequenceSort
+    (AspEngine *, AspDataEntry *sequence, bool reverse);
 AspRunResult AspStringAppendBuffer
     (AspEngine *, AspDataEntry *str, const char *buffer, size_t bufferSize);
+AspRunResult AspStringAppendString
+    (AspEngine *, AspDataEntry *str, const AspDataEntry *source);
+AspRunResult AspStringAppendInteger
+    (AspEngine *, AspDataEntry *str, int32_t value);
+AspRunResult AspStringAppendPadding
+    (AspEngine *, AspDataEntry *str, char c, uint32_t count);
 
 #ifdef __cplusplus
 }
@@ -29,6 +29,8 @@ static AspRunResult LoadUnsignedWordOperand
     (AspEngine *engine, unsigned operandSize, uint32_t *operand);
 static AspRunResult LoadSignedWordOperand
     (AspEngine *engine, unsigned operandSize, int32_t *operand);
+static AspRunResult LoadCodeAddressOperand
+    (AspEngine *, unsigned operandSize, uint32_t *address);
 static AspRunResult LoadUnsignedOperand
     (AspEngine *, unsigned operandSize, uint32_t *operand);
 static AspRunResult LoadSignedOperand
@@ -63,6 +65,13 @@ AspRunResult AspStep(AspEngine *engine)
            the code (some low-level routines). Direct updates take
            precedence as they indicate a sort of failed assertion. */
         AspRunResult stepResult = Step(engine);
+        engine->codeWaiting = stepResult == AspRunResult_Again;
+        if (engine->codeWaiting)
+        {
+            /* The instruction reached code that has yet to be read, so it is
+               tried again on the next step. */
+            stepResult = AspRunResult_OK;
+        }
         if (engine->runResult == AspRunResult_OK)
             engine->runResult = stepResult;
         if (engine->runResult != AspRunResult_OK &&
@@ -87,6 +96,14 @@ static AspRunResult Step(AspEngine *engine)
     engine->instructionAddress = engine->pc;
     uint8_t opCode;
     AspRunResult opCodeResult = AspLoadCodeBytes(engine, &opCode, 1);
+    if (opCodeResult == AspRunResult_Again)
+    {
+        /* Try the instruction again once its code has been read. */
+        #ifdef ASP_DEBUG
+        fputs("waiting for code page\n", engine->traceFile);
+        #endif
+        return opCodeResult;
+    }
     if (opCodeResult != AspRunResult_OK)
         return opCodeResult;
     #ifdef ASP_DEBUG
@@ -307,6 +324,11 @@ static AspRunResult Step(AspEngine *engine)
                     #ifdef ASP_DEBUG
                     fputc('\n', engine->traceFile);
                     #endif
+
+                    /* Discard the partial string if the instruction is to
+                       be tried again. */
+                    if (byteResult == AspRunResult_Again)
+                        AspUnref(engine, stringEntry);
                     return byteResult;
                 }
                 AspRunResult appendResult = AspStringAppendBuffer
@@ -409,6 +431,11 @@ static AspRunResult Step(AspEngine *engine)
         }
 
         case OpCode_PUSHCA:
+            operandSize += 2;
+        case OpCode_PUSHCA2:
+            operandSize++;
+        case OpCode_PUSHCA1:
+            operandSize++;
         {
             #ifdef ASP_DEBUG
             fputs("PUSHCA ", engine->traceFile);
@@ -416,8 +443,8 @@ static AspRunResult Step(AspEngine *engine)
 
             /* Fetch the code address from the operand. */
             uint32_t codeAddressOperand;
-            AspRunResult operandLoadResult = LoadUnsignedWordOperand
-                (engine, 4, &codeAddressOperand);
+            AspRunResult operandLoadResult = LoadCodeAddressOperand
+                (engine, operandSize, &codeAddressOperand);
             if (operandLoadResult != AspRunResult_OK)
             {
                 #ifdef ASP_DEBUG
@@ -861,6 +888,86 @@ static AspRunResult Step(AspEngine *engine)
             break;
         }
 
+        case OpCode_ADDSET:
+        case OpCode_ADDSETP:
+        {
+            #ifdef ASP_DEBUG
+            fprintf
+                (engine->traceFile, "ADDSET%s\n",
+                 opCode == OpCode_ADDSETP ? "P" : "");
+            #endif
+
+            /* Obtain destination from the stack. */
+            AspDataEntry *address = AspTopValue(engine);
+            if (address == 0)
+                return AspRunResult_StackUnderflow;
+            if (AspIsObject(address))
+                AspRef(engine, address);
+            AspPop(engine);
+
+            /* Access the right value from the stack. */
+            AspDataEntry *right = AspTopValue(engine);
+            if (right == 0)
+                return AspRunResult_StackUnderflow;
+            if (!AspIsObject(right))
+                return AspRunResult_UnexpectedType;
+            AspRef(engine, right);
+            AspPop(engine);
+
+            /* Access the left value, leaving it on the stack. */
+            AspDataEntry *left = AspTopValue(engine);
+            if (left == 0)
+                return AspRunResult_StackUnderflow;
+            if (!AspIsObject(left))
+                return AspRunResult_UnexpectedType;
+
+            /* If the left value is a string referenced only by the variable
+               being assigned and the stack, append to it in place. Otherwise,
+               perform a normal addition, replacing the left value on the
+               stack with the result. */
+            if (AspDataGetType(address) == DataType_NamespaceNode &&
+                AspDataGetType(left) == DataType_String &&
+                AspDataGetType(right) == DataType_String &&
+                AspDataGetTreeNodeValueIndex(address) ==
+                    AspIndex(engine, left) &&
+                AspDataGetUseCount(left) == 2)
+            {
+                AspRunResult appendResult = AspStringAppendString
+                    (engine, left, right);
+                if (appendResult != AspRunResult_OK)
+                    return appendResult;
+            }
+            else
+            {
+                AspOperationResult operationResult =
+                    AspPerformBinaryOperation
+                        (engine, OpCode_ADD, left, right);
+                if (operationResult.result != AspRunResult_OK)
+                    return operationResult.result;
+                AspDataSetStackEntryValueIndex
+                    (engine->stackTop,
+                     AspIndex(engine, operationResult.value));
+                AspUnref(engine, left);
+                if (engine->runResult != AspRunResult_OK)
+                    return engine->runResult;
+                left = operationResult.value;
+            }
+            AspUnref(engine, right);
+            if (engine->runResult != AspRunResult_OK)
+                return engine->runResult;
+
+            AspRunResult assignResult =
+                AspDataGetType(address) == DataType_Tuple ||
+                AspDataGetType(address) == DataType_List ?
+                AspAssignSequence(engine, address, left) :
+                AspAssignSimple(engine, address, left);
+            if (assignResult != AspRunResult_OK)
+                return assignResult;
+            if (opCode == OpCode_ADDSETP)
+                AspPop(engine);
+            break;
+        }
+
         case OpCode_ERASE:
         {
             #ifdef ASP_DEBUG
@@ -1334,7 +1441,23 @@ static AspRunResult Step(AspEngine *engine)
         case OpCode_JMP:
         case OpCode_LOR:
         case OpCode_LAND:
+            operandSize += 2;
+        case OpCode_JMPF2:
+        case OpCode_JMPT2:
+        case OpCode_JMP2:
+        case OpCode_LOR2:
+        case OpCode_LAND2:
+            operandSize++;
+        case OpCode_JMPF1:
+        case OpCode_JMPT1:
+        case OpCode_JMP1:
+        case OpCode_LOR1:
+        case OpCode_LAND1:
+            operandSize++;
         {
+            /* Treat the relative forms as their absolute counterparts. */
+            opCode = (uint8_t)(OpCode_NOOP | (opCode & 0x07));
+
             #ifdef ASP_DEBUG
             fprintf
                 (engine->traceFile, "%s ",
@@ -1346,8 +1469,8 @@ static AspRunResult Step(AspEngine *engine)
 
             /* Fetch the code address from the operand. */
             uint32_t codeAddress = 0;
-            AspRunResult operandLoadResult = LoadUnsignedWordOperand
-                (engine, 4, &codeAddress);
+            AspRunResult operandLoadResult = LoadCodeAddressOperand
+                (engine, operandSize, &codeAddress);
             if (operandLoadResult != AspRunResult_OK)
             {
                 #ifdef ASP_DEBUG
@@ -1389,9 +1512,12 @@ static AspRunResult Step(AspEngine *engine)
         }
 
         case OpCode_CALL:
+        case OpCode_TCALL:
         {
             #ifdef ASP_DEBUG
-            fputs("CALL", engine->traceFile);
+            fputs
+                (opCode == OpCode_TCALL ? "TCALL" : "CALL",
+                 engine->traceFile);
             if (engine->again)
                 fputs("; again", engine->traceFile);
             fputc('\n', engine->traceFile);
@@ -1418,8 +1544,12 @@ static AspRunResult Step(AspEngine *engine)
                 AspPop(engine);
             }
 
-            AspRunResult callResult = AspCallFunction
-                (engine, function, arguments, engine->callFromApp);
+            /* A tail call reuses the current frame where possible. The
+               return that follows it completes any other kind of call. */
+            AspRunResult callResult = opCode == OpCode_TCALL ?
+                AspTailCallFunction(engine, function, arguments) :
+                AspCallFunction
+                    (engine, function, arguments, engine->callFromApp);
             if (callResult != AspRunResult_OK)
                 return callResult;
 
@@ -2876,6 +3006,24 @@ static AspRunResult LoadSignedWordOperand
     return AspRunResult_OK;
 }
 
+static AspRunResult LoadCodeAddressOperand
+    (AspEngine *engine, unsigned operandSize, uint32_t *address)
+{
+    /* A 4-byte operand is an absolute code address. Shorter operands are
+       signed displacements from the end of the instruction, which is where
+       the program counter points once the operand has been loaded. */
+    if (operandSize >= 4)
+        return LoadUnsignedWordOperand(engine, operandSize, address);
+
+    int32_t displacement;
+    AspRunResult result = LoadSignedOperand
+        (engine, operandSize, &displacement);
+    if (result != AspRunResult_OK)
+        return result;
+    *address = engine->pc + (uint32_t)displacement;
+    return AspRunResult_OK;
+}
+
 static AspRunResult LoadUnsignedOperand
     (AspEngine *engine, unsigned operandSize, uint32_t *operand)
 {
@@ -21,8 +21,12 @@ const char *AspAddCodeResultToString(int result)
             return "Invalid check value";
         case AspAddCodeResult_OutOfCodeMemory:
             return "Out of code memory";
+        case AspAddCodeResult_ReadError:
+            return "Read error";
         case AspAddCodeResult_InvalidState:
             return "Invalid state";
+        case AspAddCodeResult_Again:
+            return "Again";
     }
 }
 
@@ -30,6 +30,7 @@ struct AspSourceInfo
     size_t size;
     char *data;
     const uint8_t *sourceInfos;
+    size_t sourceInfoCount;
     const char *symbolNames;
 };
 
@@ -171,24 +172,24 @@ static bool FinishLoad(AspSourceInfo *info)
     /* Mark the start of the source info records. */
     info->sourceInfos = (uint8_t *)info->data + offset + 1;
 
-    /* Mark the start of the symbol names, if present. */
+    /* Mark the start of the symbol names, if present, counting the source
+       info records that precede them. */
     info->symbolNames = 0;
-    if (info->version >= 0x01)
+    const uint8_t *end = (const uint8_t *)info->data + info->size;
+    const uint8_t *p = info->sourceInfos;
+    for (; p + SourceInfoRecordSize <= end; p += SourceInfoRecordSize)
     {
-        /* Locate the end of the list of source info records. */
-        for (const uint8_t *p = info->sourceInfos;
-             p < (const uint8_t *)info->data + info->size;
-             p += SourceInfoRecordSize)
+        if (info->version < 0x01)
+            continue;
+        uint32_t sourceIndex = LoadValue(p + SourceInfo_SourceIndexOffset);
+        if (sourceIndex == UINT32_MAX)
         {
-            uint32_t sourceIndex = LoadValue
-                (p + SourceInfo_SourceIndexOffset);
-            if (sourceIndex == UINT32_MAX)
-            {
-                info->symbolNames = (const char *)p + SourceInfoRecordSize;
-                break;
-            }
+            info->symbolNames = (const char *)p + SourceInfoRecordSize;
+            break;
         }
     }
+    info->sourceInfoCount =
+        (size_t)(p - info->sourceInfos) / SourceInfoRecordSize;
 
     return true;
 }
@@ -233,27 +234,36 @@ static unsigned long ScanSourceFileNames
 AspSourceLocation AspGetSourceLocation
     (const AspSourceInfo *info, size_t pc)
 {
-    /* Locate the applicable source info record. */
-    const uint8_t *p = info->sourceInfos, *pp = p;
-    uint32_t infoProgramCounter = 0;
-    bool found = false;
-    for (; p < (const uint8_t *)info->data + info->size;
-         p += SourceInfoRecordSize)
+    AspSourceLocation result = {0, 0, 0};
+    if (info->sourceInfoCount == 0)
+        return result;
+
+    /* Locate the applicable source info record by binary search, records
+       being ordered by program counter: the first one at the program counter
+       if any, or failing that, the last one before it. */
+    size_t low = 0, high = info->sourceInfoCount;
+    while (low < high)
     {
-        infoProgramCounter = LoadValue
-            (p + SourceInfo_ProgramCounterOffset);
-        if (infoProgramCounter >= pc)
-        {
-            found = true;
-            break;
-        }
-        pp = p;
+        size_t middle = low + (high - low) / 2;
+        uint32_t infoProgramCounter = LoadValue
+            (info->sourceInfos + middle * SourceInfoRecordSize +
+             SourceInfo_ProgramCounterOffset);
+        if (infoProgramCounter < pc)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if (low == info->sourceInfoCount ||
+        LoadValue
+            (info->sourceInfos + low * SourceInfoRecordSize +
+             SourceInfo_ProgramCounterOffset) > pc)
+    {
+        if (low > 0)
+            low--;
     }
-    if (!found || infoProgramCounter > pc)
-        p = pp;
+    const uint8_t *p = info->sourceInfos + low * SourceInfoRecordSize;
 
     /* Look up the source file name. */
-    AspSourceLocation result;
     uint32_t sourceIndex = LoadValue(p + SourceInfo_SourceIndexOffset);
     result.fileName = AspGetSourceFileName(info, (unsigned)sourceIndex);
 
@@ -6,19 +6,30 @@
 #include "asp-info.h"
 #include "standalone.h"
 #include "context.h"
+#include "mapped-file.hpp"
+#include "page-stats.hpp"
+#include <algorithm>
+#include <chrono>
 #include <ctime>
 #include <csignal>
+#include <future>
 #include <iostream>
 #include <iomanip>
 #include <cstdio>
+#include <map>
 #include <set>
 #include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
 #include <new>
 #include <cstring>
 #include <memory>
 #include <cstdlib>
 #include <cerrno>
 #include <climits>
+#include <vector>
 
 #if !defined ASP_STANDALONE_VERSION_MAJOR || \
     !defined ASP_STANDALONE_VERSION_MINOR || \
@@ -34,8 +45,53 @@ using namespace std;
 
 static const size_t DEFAULT_DATA_ENTRY_COUNT = 2048;
 
+// Reader of code pages in the background, one at a time, using another
+// reader.
+struct AsyncCodePageReader
+{
+    AspCodeReader reader;
+    void *id;
+    future<pair<AspRunResult, size_t> > read;
+};
+
+static AspRunResult ReadCode
+    (void *, uint32_t offset, size_t *size, void *buffer);
 static AspRunResult LoadCodePage
     (void *, uint32_t offset, size_t *size, void *codePage);
+static AspRunResult LoadCodePageAsync
+    (void *, uint32_t offset, size_t *size, void *codePage);
+static AspRunResult LoadCodePageAsync
+    (void *id, uint32_t offset, size_t *size, void *codePage)
+{
+    auto reader = static_cast<AsyncCodePageReader *>(id);
+
+    // Start reading the page if not already doing so. The engine polls for
+    // completion using the same arguments.
+    if (!reader->read.valid())
+    {
+        auto backgroundReader = reader->reader;
+        auto backgroundId = reader->id;
+        auto requestedSize = *size;
+        reader->read = async(launch::async, [=]()
+        {
+            size_t readSize = requestedSize;
+            auto result = backgroundReader
+                (backgroundId, offset, &readSize, codePage);
+            return make_pair(result, readSize);
+        });
+    }
+    if (reader->read.wait_for(chrono::seconds(0)) != future_status::ready)
+    {
+        // Let the read proceed, even if sharing a processor with it.
+        this_thread::yield();
+        return AspRunResult_Again;
+    }
+
+    auto result = reader->read.get();
+    *size = result.second;
+    return result.first;
+}
+
 static void HandleInterrupt(int);
 static bool Interrupted = false;
 
@@ -69,16 +125,31 @@ static void Usage()
     cerr
         << ":\n"
         << COMMAND_OPTION_PREFIXES[0]
+        << "a          Read code pages in the background, prefetching those"
+        << " likely to be\n"
+        << "            needed next. Applies only in paging mode (see "
+        << COMMAND_OPTION_PREFIXES[0] << "p).\n"
+        << COMMAND_OPTION_PREFIXES[0]
         << "c n        Code size, in bytes."
         << " The default behaviour is to determine the size\n"
         << "            from the SCRIPT file."
         << " This default behaviour may also be invoked\n"
-        << "            explicitly by specifying 0 for n.\n"
+        << "            explicitly by specifying 0 for n. For a compressed"
+        << " SCRIPT file,\n"
+        << "            the size is that of the expanded code.\n"
         << COMMAND_OPTION_PREFIXES[0]
         << "d n        Data entry count, where each entry is "
         << AspDataEntrySize() << " bytes."
         << " Default is " << DEFAULT_DATA_ENTRY_COUNT << ".\n"
         << COMMAND_OPTION_PREFIXES[0]
+        << "f file     Profile output file. The number of instructions"
+        << " executed at each\n"
+        << "            source location is written to the file, for use with"
+        << " the aspc "
+        << COMMAND_OPTION_PREFIXES[0] << "f\n"
+        << "            option. Requires the SCRIPT's source info file"
+        << " (*.aspd).\n"
+        << COMMAND_OPTION_PREFIXES[0]
         << "h          Print usage information and exit.\n"
         #ifdef ASP_DEBUG
         << COMMAND_OPTION_PREFIXES[0]
@@ -91,6 +162,15 @@ static void Usage()
         << " disables paging\n"
         << "            mode. The number of pages is this value divided by the"
         << " code size.\n"
+        << COMMAND_OPTION_PREFIXES[0]
+        << "P file     Code page statistics output file. Hits, misses,"
+        << " prefetches, and\n"
+        << "            evictions are reported for each page, along with the"
+        << " misses in order\n"
+        << "            and the reads other cache geometries would have"
+        << " needed. Applies only\n"
+        << "            in paging mode (see "
+        << COMMAND_OPTION_PREFIXES[0] << "p).\n"
         #ifdef ASP_DEBUG
         << COMMAND_OPTION_PREFIXES[0]
         << "t file     Trace output file."
@@ -141,9 +221,10 @@ template<class C> static void CloseFiles(C files)
 int main(int argc, char **argv)
 {
     // Process command line options.
-    bool verbose = false;
+    bool verbose = false, asyncCodePaging = false;
     size_t codeByteCount = 0, codePageByteCount = 0;
     size_t dataEntryCount = DEFAULT_DATA_ENTRY_COUNT;
+    string profileFileName, pageStatisticsFileName;
     #ifdef ASP_DEBUG
     unsigned stepCountLimit = UINT_MAX;
     string traceFileName, dumpFileName;
@@ -169,6 +250,8 @@ int main(int argc, char **argv)
             Usage();
             return 0;
         }
+        else if (option == "a")
+            asyncCodePaging = true;
         else if (option == "c")
         {
             if (argc <= 2)
@@ -207,6 +290,28 @@ int main(int argc, char **argv)
                 return 1;
             }
         }
+        else if (option == "f")
+        {
+            if (argc <= 2)
+            {
+                Usage();
+                return 1;
+            }
+
+            profileFileName = (++argv)[1];
+            argc--;
+        }
+        else if (option == "P")
+        {
+            if (argc <= 2)
+            {
+                Usage();
+                return 1;
+            }
+
+            pageStatisticsFileName = (++argv)[1];
+            argc--;
+        }
         else if (option == "p")
         {
             if (argc <= 2)
@@ -420,6 +525,37 @@ int main(int argc, char **argv)
         return 1;
     }
     openedFiles.insert(executableFile);
+    MappedFile mappedExecutable(executableFile);
+
+    // A compressed executable cannot be sealed as is, so unless a code area
+    // size was given, allocate one of the size its header calls for and
+    // load it into that. Header bytes read from a file that cannot be
+    // rewound, such as a pipe, are kept to be loaded ahead of the rest.
+    uint8_t header[16];
+    size_t headerSize = 0, unreadHeaderSize = 0;
+    if (codeByteCount == 0)
+    {
+        if (mappedExecutable.IsMapped())
+        {
+            headerSize = min(sizeof header, mappedExecutable.Size());
+            memcpy(header, mappedExecutable.Data(), headerSize);
+        }
+        else
+        {
+            headerSize = fread(header, 1, sizeof header, executableFile);
+            if (fseek(executableFile, 0, SEEK_SET) != 0)
+                unreadHeaderSize = headerSize;
+        }
+        size_t blockSize;
+        if (AspCompressedCodeSizes
+                (header, headerSize, &codeByteCount, &blockSize)
+            == AspAddCodeResult_OK &&
+            codePageByteCount != 0)
+        {
+            cerr << "WARNING: Code page size ignored" << endl;
+            codePageByteCount = 0;
+        }
+    }
 
     // Determine byte size of data area.
     size_t dataEntrySize = AspDataEntrySize();
@@ -467,8 +603,13 @@ int main(int argc, char **argv)
     AspTraceFile(&engine, traceFile);
     #endif
 
-    // Load the executable using one of three methods.
+    // Load the executable using one of three methods, each of which uses a
+    // memory mapping of the executable file where possible.
     auto externalCode = unique_ptr<char[]>();
+    AsyncCodePageReader asyncCodePageReader;
+    AspCodeExpander codeExpander;
+    vector<uint8_t> codeExpanderBuffer;
+    CodePageStatistics pageStatistics;
     if (codeByteCount == 0)
     {
         if (codePageByteCount != 0)
@@ -477,46 +618,55 @@ int main(int argc, char **argv)
             codePageByteCount = 0;
         }
 
-        // Determine the size of the executable file.
-        int seekResult = fseek(executableFile, 0, SEEK_END);
-        long tellResult = 0;
-        if (seekResult == 0)
-            tellResult = ftell(executableFile);
-        if (seekResult != 0 || tellResult < 0)
+        // Seal the mapped executable directly if possible. Otherwise, read
+        // the entire executable into memory first.
+        const void *externalCodeData = mappedExecutable.Data();
+        size_t externalCodeSize = mappedExecutable.Size();
+        if (!mappedExecutable.IsMapped())
         {
-            cerr
-                << "Error determining size of " << executableFileName
-                << ": " << strerror(errno) << endl;
-            CloseFiles(openedFiles);
-            return 2;
-        }
-        auto externalCodeSize = static_cast<size_t>(tellResult);
-        externalCode.reset(new (nothrow) char[externalCodeSize]);
-        if (externalCode == nullptr)
-        {
-            cerr << "Error allocating memory for executable code" << endl;
-            CloseFiles(openedFiles);
-            return 2;
-        }
-        rewind(executableFile);
+            // Determine the size of the executable file.
+            int seekResult = fseek(executableFile, 0, SEEK_END);
+            long tellResult = 0;
+            if (seekResult == 0)
+                tellResult = ftell(executableFile);
+            if (seekResult != 0 || tellResult < 0)
+            {
+                cerr
+                    << "Error determining size of " << executableFileName
+                    << ": " << strerror(errno) << endl;
+                CloseFiles(openedFiles);
+                return 2;
+            }
+            externalCodeSize = static_cast<size_t>(tellResult);
+            externalCode.reset(new (nothrow) char[externalCodeSize]);
+            if (externalCode == nullptr)
+            {
+                cerr << "Error allocating memory for executable code" << endl;
+                CloseFiles(openedFiles);
+                return 2;
+            }
+            rewind(executableFile);
 
-        // Read the entire executable into memory.
-        size_t readResult = fread
-            (externalCode.get(), externalCodeSize, 1U, executableFile);
-        if (readResult != 1U || feof(executableFile) || ferror(executableFile))
-        {
-            cerr
-                << "Error reading " << executableFileName
-                << ": " << strerror(errno) << endl;
-            CloseFiles(openedFiles);
-            return 2;
+            // Read the entire executable into memory.
+            size_t readResult = fread
+                (externalCode.get(), externalCodeSize, 1U, executableFile);
+            if (readResult != 1U ||
+                feof(executableFile) || ferror(executableFile))
+            {
+                cerr
+                    << "Error reading " << executableFileName
+                    << ": " << strerror(errno) << endl;
+                CloseFiles(openedFiles);
+                return 2;
+            }
+            externalCodeData = externalCode.get();
         }
         openedFiles.erase(executableFile);
         fclose(executableFile);
         executableFile = nullptr;
 
         AspAddCodeResult sealResult = AspSealCode
-            (&engine, externalCode.get(), externalCodeSize);
+            (&engine, externalCodeData, externalCodeSize);
         if (sealResult != AspAddCodeResult_OK)
         {
             cerr
@@ -530,42 +680,33 @@ int main(int argc, char **argv)
     }
     else if (codePageByteCount == 0)
     {
-        while (true)
+        // Add the mapped executable all at once if possible. Otherwise, load
+        // the executable from the file in chunks as large as the remaining
+        // code area.
+        AspAddCodeResult loadResult;
+        if (mappedExecutable.IsMapped())
         {
-            auto c = static_cast<char>(fgetc(executableFile));
-            if (feof(executableFile))
-                break;
-            if (ferror(executableFile))
-            {
-                cerr
-                    << "Error reading " << executableFileName
-                    << ": " << strerror(errno) << endl;
-                CloseFiles(openedFiles);
-                return 2;
-            }
-            AspAddCodeResult addResult = AspAddCode(&engine, &c, 1);
-            if (addResult != AspAddCodeResult_OK)
-            {
-                cerr
-                    << "Load error 0x" << hex << uppercase << setfill('0')
-                    << setw(2) << addResult << ": "
-                    << AspAddCodeResultToString(static_cast<int>(addResult))
-                    << endl;
-                CloseFiles(openedFiles);
-                return 2;
-            }
+            loadResult = AspAddCode
+                (&engine, mappedExecutable.Data(), mappedExecutable.Size());
+            if (loadResult == AspAddCodeResult_OK)
+                loadResult = AspSeal(&engine);
+        }
+        else
+        {
+            loadResult = unreadHeaderSize == 0 ? AspAddCodeResult_OK :
+                AspAddCode(&engine, header, unreadHeaderSize);
+            if (loadResult == AspAddCodeResult_OK)
+                loadResult = AspLoadCode(&engine, ReadCode, executableFile);
         }
         openedFiles.erase(executableFile);
         fclose(executableFile);
         executableFile = nullptr;
-
-        AspAddCodeResult sealResult = AspSeal(&engine);
-        if (sealResult != AspAddCodeResult_OK)
+        if (loadResult != AspAddCodeResult_OK)
         {
             cerr
-                << "Seal error 0x" << hex << uppercase << setfill('0')
-                << setw(2) << sealResult << ": "
-                << AspAddCodeResultToString(static_cast<int>(sealResult))
+                << "Load error 0x" << hex << uppercase << setfill('0')
+                << setw(2) << loadResult << ": "
+                << AspAddCodeResultToString(static_cast<int>(loadResult))
                 << endl;
             CloseFiles(openedFiles);
             return 2;
@@ -582,14 +723,67 @@ int main(int argc, char **argv)
             CloseFiles(openedFiles);
             return 2;
         }
-        auto codePageCount = static_cast<uint8_t>(computedCodePageCount);
-        if (codePageCount != computedCodePageCount)
+        auto codePageCount = static_cast<uint32_t>(computedCodePageCount);
+
+        // Serve pages from the mapped executable if possible, and read them
+        // in the background if requested.
+        AspCodeReader codeReader = LoadCodePage;
+        void *codeReaderId = executableFile;
+        if (mappedExecutable.IsMapped())
+        {
+            codeReader = MappedFile::LoadCodePage;
+            codeReaderId = &mappedExecutable;
+        }
+        char codeHeader[16] = {0};
+        size_t codeHeaderSize = sizeof codeHeader;
+        bool compressed =
+            codeReader(codeReaderId, 0, &codeHeaderSize, codeHeader) ==
+            AspRunResult_OK &&
+            codeHeaderSize >= 4 && memcmp(codeHeader, "AspZ", 4) == 0;
+
+        // Pages of a compressed executable are expanded a block at a time.
+        size_t expandedCodeSize, blockSize;
+        if (compressed &&
+            AspCompressedCodeSizes
+                (codeHeader, codeHeaderSize, &expandedCodeSize, &blockSize)
+            == AspAddCodeResult_OK &&
+            codePageByteCount % blockSize != 0)
+        {
             cerr
-                << "WARNING: Number of code pages limited to "
-                << static_cast<unsigned>(codePageCount) << endl;
+                << "Code page size " << codePageByteCount
+                << " is not a multiple of the executable's compression block"
+                << " size, " << blockSize << endl;
+            CloseFiles(openedFiles);
+            return 2;
+        }
+        if (asyncCodePaging)
+        {
+            asyncCodePageReader.reader = codeReader;
+            asyncCodePageReader.id = codeReaderId;
+            codeReader = LoadCodePageAsync;
+            codeReaderId = &asyncCodePageReader;
+        }
+
+        // Expand the pages of a compressed executable as they are read,
+        // reading up to a page's worth of compressed code at a time.
+        if (compressed)
+        {
+            codeExpanderBuffer.resize(codePageByteCount);
+            AspInitializeCodeExpander
+                (&codeExpander, codeReader, codeReaderId,
+                 codeExpanderBuffer.data(), codeExpanderBuffer.size());
+            codeReader = AspExpandCodePage;
+            codeReaderId = &codeExpander;
+        }
 
         AspRunResult setPagingResult = AspSetCodePaging
-            (&engine, codePageCount, codePageByteCount, LoadCodePage);
+            (&engine, codePageCount, codePageByteCount, codeReader);
+        if (setPagingResult == AspRunResult_OK)
+            setPagingResult = AspSetCodePrefetching(&engine, asyncCodePaging);
+        if (setPagingResult == AspRunResult_OK &&
+            !pageStatisticsFileName.empty())
+            setPagingResult = AspSetCodePageObserver
+                (&engine, CodePageStatistics::Observe, &pageStatistics);
         if (setPagingResult != AspRunResult_OK)
         {
             cerr
@@ -601,7 +795,10 @@ int main(int argc, char **argv)
             return 2;
         }
 
-        AspAddCodeResult pageResult = AspPageCode(&engine, executableFile);
+        AspAddCodeResult pageResult;
+        do
+            pageResult = AspPageCode(&engine, codeReaderId);
+        while (pageResult == AspAddCodeResult_Again);
         if (pageResult != AspAddCodeResult_OK)
         {
             cerr
@@ -614,6 +811,12 @@ int main(int argc, char **argv)
         }
     }
 
+    if (codePageByteCount == 0 && !pageStatisticsFileName.empty())
+    {
+        cerr << "WARNING: Code page statistics file ignored" << endl;
+        pageStatisticsFileName.clear();
+    }
+
     // Report engine and code version information.
     if (verbose)
     {
@@ -653,10 +856,13 @@ int main(int argc, char **argv)
     // Prepare for the run for the potential of being interrupted by the user.
     signal(SIGINT, HandleInterrupt);
 
-    // Run the code.
+    // Run the code, counting the instructions executed at each code address
+    // if profiling.
     context.sleeping = false;
     AspRunResult runResult = AspRunResult_OK;
     unsigned stepCount = 0;
+    bool profiling = !profileFileName.empty();
+    unordered_map<size_t, uint64_t> addressCounts;
     #ifdef ASP_DEBUG
     if (stepCountLimit == UINT_MAX)
         fputs("Executing instructions indefinitely...\n", reportFile);
@@ -670,7 +876,12 @@ int main(int argc, char **argv)
          #endif
          ; stepCount++)
     {
+        // Count only steps that executed an instruction, not those that
+        // waited for a code page to be read.
+        size_t address = AspProgramCounter(&engine);
         runResult = AspStep(&engine);
+        if (profiling && !AspIsWaitingForCode(&engine))
+            addressCounts[address]++;
         if (context.sleeping)
         {
             while (clock() < context.expiry) ;
@@ -678,7 +889,10 @@ int main(int argc, char **argv)
         }
     }
 
-    // Close the executable if not already done (e.g., in code paging mode).
+    // Close the executable if not already done (e.g., in code paging mode),
+    // once any page being read in the background is done.
+    if (asyncCodePageReader.read.valid())
+        asyncCodePageReader.read.wait();
     if (executableFile != nullptr)
     {
         openedFiles.erase(executableFile);
@@ -704,6 +918,12 @@ int main(int argc, char **argv)
              stepCountLimit);
     #endif
 
+    // Determine the name of the associated source info file.
+    size_t suffixPos = executableFileName.size() - executableSuffix.size();
+    static const string sourceInfoSuffix = ".aspd";
+    string sourceInfoFileName =
+        executableFileName.substr(0, suffixPos) + sourceInfoSuffix;
+
     // Check completion status of the run.
     FILE *statusFile;
     #ifdef ASP_DEBUG
@@ -727,11 +947,6 @@ int main(int argc, char **argv)
 
         // Attempt to translate the program counter into a source location
         // using the associated source info file.
-        size_t suffixPos =
-            executableFileName.size() - executableSuffix.size();
-        static const string sourceInfoSuffix = ".aspd";
-        string sourceInfoFileName =
-            executableFileName.substr(0, suffixPos) + sourceInfoSuffix;
         AspSourceInfo *sourceInfo = AspLoadSourceInfoFromFile
             (sourceInfoFileName.c_str());
         if (sourceInfo != nullptr)
@@ -750,6 +965,72 @@ int main(int argc, char **argv)
         fputc('\n', statusFile);
     }
 
+    // Write the profile, attributing the instructions executed at each code
+    // address to its source location.
+    if (profiling)
+    {
+        AspSourceInfo *sourceInfo = AspLoadSourceInfoFromFile
+            (sourceInfoFileName.c_str());
+        FILE *profileFile = nullptr;
+        if (sourceInfo == nullptr)
+            cerr
+                << "Error loading " << sourceInfoFileName
+                << "; profile not written" << endl;
+        else
+        {
+            profileFile = fopen(profileFileName.c_str(), "w");
+            if (profileFile == nullptr)
+                cerr
+                    << "Error creating " << profileFileName
+                    << ": " << strerror(errno) << endl;
+        }
+        if (profileFile != nullptr)
+        {
+            map<tuple<string, unsigned, unsigned>, uint64_t> locationCounts;
+            for (const auto &addressCount: addressCounts)
+            {
+                AspSourceLocation sourceLocation = AspGetSourceLocation
+                    (sourceInfo, addressCount.first);
+                if (sourceLocation.fileName != nullptr)
+                    locationCounts[make_tuple
+                        (sourceLocation.fileName,
+                         sourceLocation.line, sourceLocation.column)]
+                        += addressCount.second;
+            }
+            for (const auto &locationCount: locationCounts)
+                fprintf
+                    (profileFile, "%llu\t%u\t%u\t%s\n",
+                     static_cast<unsigned long long>(locationCount.second),
+                     get<1>(locationCount.first), get<2>(locationCount.first),
+                     get<0>(locationCount.first).c_str());
+            if (fclose(profileFile) != 0)
+                cerr << "Error writing " << profileFileName << endl;
+        }
+        if (sourceInfo != nullptr)
+            AspUnloadSourceInfo(sourceInfo);
+    }
+
+    // Write code page statistics.
+    if (!pageStatisticsFileName.empty())
+    {
+        FILE *pageStatisticsFile = fopen(pageStatisticsFileName.c_str(), "w");
+        if (pageStatisticsFile == nullptr)
+            cerr
+                << "Error creating " << pageStatisticsFileName
+                << ": " << strerror(errno) << endl;
+        else
+        {
+            AspCodePageStats stats;
+            AspCodePageStatistics(&engine, &stats, false);
+            pageStatistics.Write
+                (pageStatisticsFile, stats,
+                 static_cast<uint32_t>(codeByteCount / codePageByteCount),
+                 codePageByteCount);
+            if (fclose(pageStatisticsFile) != 0)
+                cerr << "Error writing " << pageStatisticsFileName << endl;
+        }
+    }
+
     // Report low free count.
     if (verbose)
     {
@@ -769,6 +1050,22 @@ int main(int argc, char **argv)
     return runResult == AspRunResult_Complete ? 0 : 2;
 }
 
+static AspRunResult ReadCode
+    (void *id, uint32_t offset, size_t *size, void *buffer)
+{
+    // AspLoadCode reads sequentially, so read from the current position,
+    // which allows for files that cannot seek, such as pipes.
+    (void)offset;
+    auto executableFile = static_cast<FILE *>(id);
+
+    size_t readCount = fread(buffer, 1, *size, executableFile);
+    if (ferror(executableFile) != 0)
+        return AspRunResult_Application;
+    *size = readCount;
+
+    return AspRunResult_OK;
+}
+
 static AspRunResult LoadCodePage
     (void *id, uint32_t offset, size_t *size, void *codePage)
 {
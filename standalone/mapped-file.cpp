@@ -0,0 +1,62 @@
+//
+// Standalone Asp application memory-mapped file implementation.
+//
+
+#include "mapped-file.hpp"
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+MappedFile::MappedFile(FILE *file)
+{
+    #ifndef _WIN32
+    int fd = fileno(file);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0 || !S_ISREG(status.st_mode) ||
+        status.st_size <= 0 ||
+        static_cast<unsigned long long>(status.st_size) > SIZE_MAX)
+        return;
+
+    auto mappedSize = static_cast<size_t>(status.st_size);
+    void *mappedData = mmap
+        (nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mappedData == MAP_FAILED)
+        return;
+
+    data = mappedData;
+    size = mappedSize;
+    #else
+    (void)file;
+    #endif
+}
+
+MappedFile::~MappedFile()
+{
+    #ifndef _WIN32
+    if (data != nullptr)
+        munmap(const_cast<void *>(data), size);
+    #endif
+}
+
+AspRunResult MappedFile::LoadCodePage
+    (void *id, uint32_t offset, size_t *size, void *codePage)
+{
+    auto mappedFile = static_cast<const MappedFile *>(id);
+
+    size_t available =
+        offset < mappedFile->size ? mappedFile->size - offset : 0;
+    if (*size > available)
+        *size = available;
+    if (*size != 0)
+        memcpy
+            (codePage,
+             static_cast<const uint8_t *>(mappedFile->data) + offset,
+             *size);
+
+    return AspRunResult_OK;
+}
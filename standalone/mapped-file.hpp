@@ -0,0 +1,55 @@
+//
+// Standalone Asp application memory-mapped file definitions.
+//
+
+#ifndef ASPS_MAPPED_FILE_HPP
+#define ASPS_MAPPED_FILE_HPP
+
+#include "asp.h"
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+
+// Read-only mapping of an entire open file into memory. Where mapping is
+// unsupported or fails, the object is left unmapped and the file must be read
+// by other means. The mapping remains valid after the file is closed.
+class MappedFile
+{
+    public:
+
+        // Constructor, destructor.
+        explicit MappedFile(FILE *);
+        ~MappedFile();
+
+        // Mapping access.
+        bool IsMapped() const
+        {
+            return data != nullptr;
+        }
+        const void *Data() const
+        {
+            return data;
+        }
+        size_t Size() const
+        {
+            return size;
+        }
+
+        // Code reader to pass to AspSetCodePaging with this object as id.
+        // Pages are copied from the mapping.
+        static AspRunResult LoadCodePage
+            (void *id, uint32_t offset, size_t *size, void *codePage);
+
+    protected:
+
+        // Copy prevention.
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator =(const MappedFile &) = delete;
+
+    private:
+
+        const void *data = nullptr;
+        size_t size = 0;
+};
+
+#endif
@@ -0,0 +1,133 @@
+//
+// Standalone Asp application code page statistics implementation.
+//
+
+#include "page-stats.hpp"
+#include <set>
+#include <unordered_map>
+
+using namespace std;
+
+void CodePageStatistics::Observe
+    (void *id, AspCodePageEvent event, uint32_t page, uint32_t address)
+{
+    auto statistics = static_cast<CodePageStatistics *>(id);
+    auto &counts = statistics->pageCounts[page];
+    switch (event)
+    {
+        case AspCodePageEvent_Hit:
+            counts.hits++;
+            statistics->references.push_back(page);
+            break;
+        case AspCodePageEvent_Miss:
+            counts.misses++;
+            statistics->misses.emplace_back(address, page);
+            statistics->references.push_back(page);
+            break;
+        case AspCodePageEvent_Prefetch:
+            counts.prefetches++;
+            break;
+        case AspCodePageEvent_Eviction:
+            counts.evictions++;
+            break;
+    }
+}
+
+void CodePageStatistics::Write
+    (FILE *file, const AspCodePageStats &stats,
+     uint32_t pageCount, size_t pageSize) const
+{
+    fprintf
+        (file,
+         "Code page cache: %u pages of %zu bytes\n"
+         "Hits: %zu\nMisses: %zu\nPrefetches: %zu\nEvictions: %zu\n",
+         pageCount, pageSize,
+         stats.hitCount, stats.missCount,
+         stats.prefetchCount, stats.evictionCount);
+
+    fputs("\nPage\tHits\tMisses\tPrefetches\tEvictions\n", file);
+    for (const auto &pageCount: pageCounts)
+    {
+        const auto &counts = pageCount.second;
+        fprintf
+            (file, "%u\t%llu\t%llu\t%llu\t%llu\n",
+             pageCount.first,
+             static_cast<unsigned long long>(counts.hits),
+             static_cast<unsigned long long>(counts.misses),
+             static_cast<unsigned long long>(counts.prefetches),
+             static_cast<unsigned long long>(counts.evictions));
+    }
+
+    fputs("\nMisses (address, page):\n", file);
+    for (const auto &miss: misses)
+        fprintf(file, "0x%07X\t%u\n", miss.first, miss.second);
+
+    // Replay the references against caches of the same and of larger pages,
+    // doubling the number of pages until all those referenced fit.
+    fputs
+        ("\nSimulated reads without prefetching:\n"
+         "Pages\tPage size\tReads\n", file);
+    for (uint32_t pagesPerPage = 1; pagesPerPage <= 8; pagesPerPage *= 2)
+    {
+        set<uint32_t> distinctPages;
+        for (auto page: references)
+            distinctPages.insert(page / pagesPerPage);
+        for (uint32_t simulatedPageCount = 1; ; simulatedPageCount *= 2)
+        {
+            fprintf
+                (file, "%u\t%zu\t%llu\n",
+                 simulatedPageCount, pagesPerPage * pageSize,
+                 static_cast<unsigned long long>
+                    (Simulate(simulatedPageCount, pagesPerPage)));
+            if (simulatedPageCount >= distinctPages.size())
+                break;
+        }
+    }
+}
+
+uint64_t CodePageStatistics::Simulate
+    (uint32_t pageCount, uint32_t pagesPerPage) const
+{
+    // Mirror the engine's clock replacement, which spares the current page.
+    struct Entry
+    {
+        uint32_t page;
+        bool used, referenced;
+    };
+    vector<Entry> entries(pageCount, Entry{0, false, false});
+    unordered_map<uint32_t, uint32_t> entryIndices;
+    uint32_t currentIndex = 0, hand = 0;
+    uint64_t readCount = 0;
+    for (auto reference: references)
+    {
+        auto page = reference / pagesPerPage;
+        if (entries[currentIndex].used && entries[currentIndex].page == page)
+            continue;
+
+        auto iter = entryIndices.find(page);
+        if (iter == entryIndices.end())
+        {
+            readCount++;
+            while (true)
+            {
+                auto &entry = entries[hand];
+                if (!entry.used ||
+                    (!entry.referenced &&
+                     (hand != currentIndex || pageCount == 1)))
+                    break;
+                entry.referenced = false;
+                hand = (hand + 1) % pageCount;
+            }
+            auto &entry = entries[hand];
+            if (entry.used)
+                entryIndices.erase(entry.page);
+            entry.page = page;
+            entry.used = true;
+            iter = entryIndices.emplace(page, hand).first;
+            hand = (hand + 1) % pageCount;
+        }
+        currentIndex = iter->second;
+        entries[currentIndex].referenced = true;
+    }
+    return readCount;
+}
@@ -0,0 +1,47 @@
+//
+// Standalone Asp application code page statistics definitions.
+//
+
+#ifndef ASPS_PAGE_STATS_HPP
+#define ASPS_PAGE_STATS_HPP
+
+#include "asp.h"
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <utility>
+#include <vector>
+
+// Collects code page cache events from the engine and reports them, along
+// with the number of reads other cache geometries would have needed.
+class CodePageStatistics
+{
+    public:
+
+        // Observer to pass to AspSetCodePageObserver with this object as id.
+        static void Observe
+            (void *id, AspCodePageEvent, uint32_t page, uint32_t address);
+
+        // Writes the report for the given cache geometry.
+        void Write
+            (FILE *, const AspCodePageStats &,
+             uint32_t pageCount, size_t pageSize) const;
+
+    private:
+
+        // Internal methods.
+        uint64_t Simulate(uint32_t pageCount, uint32_t pagesPerPage) const;
+
+        struct PageCounts
+        {
+            uint64_t hits = 0, misses = 0, prefetches = 0, evictions = 0;
+        };
+
+        // Counts for each page, each miss as an instruction address and page,
+        // and the sequence of pages referenced other than by prefetching.
+        std::map<uint32_t, PageCounts> pageCounts;
+        std::vector<std::pair<uint32_t, uint32_t> > misses;
+        std::vector<uint32_t> references;
+};
+
+#endif
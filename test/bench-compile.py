@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+
+#
+# Asp compiler benchmark on large synthetic scripts.
+#
+# Generates a chain of modules, each defining many small functions and
+# calling them at module level, and times the compiler on the result at
+# each requested optimization level.
+#
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+def generate(directory, module_count, function_count):
+    for m in range(module_count):
+        lines = []
+        if m + 1 < module_count:
+            lines.append('import m%d' % (m + 1))
+        for f in range(function_count):
+            lines += [
+                'def f%d_%d(a, b = %d):' % (m, f, f),
+                '    x = a + b * %d' % f,
+                '    if x > 10:',
+                '        x -= 3',
+                '    else:',
+                '        x += 1',
+                '    for i in 0..3:',
+                '        x += i',
+                '    return x',
+                '',
+                ]
+        lines.append('t%d = 0' % m)
+        lines += [
+            't%d += f%d_%d(%d)' % (m, m, f, f)
+            for f in range(function_count)]
+        with open(os.path.join(directory, 'm%d.asp' % m), 'w') as f:
+            f.write('\n'.join(lines) + '\n')
+    with open(os.path.join(directory, 'main.asp'), 'w') as f:
+        f.write('import m0\nprint(m0.t0)\n')
+    return module_count * (function_count * 11 + 2) + 2
+
+def main():
+    parser = argparse.ArgumentParser(
+        description = 'Time the Asp compiler on large synthetic scripts.')
+    parser.add_argument('aspc', help = 'path of the compiler executable')
+    parser.add_argument('spec', help = 'application spec file')
+    parser.add_argument('-m', '--modules', type = int, default = 60,
+        help = 'number of modules (default 60)')
+    parser.add_argument('-f', '--functions', type = int, default = 200,
+        help = 'number of functions per module (default 200)')
+    parser.add_argument('-r', '--repeat', type = int, default = 3,
+        help = 'number of runs per level, best is reported (default 3)')
+    parser.add_argument('-O', '--levels', default = '0,1,2',
+        help = 'comma-separated optimization levels (default 0,1,2)')
+    args = parser.parse_args()
+
+    aspc = os.path.abspath(args.aspc)
+    spec = os.path.abspath(args.spec)
+    with tempfile.TemporaryDirectory() as directory:
+        line_count = generate(directory, args.modules, args.functions)
+        print('%d modules, %d lines' % (args.modules + 1, line_count))
+        for level in args.levels.split(','):
+            best = None
+            for _ in range(args.repeat):
+                start = time.perf_counter()
+                result = subprocess.run(
+                    [aspc, '-q', '-O', level, spec, 'main.asp'],
+                    cwd = directory)
+                elapsed = time.perf_counter() - start
+                if result.returncode != 0:
+                    sys.exit('Compilation failed at level %s' % level)
+                best = elapsed if best is None else min(best, elapsed)
+            size = os.path.getsize(os.path.join(directory, 'main.aspe'))
+            print('-O %s: %.3f s, %d bytes' % (level, best, size))
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+
+#
+# Asp optimizer benchmark on a fixed set of sample scripts.
+#
+# Compiles each sample at each requested optimization level and reports
+# the size of the executable and the number of instructions in its listing,
+# so that the effect of the optimizer can be compared across changes.
+#
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+SAMPLES = {
+    'loops': '''
+total = 0
+for i in 0..100:
+    if i % 3 == 0:
+        total += i
+    elif i % 5 == 0:
+        total -= 1
+    else:
+        total += 2
+n = 0
+while n < 50:
+    n += 1
+    if n == 40:
+        break
+print(total, n)
+''',
+
+    'strings': '''
+s = ''
+for i in 0..20:
+    s += str(i)
+    s += ','
+words = ['alpha', 'beta', 'gamma']
+line = ''
+for w in words:
+    line += w + ' '
+print(s, line)
+''',
+
+    'functions': '''
+def fact(n, acc = 1):
+    if n <= 1:
+        return acc
+    return fact(n - 1, acc * n)
+
+def fib(n):
+    return n if n < 2 else fib(n - 1) + fib(n - 2)
+
+def pick(a, b, c):
+    return a if a > b and a > c else b if b > c else c
+
+print(fact(10), fib(12), pick(3, 7, 5))
+''',
+
+    'branches': '''
+DEBUG = False
+LIMIT = 8
+def check(x):
+    if DEBUG:
+        print('checking', x)
+    if not DEBUG and x > LIMIT:
+        return LIMIT
+    return x
+r = 0
+for v in (3, 9, 12):
+    r += check(v)
+print(r)
+''',
+
+    'collections': '''
+d = {}
+for i in 0..30:
+    d[i] = i * i
+t = ()
+for k in d:
+    if d[k] % 2 == 0:
+        t = t + (k,)
+print(len(d), len(t))
+''',
+    }
+
+def count_instructions(listing_path):
+    with open(listing_path) as f:
+        return sum(1 for line in f if line.startswith('0x'))
+
+def main():
+    parser = argparse.ArgumentParser(
+        description = 'Compare Asp executables across optimization levels.')
+    parser.add_argument('aspc', help = 'path of the compiler executable')
+    parser.add_argument('spec', help = 'application spec file')
+    parser.add_argument('-O', '--levels', default = '0,1',
+        help = 'comma-separated optimization levels (default 0,1)')
+    args = parser.parse_args()
+
+    aspc = os.path.abspath(args.aspc)
+    spec = os.path.abspath(args.spec)
+    levels = args.levels.split(',')
+    totals = {level: [0, 0] for level in levels}
+    print('%-12s' % 'script' + ''.join(
+        '%20s' % ('-O %s' % level) for level in levels))
+    with tempfile.TemporaryDirectory() as directory:
+        for name, source in sorted(SAMPLES.items()):
+            with open(os.path.join(directory, name + '.asp'), 'w') as f:
+                f.write(source.lstrip())
+            row = '%-12s' % name
+            for level in levels:
+                result = subprocess.run(
+                    [aspc, '-q', '-O', level, spec, name + '.asp'],
+                    cwd = directory)
+                if result.returncode != 0:
+                    sys.exit('Compilation of %s failed at level %s'
+                        % (name, level))
+                size = os.path.getsize(
+                    os.path.join(directory, name + '.aspe'))
+                count = count_instructions(
+                    os.path.join(directory, name + '.lst'))
+                totals[level][0] += size
+                totals[level][1] += count
+                row += '%20s' % ('%d B, %d ins' % (size, count))
+            print(row)
+    print('%-12s' % 'total' + ''.join(
+        '%20s' % ('%d B, %d ins' % tuple(totals[level]))
+        for level in levels))
+
+if __name__ == '__main__':
+    main()
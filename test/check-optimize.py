@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+
+#
+# Asp optimizer regression check.
+#
+# Compiles each of a set of small programs at every optimization level, runs
+# them with the standalone application, and checks that every level behaves
+# as unoptimized code does: the same output and the same run error, if any.
+#
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+CASES = {
+    # A module variable assigned a constant once in its own module may still
+    # be rebound from another module by way of a member assignment.
+    'rebound-constant': {
+        'helper.asp': '''
+LIMIT = 3
+def scale(x):
+    return x * LIMIT
+def get():
+    return LIMIT
+''',
+        'main.asp': '''
+import helper
+helper.LIMIT = 10
+print(helper.scale(2), helper.get(), helper.LIMIT)
+''',
+        },
+
+    # A constant must not reach code that runs before it is assigned.
+    'constant-before-assignment': {
+        'main.asp': '''
+def show():
+    return X
+print(show() if exists(`X) else 'unbound')
+X = 3
+print(X, show())
+print(Y)
+Y = 4
+''',
+        },
+
+    # A function defined once in its own module may still be rebound from
+    # another module, so calls to it must not be inlined.
+    'rebound-function': {
+        'helper.asp': '''
+def clamp(x):
+    return x if x < 10 else 10
+def use(v):
+    return clamp(v)
+''',
+        'main.asp': '''
+import helper
+def wide(x):
+    return x
+print(helper.use(50))
+helper.clamp = wide
+print(helper.use(50))
+''',
+        },
+
+    # A call that runs before the function is defined must not be inlined.
+    'call-before-definition': {
+        'main.asp': '''
+def first(x):
+    return early(x) + 1
+print(early(1) if exists(`early) else 'undefined')
+def early(x):
+    return x * 2
+print(early(1), first(1))
+print(late(1))
+def late(x):
+    return x
+''',
+        },
+
+    # A name bound once in its own module, or not at all, may still be
+    # rebound from another module while a loop that uses it runs, so its
+    # lookup must not be hoisted out of the loop.
+    'rebound-in-loop': {
+        'helper.asp': '''
+def step(i):
+    return i
+def run(n, hook):
+    t = 0
+    for i in 0..n:
+        t += step(i) + len('ab')
+        hook()
+    return t
+''',
+        'main.asp': '''
+import helper
+def ten(i):
+    return 10
+def zero(s):
+    return 0
+def hook():
+    helper.step = ten
+    helper.len = zero
+print(helper.run(3, hook))
+''',
+        },
+
+    # An application name that is not bound globally, such as a parameter
+    # name, must not be looked up ahead of a loop whose body would not look
+    # it up, or would do so only once it is bound.
+    'unbound-in-loop': {
+        'main.asp': '''
+items = []
+for x in items:
+    print(start)
+print('done')
+t = 0
+for i in 0..3:
+    if exists(`start):
+        t += start
+    t += 1
+print(t)
+''',
+        },
+
+    # Constants assigned ahead of their uses are still propagated.
+    'constant-chain': {
+        'main.asp': '''
+A = 2
+B = A * 3
+def f(x):
+    return x + B
+print(A, B, f(1))
+''',
+        },
+    }
+
+def run(aspc, asps, spec, directory, options):
+    result = subprocess.run(
+        [aspc, '-q'] + options + [spec, 'main.asp'], cwd = directory,
+        stdout = subprocess.PIPE, stderr = subprocess.STDOUT,
+        universal_newlines = True)
+    if result.returncode != 0:
+        return 'Compilation failed:\n' + result.stdout
+    result = subprocess.run(
+        [asps, 'main'], cwd = directory,
+        stdout = subprocess.PIPE, stderr = subprocess.PIPE,
+        universal_newlines = True)
+
+    # Code addresses differ between levels, so compare all but those.
+    return result.stdout + ''.join(
+        line for line in result.stderr.splitlines(True)
+        if not line.startswith('Program counter:'))
+
+def main():
+    parser = argparse.ArgumentParser(
+        description = 'Check that optimized Asp programs behave as'
+            ' unoptimized ones do.')
+    parser.add_argument('aspc', help = 'path of the compiler executable')
+    parser.add_argument('asps', help = 'path of the standalone application')
+    parser.add_argument('spec', help = 'application spec file')
+    parser.add_argument('-O', '--levels', default = '1,2',
+        help = 'comma-separated optimization levels to check (default 1,2)')
+    args = parser.parse_args()
+
+    aspc = os.path.abspath(args.aspc)
+    asps = os.path.abspath(args.asps)
+    spec = os.path.abspath(args.spec)
+    failures = 0
+    for name, files in sorted(CASES.items()):
+        case_failures = 0
+        with tempfile.TemporaryDirectory() as directory:
+            for file_name, source in files.items():
+                with open(os.path.join(directory, file_name), 'w') as f:
+                    f.write(source.lstrip())
+            expected = run(aspc, asps, spec, directory, ['-O', '0'])
+            if expected.startswith('Compilation failed'):
+                sys.exit('%s: %s' % (name, expected))
+            for level in args.levels.split(','):
+                for options in (['-O', level], ['-O', level, '-j', '2']):
+                    actual = run(aspc, asps, spec, directory, options)
+                    if actual == expected:
+                        continue
+                    case_failures += 1
+                    print('%s (%s): expected:\n%sgot:\n%s' % (
+                        name, ' '.join(options), expected, actual))
+        print('%s: %s' % (name, 'ok' if case_failures == 0 else 'FAILED'))
+        failures += case_failures
+    if failures != 0:
+        sys.exit('%d failures' % failures)
+
+if __name__ == '__main__':
+    main()